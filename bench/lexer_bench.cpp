@@ -0,0 +1,169 @@
+// Measures lexer and parser throughput, the size of the tree, loading a serialized tree, and keyword
+// recognition against the unordered_map<std::string, TokenType> lookup the lexer used to do.
+//
+//   lexer_bench [file.peli] [--repeat <n>]
+//
+// Without a file, lexes a generated program of a few megabytes.
+#include "lexer.hpp"
+#include "ByteScanner.hpp"
+#include "parser.hpp"
+#include "SourceFile.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::string generateProgram(size_t lines) {
+    static const char* const samples[] = {
+        ": SQUARE ( n -- n*n ) DUP * ;",
+        "10 0 DO I SQUARE 100 I + ! LOOP",
+        "400 @ 401 @ OVER OVER > IF SWAP THEN DROP DROP",
+        ": CLAMP ROT MIN-VALUE MAX-VALUE OVER OVER < IF SWAP THEN DROP ;",
+        "3.14159 2.5e3 * -42 + .S CR",
+        "500 80 ACCEPT 500 SWAP >NUMBER .\" converted\" .",
+        "R@ 1 - 0 ?DO I J + 2 +LOOP >R R> DROP",
+    };
+    std::string program;
+    for (size_t i = 0; i < lines; ++i) {
+        program += samples[i % (sizeof(samples) / sizeof(samples[0]))];
+        program += '\n';
+    }
+    return program;
+}
+
+// Runs `body` `repeat` times and returns the fastest run in seconds.
+template <typename Body>
+double fastest(int repeat, Body body) {
+    double best = 0;
+    for (int i = 0; i < repeat; ++i) {
+        auto start = Clock::now();
+        body();
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        if (i == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string path;
+    int repeat = 5;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--repeat" && i + 1 < argc) {
+            repeat = std::max(1, std::atoi(argv[++i]));
+        } else {
+            path = arg;
+        }
+    }
+
+    std::unique_ptr<SourceFile> file;
+    std::string generated;
+    std::string_view source;
+    if (path.empty()) {
+        generated = generateProgram(200000);
+        source = generated;
+    } else {
+        file = std::make_unique<SourceFile>(path);
+        source = file->text();
+    }
+
+    std::vector<std::string_view> words;
+    std::vector<std::pair<const char*, double>> lex_seconds;
+    for (const ByteScanner* scanner : ByteScanner::available()) {
+        lex_seconds.emplace_back(scanner->name, fastest(repeat, [&]() {
+            words.clear();
+            Lexer lexer(source, *scanner);
+            for (Token token = lexer.getNextToken(); token.type != TokenType::EndOfFile;
+                 token = lexer.getNextToken()) {
+                words.push_back(token.text);
+            }
+        }));
+    }
+
+    size_t nodes = 0;
+    double parse_seconds = fastest(repeat, [&]() {
+        Lexer lexer(source);
+        Parser parser(lexer);
+        nodes = parser.parse().nodeCount();
+    });
+
+    // What a parse cache hit does in place of lexing and parsing.
+    std::string serialized;
+    size_t tree_bytes;
+    {
+        Lexer lexer(source);
+        Parser parser(lexer);
+        Ast ast = parser.parse();
+        serialized = ast.serialize();
+        tree_bytes = ast.memoryBytes();
+    }
+    double load_seconds = fastest(repeat, [&]() {
+        if (Ast::deserialize(serialized).nodeCount() != nodes) {
+            std::abort();
+        }
+    });
+
+    // The lookup the lexer did before: a heap-allocated key hashed into an
+    // unordered_map for every word.
+    std::unordered_map<std::string, TokenType> map;
+    for (std::string_view word : words) {
+        TokenType type;
+        if (lookupKeyword(word, type)) {
+            map.emplace(std::string(word), type);
+        }
+    }
+
+    size_t hits = 0;
+    double map_seconds = fastest(repeat, [&]() {
+        hits = 0;
+        for (std::string_view word : words) {
+            hits += map.find(std::string(word)) != map.end();
+        }
+    });
+    size_t perfect_hits = 0;
+    double perfect_seconds = fastest(repeat, [&]() {
+        perfect_hits = 0;
+        TokenType type;
+        for (std::string_view word : words) {
+            perfect_hits += lookupKeyword(word, type);
+        }
+    });
+    if (hits != perfect_hits) {
+        std::cerr << "Keyword lookups disagree: " << hits << " vs " << perfect_hits << std::endl;
+        return 1;
+    }
+
+    double megabytes = static_cast<double>(source.size()) / (1024 * 1024);
+    double tokens = static_cast<double>(words.size());
+    std::cout << "source:          " << megabytes << " MiB, " << words.size() << " tokens, " << hits
+              << " keywords\n";
+    for (const auto& [name, seconds] : lex_seconds) {
+        std::string label = std::string("lexer (") + name + "):";
+        label.resize(17, ' ');
+        std::cout << label << tokens / seconds / 1e6 << " M tokens/s, " << megabytes / seconds << " MiB/s\n";
+    }
+    std::cout << "parser:          " << static_cast<double>(nodes) / parse_seconds / 1e6 << " M nodes/s, "
+              << megabytes / parse_seconds << " MiB/s\n";
+    std::cout << "tree:            " << static_cast<double>(tree_bytes) / (1024 * 1024) << " MiB, "
+              << static_cast<double>(tree_bytes) / static_cast<double>(nodes) << " bytes/node, " << symbolCount()
+              << " symbols\n";
+    std::cout << "cached tree:     " << static_cast<double>(nodes) / load_seconds / 1e6 << " M nodes/s, "
+              << megabytes / load_seconds << " MiB/s of source, "
+              << static_cast<double>(serialized.size()) / (1024 * 1024) << " MiB serialized\n";
+    std::cout << "keywords (map):  " << map_seconds * 1e9 / tokens << " ns/word\n";
+    std::cout << "keywords (hash): " << perfect_seconds * 1e9 / tokens << " ns/word\n";
+    return 0;
+}
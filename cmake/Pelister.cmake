@@ -0,0 +1,37 @@
+# add_peli_executable(<target> <source.peli> [CELL f64|i64|i32] [STACK_DEPTH <n>] [MEMORY <size>])
+#
+# Builds a .peli program ahead of time: pelilang translates it to C++ with
+# --emit-cpp, and the result is compiled and linked against pelister_runtime
+# only. The program is translated again whenever it or pelilang changes.
+function(add_peli_executable target source)
+    cmake_parse_arguments(PELI "" "CELL;STACK_DEPTH;MEMORY" "" ${ARGN})
+    if(NOT PELI_CELL)
+        set(PELI_CELL f64)
+    endif()
+
+    get_filename_component(source_path "${source}" ABSOLUTE)
+    set(generated "${CMAKE_CURRENT_BINARY_DIR}/${target}.peli.cpp")
+    # The build leaves the user's parse cache alone.
+    set(flags --no-cache --cell ${PELI_CELL})
+    if(PELI_STACK_DEPTH)
+        list(APPEND flags --stack-depth ${PELI_STACK_DEPTH})
+    endif()
+    if(PELI_MEMORY)
+        list(APPEND flags --memory ${PELI_MEMORY})
+    endif()
+
+    add_custom_command(
+        OUTPUT "${generated}"
+        COMMAND pelilang ${flags} --emit-cpp "${generated}" "${source_path}"
+        DEPENDS pelilang "${source_path}"
+        COMMENT "Translating ${source} to C++"
+        VERBATIM
+    )
+
+    add_executable(${target} "${generated}")
+    target_link_libraries(${target} PRIVATE pelister_runtime)
+    # Tail calls in the generated code only become jumps once optimized.
+    if(CMAKE_CXX_COMPILER_ID MATCHES "GNU|Clang")
+        target_compile_options(${target} PRIVATE -O2)
+    endif()
+endfunction()
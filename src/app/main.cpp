@@ -3,17 +3,95 @@
 #include <vector>
 #include <filesystem>
 #include <fstream>
-#include <sstream>
+#include <cerrno>
 #include <cstdlib>
+#include <limits>
+#include <optional>
+#include <stdexcept>
 
 #include "lexer.hpp"
 #include "parser.hpp"
+#include "AstCache.hpp"
 #include "AstVisualizer.hpp"
 #include "Interpreter.hpp"
+#include "CppEmitter.hpp"
+#include "Image.hpp"
+#include "SourceFile.hpp"
 #include "linenoise.h"
 
-void runRepl() {
-    Interpreter interpreter;
+// The image to start from and the one to save once the program has run.
+// The entry point defaults to MAIN when the program defines it.
+struct ImageOptions {
+    std::string load;
+    std::string save;
+    std::string entry;
+};
+
+template <typename Cell>
+void openImage(BasicInterpreter<Cell>& interpreter, const ImageOptions& image) {
+    if (!image.load.empty()) {
+        interpreter.loadImage(image.load);
+    }
+}
+
+template <typename Cell>
+void saveImage(const BasicInterpreter<Cell>& interpreter, const ImageOptions& image) {
+    if (image.save.empty()) {
+        return;
+    }
+    std::string entry = image.entry;
+    if (entry.empty() && interpreter.getCodeSpace().dictionary.isDefined("MAIN")) {
+        entry = "MAIN";
+    }
+    interpreter.saveImage(image.save, entry);
+}
+
+// Parses `source`, or takes its tree from `cache` if it has one.
+Ast parseSource(std::string_view source, AstCache* cache) {
+    if (cache) {
+        if (std::optional<Ast> cached = cache->find(source)) {
+            return std::move(*cached);
+        }
+    }
+    Lexer lexer(source);
+    Parser parser(lexer);
+    Ast ast = parser.parse();
+    if (cache) {
+        cache->store(source, ast);
+    }
+    return ast;
+}
+
+void printCacheStats(const AstCache* cache) {
+    if (!cache) {
+        std::cerr << "Cache: disabled" << std::endl;
+        return;
+    }
+    const AstCache::Stats& stats = cache->stats();
+    size_t entries = 0;
+    uintmax_t bytes = 0;
+    std::error_code error;
+    for (std::filesystem::directory_iterator it(cache->directory(), error), end; !error && it != end;
+         it.increment(error)) {
+        if (it->path().extension() == ".ast") {
+            ++entries;
+            bytes += it->file_size(error);
+        }
+    }
+    std::cerr << "Cache: " << stats.hits << " hits, " << stats.misses << " misses, " << stats.writes
+              << " written, " << stats.failures << " failed; " << entries << " entries, " << bytes / 1024
+              << " KiB in " << cache->directory() << std::endl;
+}
+
+template <typename Cell>
+void runRepl(const InterpreterOptions& options, const ImageOptions& image) {
+    BasicInterpreter<Cell> interpreter(options);
+    try {
+        openImage(interpreter, image);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return;
+    }
     std::cout << "Pelister-Lang REPL v1.0. Type 'bye' or press Ctrl-D to exit." << std::endl;
     linenoiseHistoryLoad("history.txt");
     char* line_c;
@@ -32,7 +110,7 @@ void runRepl() {
             Lexer lexer(line);
             Parser parser(lexer);
             auto ast = parser.parse();
-            interpreter.evaluate(*ast);
+            interpreter.evaluate(ast);
             interpreter.printStack();
         } catch (const std::exception& e) {
             std::cerr << "Error: " << e.what() << std::endl;
@@ -40,41 +118,143 @@ void runRepl() {
     }
 }
 
-void runFile(const std::string& filepath, const std::string& vizPath) {
-    std::ifstream file(filepath);
-    if (!file.is_open()) {
-        std::cerr << "Error: Could not open file '" << filepath << "'" << std::endl;
-        return;
-    }
+// Runs a file, an image or an image followed by a file.
+template <typename Cell>
+void runFile(const std::string& filepath, const std::string& vizPath, const InterpreterOptions& options,
+             const ImageOptions& image, AstCache* cache) {
+    try {
+        BasicInterpreter<Cell> interpreter(options);
+        openImage(interpreter, image);
+        if (!filepath.empty()) {
+            SourceFile source(filepath);
+            Ast ast = parseSource(source.text(), cache);
 
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    std::string source_code = buffer.str();
+            if (!vizPath.empty()) {
+                AstVisualizer visualizer;
+                visualizer.generateDot(ast, vizPath);
+            }
+
+            interpreter.evaluate(ast, std::filesystem::path(filepath).parent_path().string());
+        }
+        std::cout << "Program finished. Final stack state:" << std::endl;
+        interpreter.printStack();
+        saveImage(interpreter, image);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+    }
+}
 
+// Parses and runs top-level statements as they are read, so the input can
+// be any size, or never end: a line at a time, or a bounded batch of the
+// statements on it. `-` streams standard input.
+template <typename Cell>
+void runStream(const std::string& filepath, const InterpreterOptions& options, const ImageOptions& image) {
     try {
-        Lexer lexer(source_code);
+        std::ifstream file;
+        if (filepath != "-") {
+            file.open(filepath, std::ios::binary);
+            if (!file.is_open()) {
+                throw std::runtime_error("Could not open file '" + filepath + "'");
+            }
+        }
+        Lexer lexer(filepath == "-" ? std::cin : file);
         Parser parser(lexer);
-        Interpreter interpreter;
-        auto ast = parser.parse();
-
-         if (!vizPath.empty()) {
-            AstVisualizer visualizer;
-            visualizer.generateDot(*ast, vizPath);
+        BasicInterpreter<Cell> interpreter(options);
+        openImage(interpreter, image);
+        std::string directory = filepath == "-" ? "" : std::filesystem::path(filepath).parent_path().string();
+        Ast statements;
+        while (parser.parseNext(statements, 256)) {
+            interpreter.evaluate(statements, directory);
         }
-
-        interpreter.evaluate(*ast);
         std::cout << "Program finished. Final stack state:" << std::endl;
         interpreter.printStack();
+        saveImage(interpreter, image);
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
     }
 }
 
+template <typename Cell>
+int emitFile(const std::string& filepath, const std::string& outPath, const InterpreterOptions& options,
+             AstCache* cache) {
+    try {
+        SourceFile source(filepath);
+        Ast ast = parseSource(source.text(), cache);
+
+        std::ofstream out(outPath);
+        if (!out.is_open()) {
+            std::cerr << "Error: Could not open file '" << outPath << "'" << std::endl;
+            return 1;
+        }
+        BasicCppEmitter<Cell> emitter(options, std::filesystem::path(filepath).filename().string());
+        emitter.emit(ast, out);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Parses a --memory size: a byte count, optionally followed by K, M or G
+// for KiB, MiB or GiB. Returns 0 when `text` is not a size.
+size_t parseMemorySize(const std::string& text) {
+    char* end = nullptr;
+    unsigned long long value = std::strtoull(text.c_str(), &end, 10);
+    if (end == text.c_str() || text[0] == '-') {
+        return 0;
+    }
+    int shift = 0;
+    switch (*end) {
+        case '\0': break;
+        case 'k': case 'K': shift = 10; ++end; break;
+        case 'm': case 'M': shift = 20; ++end; break;
+        case 'g': case 'G': shift = 30; ++end; break;
+        default: return 0;
+    }
+    if (*end != '\0' || value > (std::numeric_limits<size_t>::max() >> shift)) {
+        return 0;
+    }
+    return static_cast<size_t>(value) << shift;
+}
+
+// Parses a --stack-depth cell count. Returns 0 when `text` is not a
+// positive whole number.
+size_t parseCount(const std::string& text) {
+    char* end = nullptr;
+    errno = 0;
+    unsigned long long value = std::strtoull(text.c_str(), &end, 10);
+    if (end == text.c_str() || *end != '\0' || text[0] == '-' || errno == ERANGE ||
+        value > std::numeric_limits<size_t>::max()) {
+        return 0;
+    }
+    return static_cast<size_t>(value);
+}
+
 void printUsage(const char* program_name) {
     std::cout << "Usage: " << program_name << " [options] [filepath]" << std::endl;
     std::cout << "Options:" << std::endl;
     std::cout << "  --repl                Enter interactive REPL mode." << std::endl;
     std::cout << "  --visualize <path>    Generate an AST visualization .dot file at <path>." << std::endl;
+    std::cout << "  --cell <f64|i64|i32>  Select the cell type of the stacks and memory (default f64)." << std::endl;
+    std::cout << "  --stack-depth <n>     Capacity of the data stack in cells (default 4096)." << std::endl;
+    std::cout << "  --memory <size>       Bytes of memory, with an optional K, M or G suffix (default 65536\n"
+              << "                        cells). Pages are committed as they are first used." << std::endl;
+    std::cout << "  --huge-pages          Ask the OS to back memory with transparent huge pages." << std::endl;
+    std::cout << "  --tree-walk           Run the reference AST-walking interpreter instead of the bytecode VM." << std::endl;
+    std::cout << "  --opt-level <0-3>     Bytecode optimization: 0 none, 1 constant folding, 2 superinstructions,\n"
+              << "                        3 inlining and tail calls (default 3)." << std::endl;
+    std::cout << "  --dump-opt            Report every optimization that fires on stderr." << std::endl;
+    std::cout << "  --jit                 Compile bytecode to x86-64 machine code (f64 and i64 cells)." << std::endl;
+    std::cout << "  --emit-cpp <path>     Translate the program to a C++ source file at <path> instead of running it." << std::endl;
+    std::cout << "  --stream              Parse and run one statement at a time as the file is read; a filepath\n"
+              << "                        of - streams standard input." << std::endl;
+    std::cout << "  --save-image <path>   Run the program, then save its compiled words and memory as an image." << std::endl;
+    std::cout << "  --entry <word>        The word an image runs when loaded (default MAIN, if defined)." << std::endl;
+    std::cout << "  --image <path>        Start from an image instead of source; a filepath, if given, runs after\n"
+              << "                        its entry word. The cell type is the image's." << std::endl;
+    std::cout << "  --no-cache            Always parse the file; do not read or write the parse cache in\n"
+              << "                        $XDG_CACHE_HOME/pelilang." << std::endl;
+    std::cout << "  --cache-stats         Report parse cache hits, misses and size on stderr." << std::endl;
 }
 
 int main(int argc, char* argv[]) {
@@ -85,12 +265,68 @@ int main(int argc, char* argv[]) {
 
     std::string filepath;
     std::string vizPath;
+    std::string emitPath;
     bool replMode = false;
+    bool streamMode = false;
+    InterpreterOptions options;
+    ImageOptions image;
+    std::string cellType = "f64";
+    bool cellGiven = false;
+    bool useCache = true;
+    bool cacheStats = false;
+    size_t memoryBytes = 0;
 
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
         if (arg == "--repl") {
             replMode = true;
+        } else if (arg == "--cell") {
+            if (i + 1 < argc) {
+                cellType = argv[++i];
+                cellGiven = true;
+            } else {
+                std::cerr << "Error: --cell requires a type argument." << std::endl;
+                return 1;
+            }
+            if (cellType != "f64" && cellType != "i64" && cellType != "i32") {
+                std::cerr << "Error: Unknown cell type '" << cellType << "'" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--stack-depth") {
+            options.data_stack_depth = i + 1 < argc ? parseCount(argv[++i]) : 0;
+            if (options.data_stack_depth == 0) {
+                std::cerr << "Error: --stack-depth requires a positive cell count." << std::endl;
+                return 1;
+            }
+        } else if (arg == "--memory") {
+            memoryBytes = i + 1 < argc ? parseMemorySize(argv[++i]) : 0;
+            if (memoryBytes == 0) {
+                std::cerr << "Error: --memory requires a positive size such as 65536, 512K, 64M or 4G." << std::endl;
+                return 1;
+            }
+        } else if (arg == "--huge-pages") {
+            options.huge_pages = true;
+        } else if (arg == "--opt-level") {
+            char* end = nullptr;
+            long level = i + 1 < argc ? std::strtol(argv[++i], &end, 10) : -1;
+            if (!end || *end != '\0' || level < 0 || level > kMaxOptLevel) {
+                std::cerr << "Error: --opt-level requires a level from 0 to " << kMaxOptLevel << "." << std::endl;
+                return 1;
+            }
+            options.optimizer.level = static_cast<int>(level);
+        } else if (arg == "--dump-opt") {
+            options.optimizer.log = &std::cerr;
+        } else if (arg == "--jit") {
+            options.jit = true;
+        } else if (arg == "--tree-walk") {
+            options.mode = ExecutionMode::TreeWalk;
+        } else if (arg == "--emit-cpp") {
+            if (i + 1 < argc) {
+                emitPath = argv[++i];
+            } else {
+                std::cerr << "Error: --emit-cpp requires a path argument." << std::endl;
+                return 1;
+            }
         } else if (arg == "--visualize") {
             if (i + 1 < argc) {
                 vizPath = argv[++i];
@@ -98,6 +334,18 @@ int main(int argc, char* argv[]) {
                 std::cerr << "Error: --visualize requires a path argument." << std::endl;
                 return 1;
             }
+        } else if (arg == "--no-cache") {
+            useCache = false;
+        } else if (arg == "--cache-stats") {
+            cacheStats = true;
+        } else if (arg == "--stream") {
+            streamMode = true;
+        } else if (arg == "--image" || arg == "--save-image" || arg == "--entry") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: " << arg << " requires an argument." << std::endl;
+                return 1;
+            }
+            (arg == "--image" ? image.load : arg == "--save-image" ? image.save : image.entry) = argv[++i];
         } else if (arg.rfind("--", 0) != 0) {
             filepath = arg;
         } else {
@@ -107,10 +355,89 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    if (!image.load.empty()) {
+        try {
+            std::string imageCell = imageCellType(image.load);
+            if (cellGiven && imageCell != cellType) {
+                std::cerr << "Error: Image '" << image.load << "' holds " << imageCell << " cells, not "
+                          << cellType << "." << std::endl;
+                return 1;
+            }
+            cellType = imageCell;
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    if (!image.entry.empty() && image.save.empty()) {
+        std::cerr << "Error: --entry only applies to --save-image." << std::endl;
+        return 1;
+    }
+    if (!image.save.empty() && (replMode || (filepath.empty() && image.load.empty()))) {
+        std::cerr << "Error: --save-image requires a program file or an image." << std::endl;
+        return 1;
+    }
+    if (!emitPath.empty() && (!image.load.empty() || !image.save.empty())) {
+        std::cerr << "Error: --emit-cpp translates source and cannot use images." << std::endl;
+        return 1;
+    }
+
+    if (memoryBytes != 0) {
+        size_t cellSize = cellType == "i32" ? sizeof(int32_t) : sizeof(double);
+        options.memory_cells = memoryBytes / cellSize;
+        if (options.memory_cells == 0) {
+            std::cerr << "Error: --memory must hold at least one " << cellType << " cell." << std::endl;
+            return 1;
+        }
+    }
+
+    if (options.jit && (!PELI_JIT_AVAILABLE || cellType == "i32")) {
+        std::cerr << "Warning: --jit is not supported for " << cellType << " cells on this platform; "
+                  << "running on the bytecode VM." << std::endl;
+    }
+
+    streamMode = streamMode || filepath == "-";
+    if (streamMode && (!emitPath.empty() || !vizPath.empty())) {
+        std::cerr << "Error: --emit-cpp and --visualize need the whole program and cannot stream it." << std::endl;
+        return 1;
+    }
+
+    std::optional<AstCache> cache;
+    std::string cacheDir = AstCache::defaultDirectory();
+    if (useCache && !cacheDir.empty()) {
+        cache.emplace(cacheDir);
+    }
+    AstCache* parseCache = cache ? &*cache : nullptr;
+
+    if (!emitPath.empty()) {
+        if (filepath.empty()) {
+            std::cerr << "Error: --emit-cpp requires a program file." << std::endl;
+            return 1;
+        }
+        int status = cellType == "i64"   ? emitFile<int64_t>(filepath, emitPath, options, parseCache)
+                     : cellType == "i32" ? emitFile<int32_t>(filepath, emitPath, options, parseCache)
+                                         : emitFile<double>(filepath, emitPath, options, parseCache);
+        if (cacheStats) {
+            printCacheStats(parseCache);
+        }
+        return status;
+    }
+
     if (replMode) {
-        runRepl();
-    } else if (!filepath.empty()) {
-        runFile(filepath, vizPath);
+        if (cellType == "i64") runRepl<int64_t>(options, image);
+        else if (cellType == "i32") runRepl<int32_t>(options, image);
+        else runRepl<double>(options, image);
+    } else if (streamMode && !filepath.empty()) {
+        if (cellType == "i64") runStream<int64_t>(filepath, options, image);
+        else if (cellType == "i32") runStream<int32_t>(filepath, options, image);
+        else runStream<double>(filepath, options, image);
+    } else if (!filepath.empty() || !image.load.empty()) {
+        if (cellType == "i64") runFile<int64_t>(filepath, vizPath, options, image, parseCache);
+        else if (cellType == "i32") runFile<int32_t>(filepath, vizPath, options, image, parseCache);
+        else runFile<double>(filepath, vizPath, options, image, parseCache);
+        if (cacheStats) {
+            printCacheStats(parseCache);
+        }
     } else {
         printUsage(argv[0]);
     }
@@ -0,0 +1,452 @@
+#include "Analysis.hpp"
+#include "CodeRewriter.hpp"
+#include <algorithm>
+#include <set>
+#include <stdexcept>
+
+bool stackEffect(OpCode op, StackEffect& effect) {
+    switch (op) {
+        case OpCode::Lit: case OpCode::RFrom: case OpCode::RFetch:
+        case OpCode::LoopI: case OpCode::LoopJ: case OpCode::LoopK: case OpCode::LoopIndex:
+        case OpCode::FetchIOffset:
+            effect = {0, 1}; return true;
+        case OpCode::Add: case OpCode::Sub: case OpCode::Mul: case OpCode::Div: case OpCode::Mod:
+        case OpCode::Equals: case OpCode::LessThan: case OpCode::GreaterThan:
+        case OpCode::And: case OpCode::Or:
+        case OpCode::Accept: case OpCode::ToNumber:
+            effect = {2, 1}; return true;
+        case OpCode::Not: case OpCode::Fetch: case OpCode::CFetch: case OpCode::Square: case OpCode::AddI: case OpCode::MulI:
+            effect = {1, 1}; return true;
+        case OpCode::Dup:
+            effect = {1, 2}; return true;
+        case OpCode::Drop: case OpCode::ToR: case OpCode::Dot: case OpCode::JumpIfZero: case OpCode::PlusLoop:
+        case OpCode::Unmap:
+            effect = {1, 0}; return true;
+        case OpCode::Swap:
+            effect = {2, 2}; return true;
+        case OpCode::Over:
+            effect = {2, 3}; return true;
+        case OpCode::TwoDup:
+            effect = {2, 4}; return true;
+        case OpCode::Rot:
+            effect = {3, 3}; return true;
+        case OpCode::Store: case OpCode::CStore: case OpCode::Type: case OpCode::Do: case OpCode::QDo:
+        case OpCode::Erase:
+            effect = {2, 0}; return true;
+        case OpCode::MapFile: case OpCode::Scan:
+            effect = {3, 2}; return true;
+        case OpCode::Move: case OpCode::Fill:
+            effect = {3, 0}; return true;
+        case OpCode::Compare:
+            effect = {4, 1}; return true;
+        case OpCode::VAdd: case OpCode::VSub: case OpCode::VMul: case OpCode::VScale:
+            effect = {4, 0}; return true;
+        case OpCode::VSum: case OpCode::VMin: case OpCode::VMax:
+            effect = {2, 1}; return true;
+        case OpCode::VDot:
+            effect = {3, 1}; return true;
+        case OpCode::Search:
+            effect = {4, 3}; return true;
+        case OpCode::Check: case OpCode::DotS: case OpCode::Cr: case OpCode::Print:
+        case OpCode::Jump: case OpCode::Loop: case OpCode::Leave: case OpCode::Unloop: case OpCode::Define:
+        case OpCode::Exit: case OpCode::Halt:
+            effect = {0, 0}; return true;
+        case OpCode::Call: case OpCode::TailCall: case OpCode::Native:
+            return false;
+    }
+    return false;
+}
+
+// Runs `pops`/`pushes` at the current depth of `effect`.
+static void applyEffect(WordEffect& effect, int pops, int pushes) {
+    effect.net -= pops;
+    effect.need = std::max(effect.need, -effect.net);
+    effect.net += pushes;
+    effect.grow = std::max(effect.grow, effect.net);
+}
+
+// Runs a whole sub-body with effect `next` at the current depth of `effect`.
+static void chainEffect(WordEffect& effect, const WordEffect& next) {
+    effect.need = std::max(effect.need, next.need - effect.net);
+    effect.grow = std::max(effect.grow, effect.net + next.grow);
+    effect.net += next.net;
+    effect.known = effect.known && next.known;
+}
+
+StackEffectAnalyzer::StackEffectAnalyzer(const Dictionary& dictionary, std::string word)
+    : dictionary(dictionary), word(std::move(word)) {}
+
+WordEffect StackEffectAnalyzer::analyze(const std::vector<const AstNode*>& nodes) {
+    WordEffect effect;
+    effect.known = true;
+    for (const AstNode* node : nodes) {
+        analyzeNode(*node, effect);
+    }
+    return effect;
+}
+
+WordEffect StackEffectAnalyzer::analyze(const AstNode& block) {
+    WordEffect effect;
+    effect.known = true;
+    for (const AstNode& node : block.children()) {
+        analyzeNode(node, effect);
+    }
+    return effect;
+}
+
+void StackEffectAnalyzer::analyzeNode(const AstNode& node, WordEffect& effect) {
+    switch (node.kind()) {
+        case AstKind::Number:
+            applyEffect(effect, 0, 1);
+            return;
+        case AstKind::If: {
+            applyEffect(effect, 1, 0);
+            WordEffect taken = analyze(node.getTrueBranch());
+            WordEffect skipped = analyze(node.getFalseBranch());
+            if (taken.known && skipped.known && taken.net != skipped.net) {
+                if (!word.empty()) {
+                    throw std::runtime_error("IF branches in " + word + " leave the stack at different depths (" +
+                                             std::to_string(taken.net) + " vs " + std::to_string(skipped.net) + ")");
+                }
+                effect.known = false;
+                return;
+            }
+            WordEffect branches;
+            branches.known = taken.known && skipped.known;
+            branches.need = std::max(taken.need, skipped.need);
+            branches.grow = std::max(taken.grow, skipped.grow);
+            branches.net = taken.net;
+            chainEffect(effect, branches);
+            return;
+        }
+        case AstKind::DoLoop: {
+            applyEffect(effect, 2, 0);
+            WordEffect body = analyze(node.getBody());
+            if (node.isPlusLoop()) {
+                applyEffect(body, 1, 0);
+            }
+            // Only a body that leaves the depth unchanged has the same bounds on
+            // every iteration, including the one that never runs.
+            if (body.net != 0) {
+                effect.known = false;
+            }
+            chainEffect(effect, body);
+            return;
+        }
+        case AstKind::Definition:
+        case AstKind::Block:
+        case AstKind::Include:
+            // Binding a word leaves the stack alone; modules are run on
+            // their own.
+            return;
+        case AstKind::Word:
+            break;
+    }
+
+    Token token = node.getToken();
+    if (token.type == TokenType::DotQuote || token.type == TokenType::Unloop) {
+        return;
+    }
+    if (token.type == TokenType::Leave || token.type == TokenType::Exit) {
+        // The code after an early exit sees whatever depth it left at.
+        effect.known = false;
+        return;
+    }
+    OpCode op;
+    StackEffect primitive;
+    if (!dictionary.isDefined(token.symbol) && primitiveOpCode(token.type, op) && stackEffect(op, primitive)) {
+        applyEffect(effect, primitive.pops, primitive.pushes);
+        return;
+    }
+    // A callee checks its own requirements on entry, so the caller only
+    // depends on how far it moves the stack.
+    int32_t slot = dictionary.find(token.symbol);
+    if (slot >= 0 && dictionary.entry(slot) != Dictionary::unbound && dictionary.effect(slot).known) {
+        int net = dictionary.effect(slot).net;
+        applyEffect(effect, std::max(0, -net), std::max(0, net));
+        relied.push_back(slot);
+        return;
+    }
+    effect.known = false;
+}
+
+std::vector<Instruction> insertStackChecks(const std::vector<Instruction>& code, std::vector<size_t>& entries,
+                                           const WordEffect* proven) {
+    if (proven && proven->known) {
+        CodeRewriter rewriter(code);
+        for (size_t i = 0; i < code.size(); ++i) {
+            rewriter.begin(i);
+            if (i == 0 && (proven->need > 0 || proven->grow > 0)) {
+                rewriter.emit({OpCode::Check, packCheck(proven->need, proven->grow)});
+            }
+            if (isJump(code[i].op)) {
+                rewriter.emitSourceJump(code[i], i);
+            } else {
+                rewriter.emit(code[i]);
+            }
+        }
+        std::vector<Instruction> result = rewriter.finish();
+        for (size_t& entry : entries) {
+            entry = rewriter.map(entry);
+        }
+        return result;
+    }
+
+    // Bounds the size of a block so its requirement always fits in a Check.
+    const size_t maxBlockLength = kCheckLimit / 3;
+
+    std::vector<bool> leaders = findLeaders(code);
+    CodeRewriter rewriter(code);
+
+    size_t i = 0;
+    while (i < code.size()) {
+        int depth = 0, need = 0, grow = 0;
+        size_t end = i;
+        do {
+            StackEffect effect{0, 0};
+            stackEffect(code[end].op, effect);
+            depth -= effect.pops;
+            need = std::max(need, -depth);
+            depth += effect.pushes;
+            grow = std::max(grow, depth);
+            ++end;
+        } while (end < code.size() && !leaders[end] && end - i < maxBlockLength);
+
+        // Jumps into the block land on its Check.
+        size_t start = i;
+        rewriter.begin(start);
+        if (need > 0 || grow > 0) {
+            rewriter.emit({OpCode::Check, packCheck(need, grow)});
+        }
+        for (; i < end; ++i) {
+            if (i != start) {
+                rewriter.begin(i);
+            }
+            if (isJump(code[i].op)) {
+                rewriter.emitSourceJump(code[i], i);
+            } else {
+                rewriter.emit(code[i]);
+            }
+        }
+    }
+
+    std::vector<Instruction> result = rewriter.finish();
+    for (size_t& entry : entries) {
+        entry = rewriter.map(entry);
+    }
+    return result;
+}
+
+namespace {
+
+// What is known about the data stack before an instruction of a word: at
+// least `below` cells are on it and at least `above` more fit, `loops` DO
+// loops of the word are open, and, while `exact`, the word has pushed
+// `depth` cells since its entry.
+struct CheckedState {
+    int below = 0;
+    int above = 0;
+    int loops = 0;
+    int depth = 0;
+    bool exact = true;
+};
+
+class CheckVerifier {
+public:
+    CheckVerifier(const std::vector<Instruction>& code, const Dictionary& dictionary,
+                  const std::vector<PendingDefinition>& definitions)
+        : code(code), dictionary(dictionary), definitions(definitions), states(code.size()),
+          reached(code.size(), false) {}
+
+    // Verifies the word bound to `slot` starting at `entry`, and any nested
+    // definitions it binds.
+    bool verify(size_t entry, int32_t slot, std::string& problem) {
+        pending.push_back({entry, slot});
+        while (!pending.empty()) {
+            auto [next, owner] = pending.back();
+            pending.pop_back();
+            if (!verified.insert({next, owner}).second) {
+                continue;
+            }
+            if (!verifyWord(next, owner)) {
+                problem = error;
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    bool fail(const std::string& what, size_t at) {
+        error = what + " at instruction " + std::to_string(at);
+        return false;
+    }
+
+    // Callers rely on the net effect of a word only once it is marked, and
+    // the compiler keeps it from changing after that.
+    bool hasNet(int32_t slot) const {
+        return dictionary.isRelied(slot) && dictionary.effect(slot).known;
+    }
+
+    bool merge(size_t at, const CheckedState& state) {
+        if (at >= code.size()) {
+            return fail("runs past the end of its code", at - 1);
+        }
+        if (!reached[at]) {
+            reached[at] = true;
+            touched.push_back(at);
+            states[at] = state;
+            work.push_back(at);
+            return true;
+        }
+        CheckedState& known = states[at];
+        if (known.loops != state.loops) {
+            return fail("is reached inside different numbers of loops", at);
+        }
+        CheckedState merged = known;
+        merged.below = std::min(known.below, state.below);
+        merged.above = std::min(known.above, state.above);
+        merged.exact = known.exact && state.exact && known.depth == state.depth;
+        if (merged.below != known.below || merged.above != known.above || merged.exact != known.exact) {
+            known = merged;
+            work.push_back(at);
+        }
+        return true;
+    }
+
+    bool finish(const CheckedState& state, int32_t slot, size_t at) {
+        if (slot >= 0 && hasNet(slot) && (!state.exact || state.depth != dictionary.effect(slot).net)) {
+            return fail("returns at a depth other than its recorded effect", at);
+        }
+        return true;
+    }
+
+    bool verifyWord(size_t entry, int32_t slot) {
+        for (size_t at : touched) {
+            reached[at] = false;
+        }
+        touched.clear();
+        work.clear();
+        if (!merge(entry, CheckedState{})) {
+            return false;
+        }
+        while (!work.empty()) {
+            size_t at = work.back();
+            work.pop_back();
+            CheckedState state = states[at];
+            const Instruction& instr = code[at];
+            size_t target = static_cast<size_t>(static_cast<int64_t>(at) + instr.arg);
+
+            int loops = 0;
+            switch (instr.op) {
+                case OpCode::Loop: case OpCode::PlusLoop: case OpCode::Leave: case OpCode::Unloop:
+                case OpCode::LoopI: case OpCode::FetchIOffset:
+                    loops = 1; break;
+                case OpCode::LoopJ: loops = 2; break;
+                case OpCode::LoopK: loops = 3; break;
+                default: break;
+            }
+            if (state.loops < loops) {
+                return fail("uses a loop frame outside its DO", at);
+            }
+
+            StackEffect effect{0, 0};
+            if (instr.op == OpCode::Check) {
+                state.below = std::max(state.below, checkNeed(instr.arg));
+                state.above = std::max(state.above, checkGrow(instr.arg));
+            } else if (stackEffect(instr.op, effect)) {
+                if (state.below < effect.pops) {
+                    return fail("pops more than its stack checks allow", at);
+                }
+                state.below -= effect.pops;
+                state.above += effect.pops;
+                if (state.above < effect.pushes) {
+                    return fail("pushes more than its stack checks allow", at);
+                }
+                state.above -= effect.pushes;
+                state.below += effect.pushes;
+                state.depth += effect.pushes - effect.pops;
+            } else if (hasNet(instr.arg)) {
+                // Calls: the callee checks its own needs, so only its net
+                // effect carries over.
+                int net = dictionary.effect(instr.arg).net;
+                state.below = std::max(0, state.below + net);
+                state.above = std::max(0, state.above - net);
+                state.depth += net;
+            } else {
+                state.below = 0;
+                state.above = 0;
+                state.exact = false;
+            }
+
+            CheckedState inside = state;
+            CheckedState outside = state;
+            ++inside.loops;
+            --outside.loops;
+            bool ok = true;
+            switch (instr.op) {
+                case OpCode::Jump:
+                    ok = merge(target, state);
+                    break;
+                case OpCode::JumpIfZero:
+                    ok = merge(at + 1, state) && merge(target, state);
+                    break;
+                case OpCode::Do: case OpCode::QDo:
+                    ok = merge(at + 1, inside) && merge(target, state);
+                    break;
+                case OpCode::Loop: case OpCode::PlusLoop:
+                    ok = merge(target, state) && merge(at + 1, outside);
+                    break;
+                case OpCode::Leave:
+                    ok = merge(target, outside);
+                    break;
+                case OpCode::Unloop:
+                    ok = merge(at + 1, outside);
+                    break;
+                case OpCode::Exit: case OpCode::TailCall:
+                    ok = finish(state, slot, at);
+                    break;
+                case OpCode::Halt:
+                    break;
+                case OpCode::Define: {
+                    const PendingDefinition& definition = definitions[instr.arg];
+                    pending.push_back({definition.entry, definition.slot});
+                    ok = merge(at + 1, state);
+                    break;
+                }
+                default:
+                    ok = merge(at + 1, state);
+                    break;
+            }
+            if (!ok) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const std::vector<Instruction>& code;
+    const Dictionary& dictionary;
+    const std::vector<PendingDefinition>& definitions;
+    std::vector<CheckedState> states;
+    std::vector<bool> reached;
+    std::vector<size_t> touched;
+    std::vector<size_t> work;
+    std::vector<std::pair<size_t, int32_t>> pending;
+    std::set<std::pair<size_t, int32_t>> verified;
+    std::string error;
+};
+
+} // namespace
+
+bool verifyStackChecks(const std::vector<Instruction>& code, const Dictionary& dictionary,
+                       const std::vector<PendingDefinition>& definitions, std::string& problem) {
+    CheckVerifier verifier(code, dictionary, definitions);
+    for (size_t slot = 0; slot < dictionary.size(); ++slot) {
+        size_t entry = dictionary.entry(static_cast<int32_t>(slot));
+        if (entry != Dictionary::unbound && !verifier.verify(entry, static_cast<int32_t>(slot), problem)) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "ast.hpp"
+#include "Bytecode.hpp"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// How many data stack cells an instruction consumes and produces.
+struct StackEffect {
+    int pops;
+    int pushes;
+};
+
+// Looks up the fixed data stack effect of `op`; false for calls, whose effect
+// depends on whatever the slot is bound to when it runs.
+bool stackEffect(OpCode op, StackEffect& effect);
+
+// Computes the stack effect of top-level code or a colon definition from its
+// AST, using the fixed effects of primitives and the recorded effects of
+// words it calls. IF branches must agree on their net effect and DO bodies
+// must leave the depth unchanged for the result to be known; a definition
+// whose IF branches disagree is rejected outright.
+class StackEffectAnalyzer {
+public:
+    // `word` names the definition being analyzed; empty for top-level code.
+    StackEffectAnalyzer(const Dictionary& dictionary, std::string word);
+
+    WordEffect analyze(const std::vector<const AstNode*>& nodes);
+    WordEffect analyze(const AstNode& block);
+
+    // Slots whose recorded effect the last result depends on.
+    const std::vector<int32_t>& reliedSlots() const { return relied; }
+
+private:
+    void analyzeNode(const AstNode& node, WordEffect& effect);
+
+    const Dictionary& dictionary;
+    std::string word;
+    std::vector<int32_t> relied;
+};
+
+// Prefixes basic blocks with a Check for the depth they need and the growth
+// they cause, so the instructions inside run without checks of their own.
+// With a known `proven` effect the whole region is covered by a single Check
+// at its entry. `entries` holds region-local entry points that are remapped
+// in place.
+std::vector<Instruction> insertStackChecks(const std::vector<Instruction>& code, std::vector<size_t>& entries,
+                                           const WordEffect* proven = nullptr);
+
+// Checks that the Checks in `code` cover every word bound in `dictionary`:
+// no path from a word's entry pops or pushes past what the Checks before it
+// guarantee, uses a loop frame outside a DO of its own, or, for a word whose
+// net effect callers rely on, returns at any other depth. Calls only carry
+// such a net effect over, as the callee checks its own needs. Nested
+// definitions the words bind are verified too. Returns false and describes
+// the first problem in `problem` otherwise.
+bool verifyStackChecks(const std::vector<Instruction>& code, const Dictionary& dictionary,
+                       const std::vector<PendingDefinition>& definitions, std::string& problem);
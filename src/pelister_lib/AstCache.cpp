@@ -0,0 +1,124 @@
+#include "AstCache.hpp"
+#include "Hash.hpp"
+#include "SourceFile.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <system_error>
+
+namespace {
+
+constexpr char kMagic[8] = {'P', 'E', 'L', 'I', 'A', 'S', 'T', '\0'};
+
+// magic, version, token types, source size, source hash, payload checksum.
+constexpr size_t kHeaderSize = 8 + 4 + 4 + 8 + 8 + 8;
+
+// Word nodes record their TokenType by number, so adding a builtin has to
+// invalidate every entry as surely as a version bump does.
+constexpr uint32_t kTokenTypes = static_cast<uint32_t>(TokenType::Unknown) + 1;
+
+template <typename T>
+void put(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+T get(std::string_view bytes, size_t at) {
+    T value;
+    std::memcpy(&value, bytes.data() + at, sizeof(value));
+    return value;
+}
+
+std::string entryName(uint64_t hash) {
+    static const char digits[] = "0123456789abcdef";
+    std::string name(16, '0');
+    for (int i = 15; i >= 0; --i, hash >>= 4) {
+        name[i] = digits[hash & 15];
+    }
+    return name + ".ast";
+}
+
+} // namespace
+
+std::string AstCache::defaultDirectory() {
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) {
+        return (std::filesystem::path(xdg) / "pelilang").string();
+    }
+    if (const char* home = std::getenv("HOME"); home && *home) {
+        return (std::filesystem::path(home) / ".cache" / "pelilang").string();
+    }
+    return "";
+}
+
+std::string AstCache::entryPath(std::string_view source) const {
+    return pathFor(hashBytes(source));
+}
+
+std::string AstCache::pathFor(uint64_t hash) const {
+    return (std::filesystem::path(dir) / entryName(hash)).string();
+}
+
+std::optional<Ast> AstCache::find(std::string_view source) {
+    uint64_t hash = hashBytes(source);
+    std::string path = pathFor(hash);
+    std::error_code error;
+    if (!std::filesystem::is_regular_file(path, error)) {
+        ++counts.misses;
+        return std::nullopt;
+    }
+    try {
+        SourceFile entry(path);
+        std::string_view bytes = entry.text();
+        if (bytes.size() < kHeaderSize || std::memcmp(bytes.data(), kMagic, sizeof(kMagic)) != 0 ||
+            get<uint32_t>(bytes, 8) != kVersion || get<uint32_t>(bytes, 12) != kTokenTypes ||
+            get<uint64_t>(bytes, 16) != source.size() || get<uint64_t>(bytes, 24) != hash ||
+            get<uint64_t>(bytes, 32) != hashBytes(bytes.substr(kHeaderSize))) {
+            throw std::runtime_error("stale or damaged cache entry");
+        }
+        Ast ast = Ast::deserialize(bytes.substr(kHeaderSize));
+        ++counts.hits;
+        return ast;
+    } catch (const std::exception&) {
+        ++counts.misses;
+        ++counts.failures;
+        return std::nullopt;
+    }
+}
+
+void AstCache::store(std::string_view source, const Ast& ast) {
+    uint64_t hash = hashBytes(source);
+    std::string payload = ast.serialize();
+    std::string header(kMagic, sizeof(kMagic));
+    put<uint32_t>(header, kVersion);
+    put<uint32_t>(header, kTokenTypes);
+    put<uint64_t>(header, source.size());
+    put<uint64_t>(header, hash);
+    put<uint64_t>(header, hashBytes(payload));
+
+    // Written beside the entry under a name no other run will pick, then
+    // renamed over it in one step.
+    std::string path = pathFor(hash);
+    std::string temporary = path + "." + std::to_string(std::random_device{}()) + ".tmp";
+    std::error_code error;
+    std::filesystem::create_directories(dir, error);
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(header.data(), static_cast<std::streamsize>(header.size()));
+        out.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+        if (!out.flush()) {
+            error = std::make_error_code(std::errc::io_error);
+        }
+    }
+    if (!error) {
+        std::filesystem::rename(temporary, path, error);
+    }
+    if (error) {
+        std::filesystem::remove(temporary, error);
+        ++counts.failures;
+        return;
+    }
+    ++counts.writes;
+}
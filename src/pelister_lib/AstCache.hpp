@@ -0,0 +1,53 @@
+#pragma once
+
+#include "ast.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Parsed programs kept on disk, so running an unchanged file again skips
+// the lexer and parser. Entries are keyed by a hash of the source text and
+// hold the flat tree (see Ast::serialize) along with the source's size and
+// hash, a format version and a checksum. An entry that fails any of those
+// checks is a miss, and is replaced once the source has been parsed again.
+//
+// Entries are written to a temporary file that is then renamed into place,
+// so concurrent runs never see a partial one. Failing to read or write the
+// cache never fails a run; it is only counted.
+class AstCache {
+public:
+    // Bump whenever the serialized tree changes meaning.
+    static constexpr uint32_t kVersion = 3;
+
+    struct Stats {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t writes = 0;
+        // Entries that could not be written, or were found damaged.
+        size_t failures = 0;
+    };
+
+    // $XDG_CACHE_HOME/pelilang, or ~/.cache/pelilang without it; empty when
+    // neither variable is set.
+    static std::string defaultDirectory();
+
+    explicit AstCache(std::string directory) : dir(std::move(directory)) {}
+
+    // The tree cached for `source`, if there is a sound one.
+    std::optional<Ast> find(std::string_view source);
+    // Caches `ast`, parsed from `source`.
+    void store(std::string_view source, const Ast& ast);
+
+    // Where the entry for `source` lives.
+    std::string entryPath(std::string_view source) const;
+    const std::string& directory() const { return dir; }
+    const Stats& stats() const { return counts; }
+
+private:
+    std::string pathFor(uint64_t hash) const;
+
+    std::string dir;
+    Stats counts;
+};
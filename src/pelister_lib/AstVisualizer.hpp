@@ -5,7 +5,7 @@
 
 class AstVisualizer {
 public:
-    void generateDot(const AstNode& root, const std::string& outputPath);
+    void generateDot(const Ast& ast, const std::string& outputPath);
 
 private:
     void generateDotRecursive(const AstNode& node, std::ostream& out);
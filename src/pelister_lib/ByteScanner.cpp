@@ -0,0 +1,168 @@
+#include "ByteScanner.hpp"
+
+#if PELI_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr bool isSpace(char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+const char* skipSpaceScalar(const char* p, const char* end) {
+    while (p < end && isSpace(*p)) {
+        ++p;
+    }
+    return p;
+}
+
+const char* findSpaceScalar(const char* p, const char* end) {
+    while (p < end && !isSpace(*p)) {
+        ++p;
+    }
+    return p;
+}
+
+const char* findParenScalar(const char* p, const char* end) {
+    while (p < end && *p != '(' && *p != ')') {
+        ++p;
+    }
+    return p;
+}
+
+constexpr ByteScanner scalarScanner{"scalar", skipSpaceScalar, findSpaceScalar, findParenScalar};
+
+#if PELI_SIMD_X86
+
+// A byte is whitespace when it is ' ' or, less 9, at most 4 ('\t' to '\r'),
+// comparing unsigned: min(x, 4) == x.
+inline unsigned spaceMask(__m128i bytes) {
+    __m128i offset = _mm_sub_epi8(bytes, _mm_set1_epi8('\t'));
+    __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(offset, _mm_set1_epi8(4)), offset);
+    __m128i blank = _mm_cmpeq_epi8(bytes, _mm_set1_epi8(' '));
+    return static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(control, blank)));
+}
+
+inline unsigned parenMask(__m128i bytes) {
+    __m128i open = _mm_cmpeq_epi8(bytes, _mm_set1_epi8('('));
+    __m128i close = _mm_cmpeq_epi8(bytes, _mm_set1_epi8(')'));
+    return static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(open, close)));
+}
+
+// Most runs are a byte or two long, so the first byte is checked on its
+// own before any vector is loaded.
+const char* skipSpaceSse2(const char* p, const char* end) {
+    if (p < end && !isSpace(*p)) {
+        return p;
+    }
+    for (; end - p >= 16; p += 16) {
+        unsigned mask = ~spaceMask(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))) & 0xFFFF;
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return skipSpaceScalar(p, end);
+}
+
+const char* findSpaceSse2(const char* p, const char* end) {
+    for (; end - p >= 16; p += 16) {
+        unsigned mask = spaceMask(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return findSpaceScalar(p, end);
+}
+
+const char* findParenSse2(const char* p, const char* end) {
+    for (; end - p >= 16; p += 16) {
+        unsigned mask = parenMask(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return findParenScalar(p, end);
+}
+
+constexpr ByteScanner sse2Scanner{"sse2", skipSpaceSse2, findSpaceSse2, findParenSse2};
+
+#define PELI_AVX2 __attribute__((target("avx2")))
+
+PELI_AVX2 inline unsigned spaceMask(__m256i bytes) {
+    __m256i offset = _mm256_sub_epi8(bytes, _mm256_set1_epi8('\t'));
+    __m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(offset, _mm256_set1_epi8(4)), offset);
+    __m256i blank = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' '));
+    return static_cast<unsigned>(_mm256_movemask_epi8(_mm256_or_si256(control, blank)));
+}
+
+PELI_AVX2 inline unsigned parenMask(__m256i bytes) {
+    __m256i open = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('('));
+    __m256i close = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(')'));
+    return static_cast<unsigned>(_mm256_movemask_epi8(_mm256_or_si256(open, close)));
+}
+
+PELI_AVX2 const char* skipSpaceAvx2(const char* p, const char* end) {
+    if (p < end && !isSpace(*p)) {
+        return p;
+    }
+    for (; end - p >= 32; p += 32) {
+        unsigned mask = ~spaceMask(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return skipSpaceSse2(p, end);
+}
+
+PELI_AVX2 const char* findSpaceAvx2(const char* p, const char* end) {
+    for (; end - p >= 32; p += 32) {
+        unsigned mask = spaceMask(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return findSpaceSse2(p, end);
+}
+
+PELI_AVX2 const char* findParenAvx2(const char* p, const char* end) {
+    for (; end - p >= 32; p += 32) {
+        unsigned mask = parenMask(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return findParenSse2(p, end);
+}
+
+#undef PELI_AVX2
+
+constexpr ByteScanner avx2Scanner{"avx2", skipSpaceAvx2, findSpaceAvx2, findParenAvx2};
+
+bool hasAvx2() {
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif
+
+} // namespace
+
+const ByteScanner& ByteScanner::best() {
+#if PELI_SIMD_X86
+    static const ByteScanner& chosen = hasAvx2() ? avx2Scanner : sse2Scanner;
+    return chosen;
+#else
+    return scalarScanner;
+#endif
+}
+
+std::vector<const ByteScanner*> ByteScanner::available() {
+    std::vector<const ByteScanner*> scanners = {&scalarScanner};
+#if PELI_SIMD_X86
+    scanners.push_back(&sse2Scanner);
+    if (hasAvx2()) {
+        scanners.push_back(&avx2Scanner);
+    }
+#endif
+    return scanners;
+}
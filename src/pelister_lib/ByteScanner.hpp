@@ -0,0 +1,27 @@
+#pragma once
+
+#include "Simd.hpp"
+#include <vector>
+
+// SSE2 is part of x86-64; AVX2 is compiled in alongside it and chosen at
+// run time when the CPU has it. Elsewhere only the scalar scanner exists.
+
+// Finds the bytes the lexer splits source on, 16 or 32 at a time where the
+// CPU allows. Every scan looks at [begin, end) and returns the first byte of
+// the class it is after, or `end` when there is none. Whitespace is what
+// std::isspace accepts in the "C" locale.
+struct ByteScanner {
+    const char* name;
+    // The first byte that is not whitespace.
+    const char* (*skipSpace)(const char* begin, const char* end);
+    // The first whitespace byte.
+    const char* (*findSpace)(const char* begin, const char* end);
+    // The first '(' or ')'.
+    const char* (*findParen)(const char* begin, const char* end);
+
+    // The fastest scanner this CPU supports.
+    static const ByteScanner& best();
+    // Every scanner this CPU supports, scalar first, for tests and
+    // benchmarks to compare.
+    static std::vector<const ByteScanner*> available();
+};
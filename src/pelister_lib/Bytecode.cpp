@@ -0,0 +1,119 @@
+#include "Bytecode.hpp"
+#include <sstream>
+
+bool primitiveOpCode(TokenType type, OpCode& op) {
+    switch (type) {
+        case TokenType::Plus: op = OpCode::Add; return true;
+        case TokenType::Minus: op = OpCode::Sub; return true;
+        case TokenType::Multiply: op = OpCode::Mul; return true;
+        case TokenType::Divide: op = OpCode::Div; return true;
+        case TokenType::Mod: op = OpCode::Mod; return true;
+        case TokenType::Equals: op = OpCode::Equals; return true;
+        case TokenType::LessThan: op = OpCode::LessThan; return true;
+        case TokenType::GreaterThan: op = OpCode::GreaterThan; return true;
+        case TokenType::And: op = OpCode::And; return true;
+        case TokenType::Or: op = OpCode::Or; return true;
+        case TokenType::Not: op = OpCode::Not; return true;
+        case TokenType::Dup: op = OpCode::Dup; return true;
+        case TokenType::Drop: op = OpCode::Drop; return true;
+        case TokenType::Swap: op = OpCode::Swap; return true;
+        case TokenType::Over: op = OpCode::Over; return true;
+        case TokenType::Rot: op = OpCode::Rot; return true;
+        case TokenType::ToR: op = OpCode::ToR; return true;
+        case TokenType::RFrom: op = OpCode::RFrom; return true;
+        case TokenType::RFetch: op = OpCode::RFetch; return true;
+        case TokenType::Store: op = OpCode::Store; return true;
+        case TokenType::Fetch: op = OpCode::Fetch; return true;
+        case TokenType::CStore: op = OpCode::CStore; return true;
+        case TokenType::CFetch: op = OpCode::CFetch; return true;
+        case TokenType::LoopIndexI: op = OpCode::LoopI; return true;
+        case TokenType::LoopIndexJ: op = OpCode::LoopJ; return true;
+        case TokenType::LoopIndexK: op = OpCode::LoopK; return true;
+        case TokenType::Dot: op = OpCode::Dot; return true;
+        case TokenType::DotS: op = OpCode::DotS; return true;
+        case TokenType::Cr: op = OpCode::Cr; return true;
+        case TokenType::Accept: op = OpCode::Accept; return true;
+        case TokenType::ToNumber: op = OpCode::ToNumber; return true;
+        case TokenType::Type: op = OpCode::Type; return true;
+        case TokenType::MapFile: op = OpCode::MapFile; return true;
+        case TokenType::Unmap: op = OpCode::Unmap; return true;
+        case TokenType::Move: op = OpCode::Move; return true;
+        case TokenType::Fill: op = OpCode::Fill; return true;
+        case TokenType::Erase: op = OpCode::Erase; return true;
+        case TokenType::Compare: op = OpCode::Compare; return true;
+        case TokenType::Search: op = OpCode::Search; return true;
+        case TokenType::Scan: op = OpCode::Scan; return true;
+        case TokenType::VAdd: op = OpCode::VAdd; return true;
+        case TokenType::VSub: op = OpCode::VSub; return true;
+        case TokenType::VMul: op = OpCode::VMul; return true;
+        case TokenType::VScale: op = OpCode::VScale; return true;
+        case TokenType::VSum: op = OpCode::VSum; return true;
+        case TokenType::VDot: op = OpCode::VDot; return true;
+        case TokenType::VMin: op = OpCode::VMin; return true;
+        case TokenType::VMax: op = OpCode::VMax; return true;
+        default: return false;
+    }
+}
+
+const char* opcodeName(OpCode op) {
+    static const char* const names[] = {
+#define PELI_OPCODE_NAME(name) #name,
+        PELI_OPCODES(PELI_OPCODE_NAME)
+#undef PELI_OPCODE_NAME
+    };
+    return names[static_cast<size_t>(op)];
+}
+
+template <typename Cell>
+std::string disassemble(const BasicCodeSpace<Cell>& space, size_t begin, size_t end) {
+    std::ostringstream out;
+    for (size_t i = begin; i < end && i < space.code.size(); ++i) {
+        const Instruction& instr = space.code[i];
+        out << i << ": " << opcodeName(instr.op);
+        switch (instr.op) {
+            case OpCode::Check:
+                out << " need " << checkNeed(instr.arg) << " grow " << checkGrow(instr.arg);
+                break;
+            case OpCode::Lit:
+            case OpCode::AddI:
+            case OpCode::MulI:
+            case OpCode::FetchIOffset:
+                out << " " << space.constants[instr.arg];
+                break;
+            case OpCode::Print:
+                out << " \"" << space.strings[instr.arg] << "\"";
+                break;
+            case OpCode::Call:
+            case OpCode::TailCall:
+                out << " " << space.dictionary.name(instr.arg);
+                break;
+            case OpCode::Native:
+                out << " run " << instr.arg << " (" << opcodeName(space.original(i).op) << ")";
+                break;
+            case OpCode::Define:
+                out << " " << space.dictionary.name(space.definitions[instr.arg].slot)
+                    << " @" << space.definitions[instr.arg].entry;
+                break;
+            case OpCode::LoopIndex:
+                out << " " << instr.arg;
+                break;
+            case OpCode::Jump:
+            case OpCode::JumpIfZero:
+            case OpCode::Do:
+            case OpCode::QDo:
+            case OpCode::Loop:
+            case OpCode::PlusLoop:
+            case OpCode::Leave:
+                out << " -> " << static_cast<long>(i) + instr.arg;
+                break;
+            default:
+                break;
+        }
+        out << "\n";
+    }
+    return out.str();
+}
+
+#define PELI_INSTANTIATE_DISASSEMBLE(Cell) \
+    template std::string disassemble<Cell>(const BasicCodeSpace<Cell>&, size_t, size_t);
+PELI_CELL_TYPES(PELI_INSTANTIATE_DISASSEMBLE)
@@ -0,0 +1,213 @@
+#pragma once
+
+#include "Cell.hpp"
+#include "Dictionary.hpp"
+#include "lexer.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Every opcode understood by the VM. The list is expanded into the enum, the
+// name table used for disassembly and the dispatch table of the VM, so the
+// three always stay in the same order.
+#define PELI_OPCODES(X) \
+    X(Check)            \
+    X(Lit)              \
+    X(Add)              \
+    X(Sub)              \
+    X(Mul)              \
+    X(Div)              \
+    X(Mod)              \
+    X(Equals)           \
+    X(LessThan)         \
+    X(GreaterThan)      \
+    X(And)              \
+    X(Or)               \
+    X(Not)              \
+    X(Dup)              \
+    X(Drop)             \
+    X(Swap)             \
+    X(Over)             \
+    X(Rot)              \
+    X(ToR)              \
+    X(RFrom)            \
+    X(RFetch)           \
+    X(Store)            \
+    X(Fetch)            \
+    X(CStore)           \
+    X(CFetch)           \
+    X(LoopI)            \
+    X(LoopJ)            \
+    X(LoopK)            \
+    X(LoopIndex)        \
+    X(Dot)              \
+    X(DotS)             \
+    X(Cr)               \
+    X(Print)            \
+    X(Accept)           \
+    X(ToNumber)         \
+    X(Type)             \
+    X(MapFile)          \
+    X(Unmap)            \
+    X(Move)             \
+    X(Fill)             \
+    X(Erase)            \
+    X(Compare)          \
+    X(Search)           \
+    X(Scan)             \
+    X(VAdd)             \
+    X(VSub)             \
+    X(VMul)             \
+    X(VScale)           \
+    X(VSum)             \
+    X(VDot)             \
+    X(VMin)             \
+    X(VMax)             \
+    X(Jump)             \
+    X(JumpIfZero)       \
+    X(Do)               \
+    X(Loop)             \
+    X(QDo)              \
+    X(PlusLoop)         \
+    X(Leave)            \
+    X(Unloop)           \
+    X(Call)             \
+    X(TailCall)         \
+    X(Define)           \
+    X(Exit)             \
+    X(Halt)             \
+    X(TwoDup)           \
+    X(Square)           \
+    X(AddI)             \
+    X(MulI)             \
+    X(FetchIOffset)     \
+    X(Native)
+
+enum class OpCode : uint8_t {
+#define PELI_OPCODE_ENUM(name) name,
+    PELI_OPCODES(PELI_OPCODE_ENUM)
+#undef PELI_OPCODE_ENUM
+};
+
+const char* opcodeName(OpCode op);
+
+// Maps a builtin token to the opcode that implements it; false for tokens
+// that are not simple primitives (control flow, unknown words, ...).
+bool primitiveOpCode(TokenType type, OpCode& op);
+
+// A single VM instruction. Operands are inline: Lit, AddI, MulI and
+// FetchIOffset index the constant pool, Print the string pool, Call and
+// TailCall name a dictionary slot, Native names a JIT run, LoopIndex the
+// loop level (1 for I), Check packs a stack requirement (see packCheck) and
+// jumps carry an offset relative to the jump itself. The Do and QDo target
+// is the instruction after the matching Loop or PlusLoop, which jump back to
+// the instruction after the Do; Leave jumps to the loop's end.
+struct Instruction {
+    OpCode op;
+    int32_t arg;
+};
+
+inline bool isJump(OpCode op) {
+    switch (op) {
+        case OpCode::Jump: case OpCode::JumpIfZero:
+        case OpCode::Do: case OpCode::QDo: case OpCode::Loop: case OpCode::PlusLoop: case OpCode::Leave:
+            return true;
+        default:
+            return false;
+    }
+}
+
+inline bool isLoopStart(OpCode op) {
+    return op == OpCode::Do || op == OpCode::QDo;
+}
+
+inline bool isLoopEnd(OpCode op) {
+    return op == OpCode::Loop || op == OpCode::PlusLoop;
+}
+
+// A Check guards a basic block: it holds the data stack depth the block needs
+// on entry and the most the block grows the stack by while it runs.
+constexpr int kCheckLimit = 0x7FFF;
+
+inline int32_t packCheck(int need, int grow) {
+    return static_cast<int32_t>(need | (grow << 16));
+}
+
+inline int checkNeed(int32_t arg) {
+    return arg & 0xFFFF;
+}
+
+inline int checkGrow(int32_t arg) {
+    return (arg >> 16) & 0xFFFF;
+}
+
+// A colon definition nested inside IF/DO or another definition, bound when
+// its Define instruction executes rather than when it is compiled.
+struct PendingDefinition {
+    int32_t slot;
+    size_t entry;
+};
+
+// A copy of a word's body laid out in place of a call to it, spanning
+// [begin, end) of the code space.
+struct InlineSite {
+    int32_t slot;
+    size_t begin;
+    size_t end;
+};
+
+// The code space shared by every compiled word and top-level segment, along
+// with the dictionary that maps word slots to entry points within it.
+template <typename Cell>
+struct BasicCodeSpace {
+    Dictionary dictionary;
+    std::vector<Instruction> code;
+    std::vector<Cell> constants;
+    std::vector<std::string> strings;
+    std::vector<PendingDefinition> definitions;
+    // Words small enough to inline, keyed by slot: the length of the body at
+    // the slot's entry, not counting its final Exit.
+    std::unordered_map<int32_t, size_t> inline_bodies;
+    std::vector<InlineSite> inline_sites;
+    // Instructions the JIT replaced with a Native entry, keyed by position.
+    std::unordered_map<size_t, Instruction> displaced;
+
+    // The instruction the compiler laid out at `at`, before any JIT entry.
+    Instruction original(size_t at) const {
+        auto found = displaced.find(at);
+        return found == displaced.end() ? code[at] : found->second;
+    }
+
+    // Binds `slot` to `entry`. Sites that inlined the previous body are
+    // turned back into a Call followed by a Jump over the stale copy, so
+    // redefinitions still reach every caller.
+    void bind(int32_t slot, size_t entry) {
+        dictionary.bind(slot, entry);
+        inline_bodies.erase(slot);
+        auto stale = std::remove_if(inline_sites.begin(), inline_sites.end(), [&](const InlineSite& site) {
+            if (site.slot != slot) {
+                return false;
+            }
+            code[site.begin] = {OpCode::Call, slot};
+            displaced.erase(site.begin);
+            if (site.end - site.begin > 1) {
+                code[site.begin + 1] = {OpCode::Jump, static_cast<int32_t>(site.end - site.begin - 1)};
+                displaced.erase(site.begin + 1);
+            }
+            return true;
+        });
+        inline_sites.erase(stale, inline_sites.end());
+    }
+};
+
+using CodeSpace = BasicCodeSpace<double>;
+
+template <typename Cell>
+std::string disassemble(const BasicCodeSpace<Cell>& space, size_t begin, size_t end);
+
+#define PELI_DECLARE_DISASSEMBLE(Cell) \
+    extern template std::string disassemble<Cell>(const BasicCodeSpace<Cell>&, size_t, size_t);
+PELI_CELL_TYPES(PELI_DECLARE_DISASSEMBLE)
+#undef PELI_DECLARE_DISASSEMBLE
@@ -0,0 +1,49 @@
+#include "CodeRewriter.hpp"
+
+CodeRewriter::CodeRewriter(const std::vector<Instruction>& source)
+    : source(source), mapping(source.size() + 1, npos) {}
+
+void CodeRewriter::begin(size_t index) {
+    mapping[index] = output.size();
+}
+
+void CodeRewriter::emit(Instruction instr) {
+    output.push_back(instr);
+}
+
+void CodeRewriter::emitSourceJump(Instruction instr, size_t origin) {
+    jumps.emplace_back(output.size(), static_cast<size_t>(static_cast<long>(origin) + instr.arg));
+    output.push_back(instr);
+}
+
+std::vector<Instruction> CodeRewriter::finish() {
+    // Instructions that were folded away map to whatever follows them.
+    mapping[source.size()] = output.size();
+    for (size_t i = source.size(); i-- > 0;) {
+        if (mapping[i] == npos) {
+            mapping[i] = mapping[i + 1];
+        }
+    }
+    for (const auto& [at, target] : jumps) {
+        output[at].arg = static_cast<int32_t>(static_cast<long>(mapping[target]) - static_cast<long>(at));
+    }
+    return std::move(output);
+}
+
+std::vector<bool> findLeaders(const std::vector<Instruction>& code) {
+    std::vector<bool> leaders(code.size() + 1, false);
+    if (!code.empty()) {
+        leaders[0] = true;
+    }
+    for (size_t i = 0; i < code.size(); ++i) {
+        OpCode op = code[i].op;
+        if (isJump(op)) {
+            leaders[static_cast<long>(i) + code[i].arg] = true;
+        }
+        if (isJump(op) || op == OpCode::Call || op == OpCode::TailCall || op == OpCode::Exit || op == OpCode::Halt) {
+            leaders[i + 1] = true;
+        }
+    }
+    leaders.resize(code.size());
+    return leaders;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Bytecode.hpp"
+#include <cstddef>
+#include <vector>
+
+// Rebuilds a region of bytecode while keeping its relative jumps valid.
+// Passes walk the source, call begin() for each source instruction they
+// translate and emit() its replacement; source instructions that were folded
+// into a neighbour are simply never begun. Jumps copied from the source are
+// retargeted by finish() to wherever their target's translation landed.
+class CodeRewriter {
+public:
+    explicit CodeRewriter(const std::vector<Instruction>& source);
+
+    void begin(size_t index);
+    void emit(Instruction instr);
+    // Emits a jump whose offset still refers to source position `origin`.
+    void emitSourceJump(Instruction instr, size_t origin);
+    std::vector<Instruction> finish();
+
+    // Where source instruction `index` starts in the output; valid after finish().
+    size_t map(size_t index) const { return mapping[index]; }
+    size_t size() const { return output.size(); }
+
+private:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    const std::vector<Instruction>& source;
+    std::vector<Instruction> output;
+    std::vector<size_t> mapping;
+    std::vector<std::pair<size_t, size_t>> jumps; // (output index, source target)
+};
+
+// Marks every instruction that starts a basic block: the region entry, jump
+// targets and whatever follows a jump, call or return.
+std::vector<bool> findLeaders(const std::vector<Instruction>& code);
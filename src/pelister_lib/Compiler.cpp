@@ -0,0 +1,337 @@
+#include "Compiler.hpp"
+#include "Analysis.hpp"
+#include "CodeRewriter.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+template <typename Cell>
+BasicCompiler<Cell>::BasicCompiler(BasicCodeSpace<Cell>& space, const OptimizerOptions& optimizer)
+    : space(space), optimizer(optimizer) {}
+
+template <typename Cell>
+size_t BasicCompiler<Cell>::compileDefinition(const std::string& name, const AstNode& body) {
+    int32_t slot = space.dictionary.intern(name);
+    StackEffectAnalyzer analyzer(space.dictionary, name);
+    WordEffect effect = analyzer.analyze(body);
+
+    compileBody(body);
+    emit(OpCode::Exit);
+    // A body with more than one Exit, from EXIT or from laying out nested
+    // definitions, cannot be copied into its callers.
+    bool inlinable = std::count_if(region.begin(), region.end(),
+                                   [](const Instruction& instr) { return instr.op == OpCode::Exit; }) == 1;
+    if (!inlinable) {
+        effect.known = false;
+    }
+    checkRebinding(slot, effect);
+
+    size_t entry = finishRegion(name, slot, effect);
+    for (int32_t callee : analyzer.reliedSlots()) {
+        space.dictionary.markRelied(callee);
+    }
+    space.dictionary.setEffect(slot, effect);
+    space.bind(slot, entry);
+    size_t length = space.code.size() - entry - 1;
+    if (inlinable && length > 0 && length <= kInlineLimit) {
+        space.inline_bodies[slot] = length;
+    }
+    return entry;
+}
+
+template <typename Cell>
+void BasicCompiler<Cell>::checkRebinding(int32_t slot, const WordEffect& effect) {
+    if (!space.dictionary.isRelied(slot)) {
+        return;
+    }
+    const WordEffect& previous = space.dictionary.effect(slot);
+    if (!effect.known || effect.net != previous.net) {
+        throw std::runtime_error("Redefinition of " + space.dictionary.name(slot) +
+                                 " changes its stack effect, which compiled words rely on");
+    }
+}
+
+template <typename Cell>
+size_t BasicCompiler<Cell>::compileSegment(const std::vector<const AstNode*>& nodes) {
+    StackEffectAnalyzer analyzer(space.dictionary, "");
+    WordEffect effect = analyzer.analyze(nodes);
+
+    for (const AstNode* node : nodes) {
+        compileNode(*node);
+    }
+    emit(OpCode::Halt);
+    if (!region_definitions.empty()) {
+        effect.known = false;
+    }
+    return finishRegion("top level", -1, effect);
+}
+
+template <typename Cell>
+size_t BasicCompiler<Cell>::finishRegion(const std::string& where, int32_t self, const WordEffect& effect) {
+    std::vector<size_t> entries = {0};
+    for (size_t index : region_definitions) {
+        entries.push_back(space.definitions[index].entry);
+    }
+
+    // Every rewrite keeps or lowers the depth needed and the peak reached at
+    // each point, so the effect proven from the AST still bounds the result.
+    std::vector<Instruction> optimized = optimizeRegion(region, space.constants, entries, optimizer, where);
+
+    WordEffect proven = effect;
+    if (proven.need > kCheckLimit || proven.grow > kCheckLimit) {
+        proven.known = false;
+    }
+    std::vector<Instruction> code = insertStackChecks(optimized, entries, &proven);
+
+    // Inlining works on checked code: a copied body brings its own entry
+    // Check, and the Call it replaces already ended the caller's block.
+    std::vector<InlineSite> sites;
+    if (optimizer.level >= 3) {
+        code = inlineCalls(code, entries, self, where, sites);
+        markTailCalls(code, where);
+    }
+
+    size_t base = space.code.size();
+    space.code.insert(space.code.end(), code.begin(), code.end());
+    for (InlineSite& site : sites) {
+        space.inline_sites.push_back({site.slot, base + site.begin, base + site.end});
+    }
+    for (size_t i = 0; i < region_definitions.size(); ++i) {
+        space.definitions[region_definitions[i]].entry = base + entries[i + 1];
+    }
+
+    region.clear();
+    region_definitions.clear();
+    return base + entries[0];
+}
+
+template <typename Cell>
+std::vector<Instruction> BasicCompiler<Cell>::inlineCalls(const std::vector<Instruction>& code,
+                                                          std::vector<size_t>& entries, int32_t self,
+                                                          const std::string& where,
+                                                          std::vector<InlineSite>& sites) {
+    CodeRewriter rewriter(code);
+    for (size_t i = 0; i < code.size(); ++i) {
+        rewriter.begin(i);
+        const Instruction& instr = code[i];
+        auto body = instr.op == OpCode::Call && instr.arg != self ? space.inline_bodies.find(instr.arg)
+                                                                  : space.inline_bodies.end();
+        if (body == space.inline_bodies.end()) {
+            if (isJump(instr.op)) {
+                rewriter.emitSourceJump(instr, i);
+            } else {
+                rewriter.emit(instr);
+            }
+            continue;
+        }
+
+        // The copy keeps the body's own relative jumps; those that went to
+        // its Exit now land just past the copy. A tail call in the body
+        // must return here, so it becomes a plain Call again.
+        size_t from = space.dictionary.entry(instr.arg);
+        size_t length = body->second;
+        size_t at = rewriter.size();
+        for (size_t j = from; j < from + length; ++j) {
+            Instruction copy = space.original(j);
+            if (copy.op == OpCode::TailCall) {
+                copy.op = OpCode::Call;
+            }
+            rewriter.emit(copy);
+        }
+        // Sites inside the copied body have to be patched along with it.
+        for (size_t s = 0, n = space.inline_sites.size(); s < n; ++s) {
+            const InlineSite& nested = space.inline_sites[s];
+            if (nested.begin >= from && nested.begin < from + length) {
+                sites.push_back({nested.slot, at + nested.begin - from, at + nested.end - from});
+            }
+        }
+        sites.push_back({instr.arg, at, rewriter.size()});
+        if (optimizer.log) {
+            *optimizer.log << where << ": inlined " << space.dictionary.name(instr.arg) << "\n";
+        }
+    }
+
+    std::vector<Instruction> result = rewriter.finish();
+    for (size_t& entry : entries) {
+        entry = rewriter.map(entry);
+    }
+    return result;
+}
+
+template <typename Cell>
+void BasicCompiler<Cell>::markTailCalls(std::vector<Instruction>& code, const std::string& where) {
+    // A Call is in tail position when it is followed by the word's Exit,
+    // either directly or through the Jump that closes an ELSE branch.
+    for (size_t i = 0; i + 1 < code.size(); ++i) {
+        if (code[i].op != OpCode::Call) {
+            continue;
+        }
+        size_t next = i + 1;
+        if (code[next].op == OpCode::Jump) {
+            next = static_cast<size_t>(static_cast<long>(next) + code[next].arg);
+        }
+        if (next < code.size() && code[next].op == OpCode::Exit) {
+            code[i].op = OpCode::TailCall;
+            if (optimizer.log) {
+                *optimizer.log << where << ": tail call to " << space.dictionary.name(code[i].arg) << "\n";
+            }
+        }
+    }
+}
+
+template <typename Cell>
+void BasicCompiler<Cell>::compileBody(const AstNode& block) {
+    for (const AstNode& node : block.children()) {
+        compileNode(node);
+    }
+}
+
+template <typename Cell>
+void BasicCompiler<Cell>::compileNode(const AstNode& node) {
+    switch (node.kind()) {
+        case AstKind::Number: {
+            Cell value;
+            if (!node.toCell(value)) {
+                throw std::runtime_error("Literal " + node.toString() + " is not representable in " +
+                                         CellTraits<Cell>::name + " cells");
+            }
+            emit(OpCode::Lit, addConstant(value));
+            break;
+        }
+        case AstKind::If: {
+            size_t branch = emit(OpCode::JumpIfZero);
+            compileBody(node.getTrueBranch());
+            if (!node.getFalseBranch().children().empty()) {
+                size_t skip = emit(OpCode::Jump);
+                patchJump(branch, region.size());
+                compileBody(node.getFalseBranch());
+                patchJump(skip, region.size());
+            } else {
+                patchJump(branch, region.size());
+            }
+            break;
+        }
+        case AstKind::DoLoop: {
+            size_t loopStart = emit(node.isConditional() ? OpCode::QDo : OpCode::Do);
+            loops.emplace_back();
+            compileBody(node.getBody());
+            size_t loopEnd = emit(node.isPlusLoop() ? OpCode::PlusLoop : OpCode::Loop);
+            patchJump(loopEnd, loopStart + 1);
+            patchJump(loopStart, region.size());
+            for (size_t leave : loops.back()) {
+                patchJump(leave, region.size());
+            }
+            loops.pop_back();
+            break;
+        }
+        case AstKind::Definition: {
+            // Nested definitions are bound when execution reaches them, so their
+            // body is laid out inline and jumped over.
+            // The slot may be rebound to this body at run time, so it no longer
+            // has an effect callers can be proven against. The analysis still
+            // runs to reject mismatched IF branches.
+            std::string name(node.getName());
+            int32_t slot = space.dictionary.intern(node.getSymbol());
+            StackEffectAnalyzer analyzer(space.dictionary, name);
+            WordEffect effect = analyzer.analyze(node.getBody());
+            effect.known = false;
+            checkRebinding(slot, effect);
+            space.dictionary.setEffect(slot, effect);
+
+            size_t define = emit(OpCode::Define);
+            size_t skip = emit(OpCode::Jump);
+            size_t entry = region.size();
+            std::vector<std::vector<size_t>> outer_loops = std::move(loops);
+            loops.clear();
+            compileBody(node.getBody());
+            loops = std::move(outer_loops);
+            emit(OpCode::Exit);
+            patchJump(skip, region.size());
+            space.definitions.push_back({slot, entry});
+            region_definitions.push_back(space.definitions.size() - 1);
+            region[define].arg = static_cast<int32_t>(space.definitions.size() - 1);
+            break;
+        }
+        case AstKind::Word:
+            compileWord(node.getToken());
+            break;
+        case AstKind::Block:
+            compileBody(node);
+            break;
+        case AstKind::Include:
+            // The interpreter loads modules between segments.
+            throw std::runtime_error(node.toString() + " cannot be compiled into a segment");
+    }
+}
+
+template <typename Cell>
+void BasicCompiler<Cell>::compileWord(const Token& token) {
+    switch (token.type) {
+        case TokenType::DotQuote:
+            emit(OpCode::Print, addString(std::string(token.text)));
+            return;
+        case TokenType::Leave:
+            if (loops.empty()) {
+                throw std::runtime_error("LEAVE outside of a DO loop");
+            }
+            loops.back().push_back(emit(OpCode::Leave));
+            return;
+        case TokenType::Unloop:
+            emit(OpCode::Unloop);
+            return;
+        case TokenType::Exit:
+            emit(OpCode::Exit);
+            return;
+        case TokenType::If: case TokenType::Else: case TokenType::Then:
+        case TokenType::Colon: case TokenType::Semicolon:
+        case TokenType::Do: case TokenType::Loop:
+        case TokenType::QDo: case TokenType::PlusLoop:
+            throw std::runtime_error("Unexpected control flow word: " + std::string(token.text));
+        default:
+            break;
+    }
+
+    // I, J and K read their loop frame unchecked when the loops around them
+    // in this definition guarantee it exists. Used anywhere else, such as in
+    // a word called from a loop, they check the frame count when they run.
+    int level = token.type == TokenType::LoopIndexI ? 1 : token.type == TokenType::LoopIndexJ ? 2
+              : token.type == TokenType::LoopIndexK ? 3 : 0;
+    if (level > static_cast<int>(loops.size()) && !space.dictionary.isDefined(token.symbol)) {
+        emit(OpCode::LoopIndex, level);
+        return;
+    }
+
+    // User definitions shadow primitives of the same name; everything else
+    // is resolved once, here, to a dictionary slot.
+    OpCode op;
+    if (!space.dictionary.isDefined(token.symbol) && primitiveOpCode(token.type, op)) {
+        emit(op);
+        return;
+    }
+    emit(OpCode::Call, space.dictionary.intern(token.symbol));
+}
+
+template <typename Cell>
+size_t BasicCompiler<Cell>::emit(OpCode op, int32_t arg) {
+    region.push_back({op, arg});
+    return region.size() - 1;
+}
+
+template <typename Cell>
+void BasicCompiler<Cell>::patchJump(size_t at, size_t target) {
+    region[at].arg = static_cast<int32_t>(static_cast<long>(target) - static_cast<long>(at));
+}
+
+template <typename Cell>
+int32_t BasicCompiler<Cell>::addConstant(Cell value) {
+    space.constants.push_back(value);
+    return static_cast<int32_t>(space.constants.size() - 1);
+}
+
+template <typename Cell>
+int32_t BasicCompiler<Cell>::addString(const std::string& text) {
+    space.strings.push_back(text);
+    return static_cast<int32_t>(space.strings.size() - 1);
+}
+
+#define PELI_INSTANTIATE_COMPILER(Cell) template class BasicCompiler<Cell>;
+PELI_CELL_TYPES(PELI_INSTANTIATE_COMPILER)
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "ast.hpp"
+#include "Bytecode.hpp"
+#include "Optimizer.hpp"
+#include <string>
+#include <vector>
+
+// Lowers parsed programs into the linear bytecode of a CodeSpace. Each
+// definition or segment is built as a region of its own, run through the
+// analysis passes and only then appended to the code space.
+template <typename Cell>
+class BasicCompiler {
+public:
+    explicit BasicCompiler(BasicCodeSpace<Cell>& space, const OptimizerOptions& optimizer = {});
+
+    // Compiles a colon definition and binds `name` to it; returns its entry.
+    size_t compileDefinition(const std::string& name, const AstNode& body);
+    // Compiles top-level statements terminated by Halt; returns the entry.
+    size_t compileSegment(const std::vector<const AstNode*>& nodes);
+
+private:
+    size_t finishRegion(const std::string& where, int32_t self, const WordEffect& effect);
+    std::vector<Instruction> inlineCalls(const std::vector<Instruction>& code, std::vector<size_t>& entries,
+                                         int32_t self, const std::string& where, std::vector<InlineSite>& sites);
+    void markTailCalls(std::vector<Instruction>& code, const std::string& where);
+    void checkRebinding(int32_t slot, const WordEffect& effect);
+    void compileBody(const AstNode& block);
+    void compileNode(const AstNode& node);
+    void compileWord(const Token& token);
+    size_t emit(OpCode op, int32_t arg = 0);
+    void patchJump(size_t at, size_t target);
+    int32_t addConstant(Cell value);
+    int32_t addString(const std::string& text);
+
+    BasicCodeSpace<Cell>& space;
+    OptimizerOptions optimizer;
+    std::vector<Instruction> region;
+    // Definitions nested in the region, whose entries are still region-local.
+    std::vector<size_t> region_definitions;
+    // The LEAVEs of each DO loop open at this point, waiting for its end.
+    std::vector<std::vector<size_t>> loops;
+};
+
+using Compiler = BasicCompiler<double>;
+
+#define PELI_DECLARE_COMPILER(Cell) extern template class BasicCompiler<Cell>;
+PELI_CELL_TYPES(PELI_DECLARE_COMPILER)
+#undef PELI_DECLARE_COMPILER
@@ -0,0 +1,498 @@
+#include "CppEmitter.hpp"
+#include "Analysis.hpp"
+#include "Compiler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <set>
+#include <stdexcept>
+#include <type_traits>
+
+namespace {
+
+template <typename Cell>
+const char* cellTypeName() {
+    if constexpr (std::is_same_v<Cell, double>) {
+        return "double";
+    } else if constexpr (std::is_same_v<Cell, int64_t>) {
+        return "int64_t";
+    } else {
+        return "int32_t";
+    }
+}
+
+// Spells a cell as a C++ expression of type Cell that evaluates to exactly
+// the same value.
+template <typename Cell>
+std::string cellLiteral(Cell value) {
+    if constexpr (cellIsInteger<Cell>) {
+        if (value == std::numeric_limits<Cell>::min()) {
+            return "std::numeric_limits<Cell>::min()";
+        }
+        return "static_cast<Cell>(" + std::to_string(value) + "LL)";
+    } else {
+        if (std::isnan(value)) {
+            return "std::numeric_limits<Cell>::quiet_NaN()";
+        }
+        if (std::isinf(value)) {
+            return value < 0 ? "-std::numeric_limits<Cell>::infinity()" : "std::numeric_limits<Cell>::infinity()";
+        }
+        std::ostringstream out;
+        out << std::hexfloat << value;
+        return out.str();
+    }
+}
+
+std::string quote(std::string_view text) {
+    std::ostringstream out;
+    out << '"';
+    for (unsigned char c : text) {
+        switch (c) {
+            case '"': out << "\\\""; break;
+            case '\\': out << "\\\\"; break;
+            case '\n': out << "\\n"; break;
+            case '\t': out << "\\t"; break;
+            default:
+                if (c < 0x20 || c >= 0x7F) {
+                    out << '\\' << std::oct << std::setw(3) << std::setfill('0') << static_cast<int>(c)
+                        << std::dec << std::setfill(' ');
+                } else {
+                    out << c;
+                }
+        }
+    }
+    out << '"';
+    return out.str();
+}
+
+int loopLevel(TokenType type) {
+    return type == TokenType::LoopIndexI ? 1 : type == TokenType::LoopIndexJ ? 2
+         : type == TokenType::LoopIndexK ? 3 : 0;
+}
+
+} // namespace
+
+template <typename Cell>
+BasicCppEmitter<Cell>::BasicCppEmitter(const InterpreterOptions& options, std::string source)
+    : options(options), source(std::move(source)) {}
+
+template <typename Cell>
+void BasicCppEmitter<Cell>::emit(const Ast& program, std::ostream& out) {
+    survey(program.root(), 0, true);
+
+    // Statements between definitions are emitted in the same segments the
+    // interpreter compiles them in.
+    Function main;
+    std::vector<const AstNode*> segment;
+    bool complete = true;
+    for (const AstNode& node : program.root().children()) {
+        if (node.kind() == AstKind::Definition) {
+            complete = emitSegment(segment, main) && emitDefinition(node, main);
+            segment.clear();
+            if (!complete) {
+                break;
+            }
+        } else {
+            segment.push_back(&node);
+        }
+    }
+    if (complete) {
+        emitSegment(segment, main);
+    }
+
+    out << "// Generated by pelilang --emit-cpp from " << source << ". Do not edit.\n"
+        << "#include \"Runtime.hpp\"\n"
+        << "#include <iostream>\n"
+        << "#include <limits>\n"
+        << "#include <utility>\n"
+        << "\n"
+        << "namespace {\n"
+        << "\n"
+        << "using Cell = " << cellTypeName<Cell>() << ";\n"
+        << "using Word = BasicProgram<Cell>::Word;\n"
+        << "\n"
+        << "BasicProgram<Cell> program(" << options.data_stack_depth << ", " << options.return_stack_depth << ", "
+        << options.call_depth << ", " << options.memory_cells << ", " << (options.huge_pages ? "true" : "false")
+        << ");\n"
+        << "\n";
+
+    std::set<int32_t> slots(used_slots.begin(), used_slots.end());
+    for (int32_t slot : slots) {
+        out << "Word slot_" << slot << " = nullptr; // " << space.dictionary.name(slot) << "\n";
+    }
+    if (!slots.empty()) {
+        out << "\n";
+    }
+    for (size_t i = 0; i < functions.size(); ++i) {
+        out << "Cell* def_" << i << "(Cell* sp); // : " << function_names[i] << "\n";
+    }
+    for (const std::string& function : functions) {
+        out << "\n" << function;
+    }
+
+    out << "\n"
+        << "Cell* top_level(Cell* sp) {\n"
+        << main.body.str()
+        << "    return sp;\n"
+        << "}\n"
+        << "\n"
+        << "} // namespace\n"
+        << "\n"
+        << "int main() {\n"
+        << "    return program.run(top_level);\n"
+        << "}\n";
+}
+
+template <typename Cell>
+void BasicCppEmitter<Cell>::survey(const AstNode& block, int loops, bool top_level) {
+    for (const AstNode& node : block.children()) {
+        switch (node.kind()) {
+            case AstKind::If:
+                survey(node.getTrueBranch(), loops, false);
+                survey(node.getFalseBranch(), loops, false);
+                break;
+            case AstKind::DoLoop:
+                survey(node.getBody(), loops + 1, false);
+                break;
+            case AstKind::Definition: {
+                std::string name(node.getName());
+                ++definition_counts[name];
+                if (top_level) {
+                    top_level_definitions.insert(name);
+                }
+                survey(node.getBody(), 0, false);
+                break;
+            }
+            case AstKind::Word:
+                if (loopLevel(node.getToken().type) > loops) {
+                    dynamic_loops = true;
+                }
+                break;
+            case AstKind::Number: case AstKind::Block:
+                break;
+            case AstKind::Include:
+                throw std::runtime_error(node.toString() + ": --emit-cpp translates a single file and cannot "
+                                         "load modules");
+        }
+    }
+}
+
+template <typename Cell>
+bool BasicCppEmitter<Cell>::emitSegment(const std::vector<const AstNode*>& nodes, Function& main) {
+    if (nodes.empty()) {
+        return true;
+    }
+
+    size_t definitions = space.definitions.size();
+    WordEffect effect;
+    try {
+        StackEffectAnalyzer analyzer(space.dictionary, "");
+        effect = analyzer.analyze(nodes);
+        BasicCompiler<Cell> compiler(space);
+        compiler.compileSegment(nodes);
+    } catch (const std::exception& e) {
+        emitFailure(e.what(), main);
+        return false;
+    }
+
+    main.proven = effect.known && space.definitions.size() == definitions;
+    if (main.proven && (effect.need > 0 || effect.grow > 0)) {
+        line(main) << "program.check(sp, " << effect.need << ", " << effect.grow << ");\n";
+    }
+    for (const AstNode* node : nodes) {
+        emitNode(*node, main, false);
+    }
+    return true;
+}
+
+template <typename Cell>
+bool BasicCppEmitter<Cell>::emitDefinition(const AstNode& def, Function& main) {
+    std::string name(def.getName());
+    size_t definitions = space.definitions.size();
+    current = name;
+    current_defined = space.dictionary.isDefined(name);
+    WordEffect effect;
+    try {
+        StackEffectAnalyzer analyzer(space.dictionary, name);
+        effect = analyzer.analyze(def.getBody());
+        BasicCompiler<Cell> compiler(space);
+        compiler.compileDefinition(name, def.getBody());
+    } catch (const std::exception& e) {
+        emitFailure(e.what(), main);
+        return false;
+    }
+
+    size_t index = beginFunction(name);
+    if (definition_counts[name] == 1 && top_level_definitions.count(name)) {
+        direct[name] = index;
+    }
+    Function fn;
+    fn.proven = effect.known && space.definitions.size() == definitions;
+    if (fn.proven && (effect.need > 0 || effect.grow > 0)) {
+        line(fn) << "program.check(sp, " << effect.need << ", " << effect.grow << ");\n";
+    }
+    emitBody(def.getBody(), fn, true);
+    endFunction(index, fn);
+
+    int32_t slot = space.dictionary.find(name);
+    used_slots.insert(slot);
+    line(main) << "slot_" << slot << " = def_" << index << "; // : " << name << "\n";
+    current.clear();
+    return true;
+}
+
+template <typename Cell>
+void BasicCppEmitter<Cell>::emitNested(const AstNode& def, Function& caller) {
+    // Bound when execution reaches it, like the Define the VM runs; the
+    // slot may be rebound at run time, so its effect is never relied on.
+    std::string name(def.getName());
+    size_t index = beginFunction(name);
+    Function fn;
+    emitBody(def.getBody(), fn, true);
+    endFunction(index, fn);
+
+    int32_t slot = space.dictionary.intern(name);
+    used_slots.insert(slot);
+    line(caller) << "slot_" << slot << " = def_" << index << "; // : " << name << "\n";
+}
+
+template <typename Cell>
+void BasicCppEmitter<Cell>::emitBody(const AstNode& block, Function& fn, bool tail) {
+    AstChildren children = block.children();
+    for (auto it = children.begin(); it != children.end();) {
+        const AstNode& node = *it;
+        ++it;
+        emitNode(node, fn, tail && it == children.end());
+    }
+}
+
+template <typename Cell>
+void BasicCppEmitter<Cell>::emitNode(const AstNode& node, Function& fn, bool tail) {
+    if (node.kind() == AstKind::Number) {
+        // The bytecode compiler has already rejected literals that do not fit.
+        Cell value{};
+        node.toCell(value);
+        if (!fn.proven) {
+            line(fn) << "program.check(sp, 0, 1);\n";
+        }
+        line(fn) << "*++sp = " << cellLiteral(value) << ";\n";
+    }
+    else if (node.kind() == AstKind::If) {
+        if (!fn.proven) {
+            line(fn) << "program.check(sp, 1, 0);\n";
+        }
+        line(fn) << "if (*sp-- != 0) {\n";
+        ++fn.indent;
+        emitBody(node.getTrueBranch(), fn, tail);
+        --fn.indent;
+        if (!node.getFalseBranch().children().empty()) {
+            line(fn) << "} else {\n";
+            ++fn.indent;
+            emitBody(node.getFalseBranch(), fn, tail);
+            --fn.indent;
+        }
+        line(fn) << "}\n";
+    }
+    else if (node.kind() == AstKind::DoLoop) {
+        int id = ++fn.next_loop;
+        std::string index = "i" + std::to_string(id);
+        std::string limit = "limit" + std::to_string(id);
+        if (!fn.proven) {
+            line(fn) << "program.check(sp, 2, 0);\n";
+        }
+        line(fn) << "{\n";
+        ++fn.indent;
+        line(fn) << "long " << limit << " = static_cast<long>(sp[-1]);\n";
+        line(fn) << "long " << index << " = static_cast<long>(sp[0]);\n";
+        line(fn) << "sp -= 2;\n";
+        line(fn) << "if (" << index << (node.isConditional() ? " != " : " < ") << limit << ") {\n";
+        ++fn.indent;
+        if (dynamic_loops) {
+            line(fn) << "program.enterLoop(&" << index << ");\n";
+        }
+        line(fn) << "for (;;) {\n";
+        ++fn.indent;
+        fn.loops.push_back(id);
+        emitBody(node.getBody(), fn, false);
+        fn.loops.pop_back();
+        if (node.isPlusLoop()) {
+            if (!fn.proven) {
+                line(fn) << "program.check(sp, 1, 0);\n";
+            }
+            line(fn) << "if (!loopStep(" << index << ", " << limit << ", static_cast<long>(*sp--))) break;\n";
+        } else {
+            line(fn) << "if (++" << index << " >= " << limit << ") break;\n";
+        }
+        --fn.indent;
+        line(fn) << "}\n";
+        if (dynamic_loops) {
+            line(fn) << "program.leaveLoop();\n";
+        }
+        --fn.indent;
+        line(fn) << "}\n";
+        --fn.indent;
+        line(fn) << "}\n";
+    }
+    else if (node.kind() == AstKind::Definition) {
+        emitNested(node, fn);
+    }
+    else if (node.kind() == AstKind::Word) {
+        emitWord(node.getToken(), fn, tail);
+    }
+}
+
+template <typename Cell>
+void BasicCppEmitter<Cell>::emitWord(const Token& token, Function& fn, bool tail) {
+    switch (token.type) {
+        case TokenType::DotQuote:
+            line(fn) << "std::cout << " << quote(token.text) << ";\n";
+            return;
+        case TokenType::Leave:
+            line(fn) << "break;\n";
+            return;
+        case TokenType::Unloop:
+            if (dynamic_loops) {
+                line(fn) << "program.leaveLoop();\n";
+            }
+            return;
+        case TokenType::Exit:
+            line(fn) << "return sp;\n";
+            return;
+        default:
+            break;
+    }
+
+    // Words resolve exactly as BasicCompiler::compileWord resolves them.
+    bool defined = token.text == current ? current_defined : space.dictionary.isDefined(token.symbol);
+    int level = loopLevel(token.type);
+    if (level > 0 && !defined) {
+        if (!fn.proven) {
+            line(fn) << "program.check(sp, 0, 1);\n";
+        }
+        if (level <= static_cast<int>(fn.loops.size())) {
+            line(fn) << "*++sp = static_cast<Cell>(i" << fn.loops[fn.loops.size() - level] << ");\n";
+        } else {
+            line(fn) << "*++sp = program.loopIndex(" << level << ");\n";
+        }
+        return;
+    }
+
+    OpCode op;
+    if (!defined && primitiveOpCode(token.type, op)) {
+        emitPrimitive(op, fn);
+        return;
+    }
+
+    std::string target;
+    auto found = direct.find(std::string(token.text));
+    if (found != direct.end()) {
+        target = "def_" + std::to_string(found->second);
+    } else {
+        int32_t slot = space.dictionary.intern(token.symbol);
+        used_slots.insert(slot);
+        target = "slot_" + std::to_string(slot);
+    }
+    if (tail) {
+        line(fn) << "return program.tailCall(" << target << ", " << quote(token.text) << ", sp);\n";
+    } else {
+        line(fn) << "sp = program.call(" << target << ", " << quote(token.text) << ", sp);\n";
+    }
+}
+
+template <typename Cell>
+void BasicCppEmitter<Cell>::emitPrimitive(OpCode op, Function& fn) {
+    StackEffect effect;
+    if (!fn.proven && stackEffect(op, effect)) {
+        int grow = std::max(0, effect.pushes - effect.pops);
+        if (effect.pops > 0 || grow > 0) {
+            line(fn) << "program.check(sp, " << effect.pops << ", " << grow << ");\n";
+        }
+    }
+
+    auto statement = [&](const char* code) { line(fn) << code << "\n"; };
+    switch (op) {
+        case OpCode::Add: statement("sp[-1] = cellAdd(sp[-1], sp[0]); --sp;"); break;
+        case OpCode::Sub: statement("sp[-1] = cellSub(sp[-1], sp[0]); --sp;"); break;
+        case OpCode::Mul: statement("sp[-1] = cellMul(sp[-1], sp[0]); --sp;"); break;
+        case OpCode::Div:
+            statement("if (sp[0] == 0) program.fail(\"Division by zero\");");
+            statement("sp[-1] = cellDiv(sp[-1], sp[0]); --sp;");
+            break;
+        case OpCode::Mod:
+            if (cellIsInteger<Cell>) {
+                statement("if (sp[0] == 0) program.fail(\"Division by zero\");");
+            }
+            statement("sp[-1] = cellMod(sp[-1], sp[0]); --sp;");
+            break;
+        case OpCode::Equals: statement("sp[-1] = sp[-1] == sp[0] ? 1 : 0; --sp;"); break;
+        case OpCode::LessThan: statement("sp[-1] = sp[-1] < sp[0] ? 1 : 0; --sp;"); break;
+        case OpCode::GreaterThan: statement("sp[-1] = sp[-1] > sp[0] ? 1 : 0; --sp;"); break;
+        case OpCode::And: statement("sp[-1] = cellAnd(sp[-1], sp[0]); --sp;"); break;
+        case OpCode::Or: statement("sp[-1] = cellOr(sp[-1], sp[0]); --sp;"); break;
+        case OpCode::Not: statement("sp[0] = sp[0] == 0 ? 1 : 0;"); break;
+        case OpCode::Dup: statement("sp[1] = sp[0]; ++sp;"); break;
+        case OpCode::Drop: statement("--sp;"); break;
+        case OpCode::Swap: statement("std::swap(sp[-1], sp[0]);"); break;
+        case OpCode::Over: statement("sp[1] = sp[-1]; ++sp;"); break;
+        case OpCode::Rot: statement("{ Cell a = sp[-2]; sp[-2] = sp[-1]; sp[-1] = sp[0]; sp[0] = a; }"); break;
+        case OpCode::ToR: statement("program.toR(*sp--);"); break;
+        case OpCode::RFrom: statement("*++sp = program.fromR();"); break;
+        case OpCode::RFetch: statement("*++sp = program.fetchR();"); break;
+        case OpCode::Store: statement("program.storeAt(sp[0]) = sp[-1]; sp -= 2;"); break;
+        case OpCode::Fetch: statement("sp[0] = program.at(sp[0]);"); break;
+        case OpCode::CStore: statement("program.storeByte(sp[0]) = cellToByte(sp[-1]); sp -= 2;"); break;
+        case OpCode::CFetch: statement("sp[0] = static_cast<Cell>(program.byte(sp[0]));"); break;
+        case OpCode::Dot: statement("std::cout << *sp-- << \" \";"); break;
+        case OpCode::DotS: statement("program.printStack(sp);"); break;
+        case OpCode::Cr: statement("std::cout << std::endl;"); break;
+        case OpCode::Accept: statement("sp[-1] = program.accept(sp[-1], sp[0]); --sp;"); break;
+        case OpCode::ToNumber: statement("sp[-1] = program.toNumber(sp[-1], sp[0]); --sp;"); break;
+        case OpCode::Type: statement("program.type(sp[-1], sp[0]); sp -= 2;"); break;
+        case OpCode::MapFile: statement("program.mapFile(sp[-2], sp[-1], sp[0], sp[-2], sp[-1]); --sp;"); break;
+        case OpCode::Unmap: statement("program.unmapFile(*sp--);"); break;
+        case OpCode::Move: statement("program.move(sp[-2], sp[-1], sp[0]); sp -= 3;"); break;
+        case OpCode::Fill: statement("program.fill(sp[-2], sp[-1], sp[0]); sp -= 3;"); break;
+        case OpCode::Erase: statement("program.erase(sp[-1], sp[0]); sp -= 2;"); break;
+        case OpCode::Compare: statement("sp[-3] = program.compare(sp[-3], sp[-2], sp[-1], sp[0]); sp -= 3;"); break;
+        case OpCode::Search: statement("sp[-1] = program.search(sp[-3], sp[-2], sp[-1], sp[0]); --sp;"); break;
+        case OpCode::Scan: statement("program.scan(sp[-2], sp[-1], sp[0]); --sp;"); break;
+        case OpCode::VAdd: statement("program.vectorAdd(sp[-3], sp[-2], sp[-1], sp[0]); sp -= 4;"); break;
+        case OpCode::VSub: statement("program.vectorSub(sp[-3], sp[-2], sp[-1], sp[0]); sp -= 4;"); break;
+        case OpCode::VMul: statement("program.vectorMul(sp[-3], sp[-2], sp[-1], sp[0]); sp -= 4;"); break;
+        case OpCode::VScale: statement("program.vectorScale(sp[-3], sp[-2], sp[-1], sp[0]); sp -= 4;"); break;
+        case OpCode::VSum: statement("sp[-1] = program.vectorSum(sp[-1], sp[0]); --sp;"); break;
+        case OpCode::VDot: statement("sp[-2] = program.vectorDot(sp[-2], sp[-1], sp[0]); sp -= 2;"); break;
+        case OpCode::VMin: statement("sp[-1] = program.vectorMin(sp[-1], sp[0]); --sp;"); break;
+        case OpCode::VMax: statement("sp[-1] = program.vectorMax(sp[-1], sp[0]); --sp;"); break;
+        default:
+            throw std::runtime_error(std::string("No C++ translation for ") + opcodeName(op));
+    }
+}
+
+template <typename Cell>
+size_t BasicCppEmitter<Cell>::beginFunction(const std::string& name) {
+    functions.emplace_back();
+    function_names.push_back(name);
+    return functions.size() - 1;
+}
+
+template <typename Cell>
+void BasicCppEmitter<Cell>::endFunction(size_t index, Function& fn) {
+    functions[index] = "Cell* def_" + std::to_string(index) + "(Cell* sp) { // : " + function_names[index] + "\n" +
+                       fn.body.str() + "    return sp;\n}\n";
+}
+
+template <typename Cell>
+void BasicCppEmitter<Cell>::emitFailure(const std::string& message, Function& fn) {
+    line(fn) << "program.fail(" << quote(message) << ");\n";
+}
+
+template <typename Cell>
+std::ostream& BasicCppEmitter<Cell>::line(Function& fn) {
+    fn.body << std::string(fn.indent * 4, ' ');
+    return fn.body;
+}
+
+#define PELI_INSTANTIATE_CPP_EMITTER(Cell) template class BasicCppEmitter<Cell>;
+PELI_CELL_TYPES(PELI_INSTANTIATE_CPP_EMITTER)
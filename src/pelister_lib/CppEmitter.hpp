@@ -0,0 +1,81 @@
+#pragma once
+
+#include "ast.hpp"
+#include "Bytecode.hpp"
+#include "Interpreter.hpp"
+#include <cstdint>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Translates a program into a C++ translation unit that runs it on
+// BasicProgram<Cell> from pelister_runtime. Every colon definition becomes a
+// function taking and returning the data stack pointer, DO loops become for
+// loops over local indices and top-level code becomes the body of main.
+//
+// Definitions and segments are also compiled to bytecode on the side, in the
+// order the interpreter would, so words resolve against the same dictionary
+// and a program the VM rejects part way through compiles to one that runs up
+// to that point and then fails with the same error.
+template <typename Cell>
+class BasicCppEmitter {
+public:
+    BasicCppEmitter(const InterpreterOptions& options, std::string source);
+
+    void emit(const Ast& program, std::ostream& out);
+
+private:
+    // The function being written, with the DO loops open at this point.
+    struct Function {
+        std::ostringstream body;
+        int indent = 1;
+        std::vector<int> loops;
+        int next_loop = 0;
+        // A proven stack effect is checked once on entry instead of by
+        // every primitive.
+        bool proven = false;
+    };
+
+    void survey(const AstNode& block, int loops, bool top_level);
+    bool emitDefinition(const AstNode& def, Function& caller);
+    bool emitSegment(const std::vector<const AstNode*>& nodes, Function& main);
+    void emitBody(const AstNode& block, Function& fn, bool tail);
+    void emitNode(const AstNode& node, Function& fn, bool tail);
+    void emitWord(const Token& token, Function& fn, bool tail);
+    void emitPrimitive(OpCode op, Function& fn);
+    void emitNested(const AstNode& def, Function& caller);
+    size_t beginFunction(const std::string& name);
+    void endFunction(size_t index, Function& fn);
+    void emitFailure(const std::string& message, Function& fn);
+    std::ostream& line(Function& fn);
+
+    InterpreterOptions options;
+    std::string source;
+    // Bytecode compiled alongside, only for its dictionary.
+    BasicCodeSpace<Cell> space;
+    // The definition being compiled, which is bound only once it is done.
+    std::string current;
+    bool current_defined = false;
+
+    std::unordered_map<std::string, int> definition_counts;
+    std::unordered_set<std::string> top_level_definitions;
+    // Words with a single, top-level definition, called directly once it
+    // has been reached; keyed to the index of their function.
+    std::unordered_map<std::string, size_t> direct;
+    // Whether some I, J or K reads a loop index from outside its own
+    // definition, so every loop has to register its index at run time.
+    bool dynamic_loops = false;
+
+    std::vector<std::string> functions;
+    std::vector<std::string> function_names;
+    std::unordered_set<int32_t> used_slots;
+};
+
+using CppEmitter = BasicCppEmitter<double>;
+
+#define PELI_DECLARE_CPP_EMITTER(Cell) extern template class BasicCppEmitter<Cell>;
+PELI_CELL_TYPES(PELI_DECLARE_CPP_EMITTER)
+#undef PELI_DECLARE_CPP_EMITTER
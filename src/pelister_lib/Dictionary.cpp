@@ -0,0 +1,18 @@
+#include "Dictionary.hpp"
+#include <algorithm>
+
+int32_t Dictionary::intern(Symbol name) {
+    if (name >= slots.size()) {
+        slots.resize(std::max<size_t>(name + 1, symbolCount()), -1);
+    }
+    if (slots[name] >= 0) {
+        return slots[name];
+    }
+    int32_t slot = static_cast<int32_t>(symbols.size());
+    slots[name] = slot;
+    symbols.push_back(name);
+    entries.push_back(unbound);
+    effects.emplace_back();
+    relied.push_back(false);
+    return slot;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Symbols.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// What a word does to the data stack, as proven when it was compiled: the
+// depth it needs on entry, the net change and the peak growth above entry.
+struct WordEffect {
+    bool known = false;
+    int need = 0;
+    int net = 0;
+    int grow = 0;
+};
+
+// Slots of user words. Every name gets a slot index the first time it is
+// defined or referenced; call sites are compiled against the slot, so
+// binding or rebinding a word only repoints the slot's entry address. Names
+// are looked up by Symbol, with an index rather than a hash.
+class Dictionary {
+public:
+    static constexpr size_t unbound = std::numeric_limits<size_t>::max();
+
+    int32_t intern(Symbol name);
+    int32_t intern(std::string_view name) { return intern(internSymbol(name)); }
+    // -1 when `name` has no slot.
+    int32_t find(Symbol name) const {
+        return name < slots.size() ? slots[name] : -1;
+    }
+    int32_t find(std::string_view name) const { return find(findSymbol(name)); }
+    bool isDefined(Symbol name) const {
+        int32_t slot = find(name);
+        return slot >= 0 && entries[slot] != unbound;
+    }
+    bool isDefined(std::string_view name) const { return isDefined(findSymbol(name)); }
+    void bind(int32_t slot, size_t entry) { entries[slot] = entry; }
+    size_t entry(int32_t slot) const { return entries[slot]; }
+    std::string name(int32_t slot) const { return std::string(symbolName(symbols[slot])); }
+
+    // Callers proven against a word's net effect elide the checks after
+    // calling it, so once relied upon that net effect must survive
+    // redefinition.
+    const WordEffect& effect(int32_t slot) const { return effects[slot]; }
+    void setEffect(int32_t slot, const WordEffect& effect) { effects[slot] = effect; }
+    void markRelied(int32_t slot) { relied[slot] = true; }
+    bool isRelied(int32_t slot) const { return relied[slot]; }
+    size_t size() const { return symbols.size(); }
+    const size_t* entryTable() const { return entries.data(); }
+
+private:
+    // The slot of each Symbol, or -1, and the Symbol of each slot.
+    std::vector<int32_t> slots;
+    std::vector<Symbol> symbols;
+    std::vector<size_t> entries;
+    std::vector<WordEffect> effects;
+    std::vector<bool> relied;
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+// A 64-bit hash of a byte string: quick, and enough to key files by their
+// contents and to catch damaged or truncated ones. Not meant to resist
+// deliberate collisions.
+//
+// Four lanes each take eight bytes a step and are only folded together at
+// the end, so the multiplies do not wait on one another; hashing runs at
+// several bytes a cycle rather than FNV-1a's fraction of one.
+inline uint64_t hashBytes(std::string_view bytes) {
+    constexpr uint64_t k0 = 0x9E3779B97F4A7C15ull;
+    constexpr uint64_t k1 = 0xC2B2AE3D27D4EB4Full;
+    auto load = [](const char* p) {
+        uint64_t word;
+        std::memcpy(&word, p, sizeof(word));
+        return word;
+    };
+    auto round = [&](uint64_t lane, uint64_t word) {
+        lane = (lane ^ (word * k1)) * k0;
+        return lane ^ (lane >> 29);
+    };
+
+    const char* p = bytes.data();
+    size_t left = bytes.size();
+    uint64_t lanes[4] = {k0, k1, k0 ^ k1, bytes.size()};
+    for (; left >= 32; p += 32, left -= 32) {
+        for (int i = 0; i < 4; ++i) {
+            lanes[i] = round(lanes[i], load(p + 8 * i));
+        }
+    }
+    uint64_t hash = lanes[0] ^ (lanes[1] * 31) ^ (lanes[2] * 961) ^ (lanes[3] * 29791);
+    for (; left >= 8; p += 8, left -= 8) {
+        hash = round(hash, load(p));
+    }
+    if (left > 0) {
+        uint64_t tail = 0;
+        std::memcpy(&tail, p, left);
+        hash = round(hash, tail ^ (static_cast<uint64_t>(left) << 56));
+    }
+
+    // Final avalanche, as in MurmurHash3.
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB93FE1A85A53ull;
+    return hash ^ (hash >> 33);
+}
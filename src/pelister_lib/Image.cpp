@@ -0,0 +1,363 @@
+#include "Image.hpp"
+#include "Analysis.hpp"
+#include "Hash.hpp"
+#include "SourceFile.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+
+namespace {
+
+constexpr char kMagic[8] = {'P', 'E', 'L', 'I', 'I', 'M', 'G', '\0'};
+constexpr uint32_t kByteOrder = 0x01020304;
+
+// magic, version, byte order, cell name, cell size, entry, payload size,
+// checksum.
+constexpr size_t kHeaderSize = 8 + 4 + 4 + 4 + 4 + 4 + 8 + 8;
+
+class Writer {
+public:
+    template <typename T>
+    void put(T value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        bytes.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+    void putText(std::string_view text) {
+        put<uint64_t>(text.size());
+        bytes.append(text);
+    }
+
+    std::string bytes;
+};
+
+class Reader {
+public:
+    Reader(const std::string& path, std::string_view bytes) : path(path), bytes(bytes) {}
+
+    template <typename T>
+    T get() {
+        T value;
+        std::memcpy(&value, take(sizeof(value)), sizeof(value));
+        return value;
+    }
+    std::string_view getText() {
+        uint64_t size = get<uint64_t>();
+        return {take(size), static_cast<size_t>(size)};
+    }
+    // A count of records of at least `record` bytes each, checked against
+    // what is left so a damaged count cannot make the caller allocate
+    // without bound.
+    size_t getCount(size_t record) {
+        uint64_t count = get<uint64_t>();
+        if (count > (bytes.size() - position) / record) {
+            fail("is truncated");
+        }
+        return static_cast<size_t>(count);
+    }
+    const char* take(uint64_t size) {
+        if (size > bytes.size() - position) {
+            fail("is truncated");
+        }
+        const char* at = bytes.data() + position;
+        position += static_cast<size_t>(size);
+        return at;
+    }
+    bool done() const { return position == bytes.size(); }
+
+    [[noreturn]] void fail(const std::string& problem) const {
+        throw std::runtime_error("Image '" + path + "' " + problem);
+    }
+
+private:
+    const std::string& path;
+    std::string_view bytes;
+    size_t position = 0;
+};
+
+struct Header {
+    uint32_t version;
+    std::string cell;
+    uint32_t cell_size;
+    int32_t entry;
+    uint64_t payload_size;
+    uint64_t checksum;
+};
+
+Header readHeader(Reader& in) {
+    if (std::memcmp(in.take(sizeof(kMagic)), kMagic, sizeof(kMagic)) != 0) {
+        in.fail("is not a pelilang image");
+    }
+    Header header;
+    header.version = in.get<uint32_t>();
+    if (header.version != kImageVersion) {
+        in.fail("has format version " + std::to_string(header.version) + "; this build reads version " +
+                std::to_string(kImageVersion));
+    }
+    if (in.get<uint32_t>() != kByteOrder) {
+        in.fail("was saved on a machine of a different byte order");
+    }
+    const char* cell = in.take(4);
+    header.cell.assign(cell, std::find(cell, cell + 4, '\0'));
+    header.cell_size = in.get<uint32_t>();
+    header.entry = in.get<int32_t>();
+    header.payload_size = in.get<uint64_t>();
+    header.checksum = in.get<uint64_t>();
+    return header;
+}
+
+} // namespace
+
+std::string imageCellType(const std::string& path) {
+    SourceFile file(path);
+    Reader in(path, file.text());
+    return readHeader(in).cell;
+}
+
+template <typename Cell>
+void saveImage(const std::string& path, const BasicCodeSpace<Cell>& space, const CellMemory<Cell>& memory,
+               int32_t entry) {
+    if (!memory.files().empty()) {
+        throw std::runtime_error("Cannot save image '" + path + "' while a file is mapped into memory; UNMAP it first");
+    }
+    Writer out;
+    const Dictionary& dictionary = space.dictionary;
+    out.put<uint64_t>(dictionary.size());
+    for (size_t i = 0; i < dictionary.size(); ++i) {
+        int32_t slot = static_cast<int32_t>(i);
+        const WordEffect& effect = dictionary.effect(slot);
+        out.putText(dictionary.name(slot));
+        out.put<uint64_t>(dictionary.entry(slot));
+        out.put<uint8_t>(effect.known);
+        out.put<int32_t>(effect.need);
+        out.put<int32_t>(effect.net);
+        out.put<int32_t>(effect.grow);
+        out.put<uint8_t>(dictionary.isRelied(slot));
+    }
+
+    out.put<uint64_t>(space.code.size());
+    for (size_t at = 0; at < space.code.size(); ++at) {
+        Instruction instruction = space.original(at);
+        out.put<uint8_t>(static_cast<uint8_t>(instruction.op));
+        out.put<int32_t>(instruction.arg);
+    }
+    out.put<uint64_t>(space.constants.size());
+    for (Cell constant : space.constants) {
+        out.put<Cell>(constant);
+    }
+    out.put<uint64_t>(space.strings.size());
+    for (const std::string& text : space.strings) {
+        out.putText(text);
+    }
+    out.put<uint64_t>(space.definitions.size());
+    for (const PendingDefinition& definition : space.definitions) {
+        out.put<int32_t>(definition.slot);
+        out.put<uint64_t>(definition.entry);
+    }
+    out.put<uint64_t>(space.inline_bodies.size());
+    for (const auto& [slot, length] : space.inline_bodies) {
+        out.put<int32_t>(slot);
+        out.put<uint64_t>(length);
+    }
+    out.put<uint64_t>(space.inline_sites.size());
+    for (const InlineSite& site : space.inline_sites) {
+        out.put<int32_t>(site.slot);
+        out.put<uint64_t>(site.begin);
+        out.put<uint64_t>(site.end);
+    }
+
+    // Memory past the last cell in use is zero, and left out.
+    size_t used = memory.used();
+    out.put<uint64_t>(used);
+    for (size_t i = 0; i < used; ++i) {
+        out.put<Cell>(memory[i]);
+    }
+
+    Writer header;
+    header.bytes.append(kMagic, sizeof(kMagic));
+    header.put<uint32_t>(kImageVersion);
+    header.put<uint32_t>(kByteOrder);
+    char cell[4] = {};
+    std::strncpy(cell, CellTraits<Cell>::name, sizeof(cell));
+    header.bytes.append(cell, sizeof(cell));
+    header.put<uint32_t>(sizeof(Cell));
+    header.put<int32_t>(entry);
+    header.put<uint64_t>(out.bytes.size());
+    header.put<uint64_t>(hashBytes(out.bytes));
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open file '" + path + "'");
+    }
+    file.write(header.bytes.data(), static_cast<std::streamsize>(header.bytes.size()));
+    file.write(out.bytes.data(), static_cast<std::streamsize>(out.bytes.size()));
+    if (!file.flush()) {
+        throw std::runtime_error("Could not write image '" + path + "'");
+    }
+}
+
+template <typename Cell>
+int32_t loadImage(const std::string& path, std::string_view bytes, BasicCodeSpace<Cell>& space,
+                  CellMemory<Cell>& memory) {
+    if (!space.code.empty() || space.dictionary.size() != 0) {
+        throw std::runtime_error("An image can only be loaded before any other code");
+    }
+
+    Reader in(path, bytes);
+    Header header = readHeader(in);
+    if (header.cell != CellTraits<Cell>::name || header.cell_size != sizeof(Cell)) {
+        in.fail("holds " + header.cell + " cells, not " + CellTraits<Cell>::name);
+    }
+    if (header.payload_size != bytes.size() - kHeaderSize) {
+        in.fail("is truncated");
+    }
+    if (hashBytes(bytes.substr(kHeaderSize)) != header.checksum) {
+        in.fail("is damaged: its checksum does not match");
+    }
+
+    Dictionary& dictionary = space.dictionary;
+    size_t words = in.getCount(8 + 8 + 1 + 12 + 1);
+    for (size_t i = 0; i < words; ++i) {
+        int32_t slot = dictionary.intern(in.getText());
+        if (static_cast<size_t>(slot) != i) {
+            in.fail("names a word twice");
+        }
+        dictionary.bind(slot, static_cast<size_t>(in.get<uint64_t>()));
+        WordEffect effect;
+        effect.known = in.get<uint8_t>() != 0;
+        effect.need = in.get<int32_t>();
+        effect.net = in.get<int32_t>();
+        effect.grow = in.get<int32_t>();
+        dictionary.setEffect(slot, effect);
+        if (in.get<uint8_t>() != 0) {
+            dictionary.markRelied(slot);
+        }
+    }
+
+    size_t instructions = in.getCount(1 + 4);
+    space.code.reserve(instructions);
+    for (size_t i = 0; i < instructions; ++i) {
+        uint8_t op = in.get<uint8_t>();
+        int32_t arg = in.get<int32_t>();
+        // Native entries belong to the process that saved the image.
+        if (op >= static_cast<uint8_t>(OpCode::Native)) {
+            in.fail("holds an unknown instruction");
+        }
+        space.code.push_back({static_cast<OpCode>(op), arg});
+    }
+    size_t constants = in.getCount(sizeof(Cell));
+    space.constants.reserve(constants);
+    for (size_t i = 0; i < constants; ++i) {
+        space.constants.push_back(in.get<Cell>());
+    }
+    size_t strings = in.getCount(8);
+    space.strings.reserve(strings);
+    for (size_t i = 0; i < strings; ++i) {
+        space.strings.emplace_back(in.getText());
+    }
+    size_t definitions = in.getCount(4 + 8);
+    for (size_t i = 0; i < definitions; ++i) {
+        int32_t slot = in.get<int32_t>();
+        size_t entry = static_cast<size_t>(in.get<uint64_t>());
+        space.definitions.push_back({slot, entry});
+    }
+    size_t bodies = in.getCount(4 + 8);
+    for (size_t i = 0; i < bodies; ++i) {
+        int32_t slot = in.get<int32_t>();
+        space.inline_bodies[slot] = static_cast<size_t>(in.get<uint64_t>());
+    }
+    size_t sites = in.getCount(4 + 8 + 8);
+    for (size_t i = 0; i < sites; ++i) {
+        int32_t slot = in.get<int32_t>();
+        size_t begin = static_cast<size_t>(in.get<uint64_t>());
+        size_t end = static_cast<size_t>(in.get<uint64_t>());
+        space.inline_sites.push_back({slot, begin, end});
+    }
+    size_t used = in.getCount(sizeof(Cell));
+    if (used > memory.size()) {
+        in.fail("uses " + std::to_string(used) + " cells of memory; this interpreter has " +
+                std::to_string(memory.size()));
+    }
+    memory.clear();
+    for (size_t i = 0; i < used; ++i) {
+        memory[i] = in.get<Cell>();
+    }
+    if (!in.done()) {
+        in.fail("has trailing data");
+    }
+
+    // The checksum only proves the file is what was written. The VM trusts
+    // the operands to stay inside its tables, the Checks to cover the stack
+    // and loop words to have a frame, so all three are verified here.
+    size_t size = space.code.size();
+    auto isSlot = [&](int64_t slot) { return slot >= 0 && static_cast<size_t>(slot) < dictionary.size(); };
+    auto isEntry = [&](size_t entry) { return entry < size; };
+    for (size_t at = 0; at < size; ++at) {
+        const Instruction& instruction = space.code[at];
+        bool valid = true;
+        switch (instruction.op) {
+            case OpCode::Lit: case OpCode::AddI: case OpCode::MulI: case OpCode::FetchIOffset:
+                valid = instruction.arg >= 0 && static_cast<size_t>(instruction.arg) < space.constants.size();
+                break;
+            case OpCode::Print:
+                valid = instruction.arg >= 0 && static_cast<size_t>(instruction.arg) < space.strings.size();
+                break;
+            case OpCode::Call: case OpCode::TailCall:
+                valid = isSlot(instruction.arg);
+                break;
+            case OpCode::Define:
+                valid = instruction.arg >= 0 && static_cast<size_t>(instruction.arg) < space.definitions.size();
+                break;
+            case OpCode::LoopIndex:
+                valid = instruction.arg >= 1 && instruction.arg <= 3;
+                break;
+            default:
+                if (isJump(instruction.op)) {
+                    int64_t target = static_cast<int64_t>(at) + instruction.arg;
+                    valid = target >= 0 && static_cast<size_t>(target) < size;
+                }
+                break;
+        }
+        if (!valid) {
+            in.fail("has an operand out of range at instruction " + std::to_string(at));
+        }
+    }
+    for (size_t slot = 0; slot < dictionary.size(); ++slot) {
+        size_t entry = dictionary.entry(static_cast<int32_t>(slot));
+        if (entry != Dictionary::unbound && !isEntry(entry)) {
+            in.fail("binds a word outside its code");
+        }
+    }
+    for (const PendingDefinition& definition : space.definitions) {
+        if (!isSlot(definition.slot) || !isEntry(definition.entry)) {
+            in.fail("has a definition outside its code");
+        }
+    }
+    for (const auto& [slot, length] : space.inline_bodies) {
+        if (!isSlot(slot) || dictionary.entry(slot) == Dictionary::unbound ||
+            length > size - dictionary.entry(slot)) {
+            in.fail("has an inline body outside its code");
+        }
+    }
+    for (const InlineSite& site : space.inline_sites) {
+        if (!isSlot(site.slot) || site.begin >= site.end || site.end > size) {
+            in.fail("has an inline site outside its code");
+        }
+    }
+    std::string problem;
+    if (!verifyStackChecks(space.code, dictionary, space.definitions, problem)) {
+        in.fail(problem);
+    }
+    if (header.entry != -1 && (!isSlot(header.entry) || dictionary.entry(header.entry) == Dictionary::unbound)) {
+        in.fail("has no word at its entry point");
+    }
+    return header.entry;
+}
+
+#define PELI_INSTANTIATE_IMAGE(Cell)                                                                          \
+    template void saveImage<Cell>(const std::string&, const BasicCodeSpace<Cell>&, const CellMemory<Cell>&,   \
+                                  int32_t);                                                                   \
+    template int32_t loadImage<Cell>(const std::string&, std::string_view, BasicCodeSpace<Cell>&,             \
+                                     CellMemory<Cell>&);
+PELI_CELL_TYPES(PELI_INSTANTIATE_IMAGE)
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Bytecode.hpp"
+#include "Cell.hpp"
+#include "Memory.hpp"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A saved interpreter, like a classic Forth image: the compiled code space
+// and dictionary, the used part of memory and the word to run once loaded.
+// Nothing in it is source text, so loading one neither lexes nor parses.
+//
+// The file starts with a fixed header: a magic string, the format version,
+// a byte-order mark, the cell type and a checksum of everything after the
+// header. Images only load into builds that read their version, on
+// machines of the same byte order, with the cell type they were saved with.
+// The version goes up whenever the opcodes are renumbered, since bytecode
+// from an older image would otherwise run as the wrong instructions.
+constexpr uint32_t kImageVersion = 5;
+
+// The cell type ("f64", "i64" or "i32") of the image at `path`. Throws
+// std::runtime_error when the file cannot be read or is not an image.
+std::string imageCellType(const std::string& path);
+
+// Writes `space`, `memory` and the slot of the entry word (-1 for none) to
+// `path`. Instructions the JIT displaced are saved as the compiler laid
+// them out. Throws std::runtime_error when the file cannot be written, or
+// while MAP-FILE has a file mapped into memory: the image would hold a copy
+// of the file that no longer tracks it.
+template <typename Cell>
+void saveImage(const std::string& path, const BasicCodeSpace<Cell>& space, const CellMemory<Cell>& memory,
+               int32_t entry);
+
+// Restores an image from `bytes`, the contents of the file `path`, into an
+// empty code space and `memory`, which keeps its size; returns the entry
+// slot or -1. Every operand is checked against the tables it indexes, so a
+// damaged image is rejected with std::runtime_error rather than run.
+template <typename Cell>
+int32_t loadImage(const std::string& path, std::string_view bytes, BasicCodeSpace<Cell>& space,
+                  CellMemory<Cell>& memory);
+
+#define PELI_DECLARE_IMAGE(Cell)                                                                              \
+    extern template void saveImage<Cell>(const std::string&, const BasicCodeSpace<Cell>&,                     \
+                                         const CellMemory<Cell>&, int32_t);                                   \
+    extern template int32_t loadImage<Cell>(const std::string&, std::string_view, BasicCodeSpace<Cell>&,      \
+                                            CellMemory<Cell>&);
+PELI_CELL_TYPES(PELI_DECLARE_IMAGE)
+#undef PELI_DECLARE_IMAGE
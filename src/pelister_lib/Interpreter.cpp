@@ -1,241 +1,597 @@
 #include "Interpreter.hpp"
+#include "Compiler.hpp"
+#include "Image.hpp"
+#include "Modules.hpp"
+#include "SourceFile.hpp"
 #include <stdexcept>
 #include <iostream>
 #include <cmath>
+#include <algorithm>
 
-Interpreter::Interpreter() : memory(64 * 1024, 0.0) {
+template <typename Cell>
+BasicInterpreter<Cell>::BasicInterpreter(ExecutionMode mode)
+    : BasicInterpreter(InterpreterOptions{mode}) {
 }
 
-void Interpreter::push(double value) {
-    stack.push_back(value);
+template <typename Cell>
+BasicInterpreter<Cell>::BasicInterpreter(const InterpreterOptions& options)
+    : mode(options.mode),
+      optimizer(options.optimizer),
+      stack(options.data_stack_depth, "Stack"),
+      memory(options.memory_cells, options.huge_pages),
+      return_stack(options.return_stack_depth, "Return stack"),
+      call_depth(options.call_depth),
+      use_jit(options.jit && BasicJit<Cell>::supported),
+      jit(stack, memory) {
 }
 
-double Interpreter::pop() {
-    if (stack.empty()) {
-        throw std::runtime_error("Stack underflow");
-    }
-    double value = stack.back();
-    stack.pop_back();
-    return value;
+template <typename Cell>
+void BasicInterpreter<Cell>::push(Cell value) {
+    stack.push(value);
+}
+
+template <typename Cell>
+Cell BasicInterpreter<Cell>::pop() {
+    return stack.pop();
+}
+
+template <typename Cell>
+void BasicInterpreter<Cell>::rpush(Cell value) {
+    return_stack.push(value);
+}
+
+template <typename Cell>
+Cell BasicInterpreter<Cell>::rpop() {
+    return return_stack.pop();
+}
+
+
+template <typename Cell>
+std::vector<Cell> BasicInterpreter<Cell>::getStack() const {
+    return stack.snapshot();
+}
+
+template <typename Cell>
+const BasicCodeSpace<Cell>& BasicInterpreter<Cell>::getCodeSpace() const {
+    return code_space;
 }
 
-void Interpreter::rpush(double value) {
-    return_stack.push_back(value);
+template <typename Cell>
+void BasicInterpreter<Cell>::printStack() const {
+    printCells(stack.begin(), stack.end());
 }
 
-double Interpreter::rpop() {
-    if (return_stack.empty()) {
-        throw std::runtime_error("Return stack underflow");
+template <typename Cell>
+void BasicInterpreter<Cell>::saveImage(const std::string& path, const std::string& entry) const {
+    if (mode == ExecutionMode::TreeWalk) {
+        throw std::runtime_error("Images hold bytecode and cannot be saved by the tree-walking interpreter");
+    }
+    int32_t slot = -1;
+    if (!entry.empty()) {
+        if (!code_space.dictionary.isDefined(entry)) {
+            throw std::runtime_error("Entry point " + entry + " is not defined");
+        }
+        slot = code_space.dictionary.find(entry);
     }
-    double value = return_stack.back();
-    return_stack.pop_back();
-    return value;
+    ::saveImage(path, code_space, memory, slot);
 }
 
+template <typename Cell>
+void BasicInterpreter<Cell>::loadImage(const std::string& path) {
+    if (mode == ExecutionMode::TreeWalk) {
+        throw std::runtime_error("Images hold bytecode and cannot be loaded by the tree-walking interpreter");
+    }
+    int32_t entry;
+    {
+        SourceFile file(path);
+        entry = ::loadImage(path, file.text(), code_space, memory);
+    }
+    if (use_jit) {
+        jit.compile(code_space, 0, code_space.code.size());
+    }
+    if (entry < 0) {
+        return;
+    }
 
-const std::vector<double>& Interpreter::getStack() const {
-    return stack;
+    // Call the entry word from a throwaway segment of its own.
+    size_t mark = code_space.code.size();
+    code_space.code.push_back({OpCode::Call, entry});
+    code_space.code.push_back({OpCode::Halt, 0});
+    try {
+        execute(mark);
+    } catch (...) {
+        code_space.code.resize(mark);
+        throw;
+    }
+    code_space.code.resize(mark);
 }
 
-void Interpreter::printStack() const {
-    std::cout << "<stack bottom> ";
-    for (double val : stack) {
-        std::cout << val << " ";
+template <typename Cell>
+void BasicInterpreter<Cell>::evaluate(const Ast& ast, const std::string& directory) {
+    std::filesystem::path base = directory.empty() ? std::filesystem::current_path() : std::filesystem::path(directory);
+    loadModules(ast, base);
+    if (mode == ExecutionMode::TreeWalk) {
+        loop_frames.clear();
     }
-    std::cout << "<top>" << std::endl;
+    run(ast, base);
 }
 
-void Interpreter::evaluate(const ProgramNode& ast) {
-    for (const auto& node : ast.getNodes()) {
-        if (auto numNode = dynamic_cast<const NumberNode*>(node.get())) {
-            push(numNode->getValue());
+template <typename Cell>
+void BasicInterpreter<Cell>::run(const Ast& ast, const std::filesystem::path& directory) {
+    if (mode == ExecutionMode::TreeWalk) {
+        for (const AstNode& node : ast.root().children()) {
+            if (node.kind() == AstKind::Include) {
+                include(node, directory);
+            } else {
+                evaluateNode(node);
+            }
         }
-        else if (auto ifNode = dynamic_cast<const IfNode*>(node.get())) {
-            double condition = pop();
-            if (condition != 0.0) {
-                evaluate(ifNode->getTrueBranch());
-            } else if (ifNode->hasFalseBranch()) {
-                evaluate(ifNode->getFalseBranch());
+        return;
+    }
+
+    // Top-level definitions are compiled and bound as soon as they are seen,
+    // like Forth's ':', so the statements between them run as separate
+    // segments that observe exactly the definitions that precede them. A
+    // module runs at its INCLUDE the same way.
+    std::vector<const AstNode*> segment;
+    for (const AstNode& node : ast.root().children()) {
+        if (node.kind() == AstKind::Definition) {
+            runSegment(segment);
+            segment.clear();
+            size_t mark = code_space.code.size();
+            BasicCompiler<Cell> compiler(code_space, optimizer);
+            compiler.compileDefinition(std::string(node.getName()), node.getBody());
+            if (use_jit) {
+                jit.compile(code_space, mark, code_space.code.size());
             }
+        } else if (node.kind() == AstKind::Include) {
+            runSegment(segment);
+            segment.clear();
+            include(node, directory);
+        } else {
+            segment.push_back(&node);
         }
-        else if (auto doNode = dynamic_cast<const DoLoopNode*>(node.get())) {
-            double start = pop();
-            double limit = pop();
+    }
+    runSegment(segment);
+}
 
-            for (long i = (long)start; i < (long)limit; ++i) {
-                loop_indices.push_back(i); // Push current index for 'I' to access
-                evaluate(doNode->getBody());
-                loop_indices.pop_back(); // Pop index after iteration
+// Finds every module `ast` pulls in, directly or not, that has not been
+// parsed yet, and parses them. Each round takes the includes of the modules
+// found in the last one, so independent modules are read side by side.
+template <typename Cell>
+void BasicInterpreter<Cell>::loadModules(const Ast& ast, const std::filesystem::path& directory) {
+    std::vector<std::pair<const Ast*, std::filesystem::path>> pending{{&ast, directory}};
+    while (!pending.empty()) {
+        std::vector<std::string> wave;
+        for (const auto& [tree, base] : pending) {
+            for (const AstNode& node : tree->root().children()) {
+                if (node.kind() != AstKind::Include) {
+                    continue;
+                }
+                std::string path = resolveModule(base, node.getPath());
+                if (!modules.count(path) && std::find(wave.begin(), wave.end(), path) == wave.end()) {
+                    wave.push_back(path);
+                }
             }
         }
-        else if (auto defNode = dynamic_cast<FunctionDefinitionNode*>(node.get())) {
-            dictionary[defNode->getName()] = const_cast<FunctionDefinitionNode*>(defNode)->releaseBody();
+        if (wave.empty()) {
+            break;
+        }
+
+        std::vector<Ast> trees = parseModules(wave);
+        pending.clear();
+        for (size_t i = 0; i < wave.size(); ++i) {
+            auto module = std::make_unique<Module>(
+                Module{std::filesystem::path(wave[i]).parent_path(), std::move(trees[i])});
+            pending.emplace_back(&module->ast, module->directory);
+            modules.emplace(wave[i], std::move(module));
+        }
+    }
+}
+
+template <typename Cell>
+void BasicInterpreter<Cell>::include(const AstNode& node, const std::filesystem::path& directory) {
+    std::string path = resolveModule(directory, node.getPath());
+    if (node.isOnce() && included.count(path)) {
+        return;
+    }
+    if (std::find(including.begin(), including.end(), path) != including.end()) {
+        throw std::runtime_error("Module '" + path + "' includes itself");
+    }
+    included.insert(path);
+
+    const Module& module = *modules.at(path);
+    including.push_back(path);
+    try {
+        run(module.ast, module.directory);
+    } catch (...) {
+        including.pop_back();
+        throw;
+    }
+    including.pop_back();
+}
+
+template <typename Cell>
+void BasicInterpreter<Cell>::runSegment(const std::vector<const AstNode*>& nodes) {
+    if (nodes.empty()) {
+        return;
+    }
+
+    size_t code_mark = code_space.code.size();
+    size_t constant_mark = code_space.constants.size();
+    size_t string_mark = code_space.strings.size();
+    size_t definition_mark = code_space.definitions.size();
+
+    BasicCompiler<Cell> compiler(code_space, optimizer);
+    size_t entry = compiler.compileSegment(nodes);
+    if (use_jit) {
+        jit.compile(code_space, code_mark, code_space.code.size());
+    }
+
+    // Top-level code runs once; drop it afterwards unless it laid out the
+    // body of a nested definition that may still be bound and called.
+    bool discardable = code_space.definitions.size() == definition_mark;
+    auto release = [&]() {
+        if (discardable) {
+            jit.release(code_space, code_mark);
+            code_space.code.resize(code_mark);
+            code_space.constants.resize(constant_mark);
+            code_space.strings.resize(string_mark);
+            auto& sites = code_space.inline_sites;
+            sites.erase(std::remove_if(sites.begin(), sites.end(),
+                                       [&](const InlineSite& site) { return site.begin >= code_mark; }),
+                        sites.end());
+        }
+    };
+    try {
+        execute(entry);
+    } catch (...) {
+        release();
+        throw;
+    }
+    release();
+}
+
+template <typename Cell>
+typename BasicInterpreter<Cell>::Flow BasicInterpreter<Cell>::evaluateTree(const AstNode& block) {
+    for (const AstNode& node : block.children()) {
+        Flow flow = evaluateNode(node);
+        if (flow != Flow::Next) {
+            return flow;
         }
-        else if (auto wordNode = dynamic_cast<const WordNode*>(node.get())) {
-            const auto& token = wordNode->getToken();
+    }
+    return Flow::Next;
+}
 
-            auto it = dictionary.find(token.text);
-            if (it != dictionary.end()) {
-                evaluate(*(it->second));
-                continue;
+template <typename Cell>
+typename BasicInterpreter<Cell>::Flow BasicInterpreter<Cell>::evaluateNode(const AstNode& node) {
+    if (node.kind() == AstKind::Number) {
+        Cell value;
+        if (!node.toCell(value)) {
+            throw std::runtime_error("Literal " + node.toString() + " is not representable in " +
+                                     CellTraits<Cell>::name + " cells");
+        }
+        push(value);
+    }
+    else if (node.kind() == AstKind::If) {
+        Cell condition = pop();
+        Flow flow = evaluateTree(condition != 0 ? node.getTrueBranch() : node.getFalseBranch());
+        if (flow != Flow::Next) {
+            return flow;
+        }
+    }
+    else if (node.kind() == AstKind::DoLoop) {
+        long start = (long)pop();
+        long limit = (long)pop();
+        if (node.isConditional() ? start == limit : start >= limit) {
+            return Flow::Next;
+        }
+
+        loop_frames.push_back({start, limit});
+        Flow flow;
+        for (;;) {
+            flow = evaluateTree(node.getBody());
+            if (flow != Flow::Next) {
+                break;
+            }
+            if (node.isPlusLoop() ? !loop_frames.back().step((long)pop())
+                                  : ++loop_frames.back().index >= limit) {
+                break;
             }
+        }
+        // EXIT has already been through UNLOOP.
+        if (flow == Flow::Exit) {
+            return flow;
+        }
+        loop_frames.pop_back();
+    }
+    else if (node.kind() == AstKind::Definition) {
+        // The definition outlives the tree it was parsed into, so the
+        // word keeps a copy.
+        dictionary[node.getSymbol()] = std::make_shared<const Ast>(Ast::copyOf(node));
+    }
+    else if (node.kind() == AstKind::Word) {
+        const Token token = node.getToken();
 
-            switch (token.type) {
-                case TokenType::Plus: {
-                    double b = pop(); double a = pop(); push(a + b); break;
-                }
-                case TokenType::Minus: {
-                    double b = pop(); double a = pop(); push(a - b); break;
-                }
-                case TokenType::Multiply: {
-                    double b = pop(); double a = pop(); push(a * b); break;
-                }
-                case TokenType::Divide: {
-                    double b = pop(); double a = pop(); if (b == 0) throw std::runtime_error("Division by zero"); push(a / b); break;
-                }
-                case TokenType::Mod: {
-                    double b = pop(); double a = pop(); push(fmod(a, b)); break;
-                }
-                case TokenType::Equals: {
-                    double b = pop(); double a = pop(); push(a == b ? 1.0 : 0.0); break;
-                }
-                case TokenType::LessThan: {
-                    double b = pop(); double a = pop(); push(a < b ? 1.0 : 0.0); break;
-                }
-                case TokenType::GreaterThan: {
-                    double b = pop(); double a = pop(); push(a > b ? 1.0 : 0.0); break;
-                }
-                case TokenType::And: {
-                    double b = pop(); double a = pop(); push(static_cast<double>((long)a & (long)b)); break;
-                }
-                case TokenType::Or: {
-                    double b = pop(); double a = pop(); push(static_cast<double>((long)a | (long)b)); break;
-                }
-                case TokenType::Not: {
-                    double a = pop(); push(a == 0.0 ? 1.0 : 0.0); break;
-                }
-                case TokenType::Dup: {
-                    double a = pop(); push(a); push(a); break;
-                }
-                case TokenType::Drop: {
-                    pop(); break;
-                }
-                case TokenType::Swap: {
-                    double b = pop(); double a = pop(); push(b); push(a); break;
-                }
-                case TokenType::Over: {
-                    double b = pop(); double a = pop(); push(a); push(b); push(a); break;
-                }
-                case TokenType::Rot: {
-                    double c = pop(); double b = pop(); double a = pop(); push(b); push(c); push(a); break;
-                }
-                case TokenType::ToR: { // >R
-                    rpush(pop());
-                    break;
-                }
-                case TokenType::RFrom: { // R>
-                    push(rpop());
-                    break;
-                }
-                case TokenType::RFetch: { // R@
-                    if (return_stack.empty()) {
-                        throw std::runtime_error("Return stack underflow");
-                    }
-                    push(return_stack.back());
-                    break;
-                }
-                case TokenType::Store: {
-                    double addr = pop(); double val = pop(); if (addr < 0 || addr >= memory.size()) throw std::runtime_error("Memory access out of bounds"); memory[(size_t)addr] = val; break;
-                }
-                case TokenType::Fetch: {
-                    double addr = pop(); if (addr < 0 || addr >= memory.size()) throw std::runtime_error("Memory access out of bounds"); push(memory[(size_t)addr]); break;
-                }
-                case TokenType::LoopIndexI: {
-                    if (loop_indices.empty()) {
-                        throw std::runtime_error("'I' can only be used inside a DO...LOOP");
-                    }
-                    push(loop_indices.back());
-                    break;
-                }
-                case TokenType::LoopIndexJ: {
-                    if (loop_indices.size() < 2) {
-                        throw std::runtime_error("'J' can only be used inside nested DO...LOOPs");
-                    }
-                    push(loop_indices[loop_indices.size() - 2]);
-                    break;
+        auto it = dictionary.find(token.symbol);
+        if (it != dictionary.end()) {
+            // Held while it runs, in case it redefines itself.
+            std::shared_ptr<const Ast> definition = it->second;
+            evaluateTree(definition->root().getBody()); // EXIT ends here
+            return Flow::Next;
+        }
+
+        switch (token.type) {
+            case TokenType::Plus: {
+                Cell b = pop(); Cell a = pop(); push(cellAdd(a, b)); break;
+            }
+            case TokenType::Minus: {
+                Cell b = pop(); Cell a = pop(); push(cellSub(a, b)); break;
+            }
+            case TokenType::Multiply: {
+                Cell b = pop(); Cell a = pop(); push(cellMul(a, b)); break;
+            }
+            case TokenType::Divide: {
+                Cell b = pop(); Cell a = pop(); if (b == 0) throw std::runtime_error("Division by zero"); push(cellDiv(a, b)); break;
+            }
+            case TokenType::Mod: {
+                Cell b = pop(); Cell a = pop(); if (cellIsInteger<Cell> && b == 0) throw std::runtime_error("Division by zero"); push(cellMod(a, b)); break;
+            }
+            case TokenType::Equals: {
+                Cell b = pop(); Cell a = pop(); push(a == b ? 1 : 0); break;
+            }
+            case TokenType::LessThan: {
+                Cell b = pop(); Cell a = pop(); push(a < b ? 1 : 0); break;
+            }
+            case TokenType::GreaterThan: {
+                Cell b = pop(); Cell a = pop(); push(a > b ? 1 : 0); break;
+            }
+            case TokenType::And: {
+                Cell b = pop(); Cell a = pop(); push(cellAnd(a, b)); break;
+            }
+            case TokenType::Or: {
+                Cell b = pop(); Cell a = pop(); push(cellOr(a, b)); break;
+            }
+            case TokenType::Not: {
+                Cell a = pop(); push(a == 0 ? 1 : 0); break;
+            }
+            case TokenType::Dup: {
+                Cell a = pop(); push(a); push(a); break;
+            }
+            case TokenType::Drop: {
+                pop(); break;
+            }
+            case TokenType::Swap: {
+                Cell b = pop(); Cell a = pop(); push(b); push(a); break;
+            }
+            case TokenType::Over: {
+                Cell b = pop(); Cell a = pop(); push(a); push(b); push(a); break;
+            }
+            case TokenType::Rot: {
+                Cell c = pop(); Cell b = pop(); Cell a = pop(); push(b); push(c); push(a); break;
+            }
+            case TokenType::ToR: { // >R
+                rpush(pop());
+                break;
+            }
+            case TokenType::RFrom: { // R>
+                push(rpop());
+                break;
+            }
+            case TokenType::RFetch: { // R@
+                push(return_stack.peek());
+                break;
+            }
+            case TokenType::Store: {
+                Cell addr = pop(); Cell val = pop(); const char* error = nullptr; Cell* cell = cellForStore(memory, addr, error); if (!cell) throw std::runtime_error(error); *cell = val; break;
+            }
+            case TokenType::Fetch: {
+                Cell addr = pop(); size_t index; if (!cellToIndex(addr, memory.size(), index)) throw std::runtime_error("Memory access out of bounds"); push(memory[index]); break;
+            }
+            case TokenType::CStore: {
+                Cell addr = pop(); Cell val = pop(); const char* error = nullptr; unsigned char* byte = byteForStore(memory, addr, error); if (!byte) throw std::runtime_error(error); *byte = cellToByte(val); break;
+            }
+            case TokenType::CFetch: {
+                Cell addr = pop(); unsigned char* byte = byteAt(memory, addr); if (!byte) throw std::runtime_error("Memory access out of bounds"); push(static_cast<Cell>(*byte)); break;
+            }
+            case TokenType::LoopIndexI: {
+                if (loop_frames.empty()) {
+                    throw std::runtime_error("'I' can only be used inside a DO...LOOP");
                 }
-                case TokenType::LoopIndexK: {
-                    if (loop_indices.size() < 3) {
-                        throw std::runtime_error("'K' can only be used inside triply-nested DO...LOOPs");
-                    }
-                    push(loop_indices[loop_indices.size() - 3]);
-                    break;
+                push(static_cast<Cell>(loop_frames.back().index));
+                break;
+            }
+            case TokenType::LoopIndexJ: {
+                if (loop_frames.size() < 2) {
+                    throw std::runtime_error("'J' can only be used inside nested DO...LOOPs");
                 }
-                case TokenType::Dot: {
-                    std::cout << pop() << " "; break;
+                push(static_cast<Cell>(loop_frames[loop_frames.size() - 2].index));
+                break;
+            }
+            case TokenType::LoopIndexK: {
+                if (loop_frames.size() < 3) {
+                    throw std::runtime_error("'K' can only be used inside triply-nested DO...LOOPs");
                 }
-                case TokenType::DotS: {
-                                printStack();
+                push(static_cast<Cell>(loop_frames[loop_frames.size() - 3].index));
+                break;
+            }
+            case TokenType::Dot: {
+                std::cout << pop() << " "; break;
+            }
+            case TokenType::DotS: {
+                            printStack();
+                            break;
+                        }
+            case TokenType::Cr: {
+                std::cout << std::endl; break;
+            }
+            case TokenType::DotQuote: {
+                                std::cout << token.text;
                                 break;
                             }
-                case TokenType::Cr: {
-                    std::cout << std::endl; break;
-                }
-                case TokenType::DotQuote: {
-                                    std::cout << token.text;
-                                    break;
-                                }
-                case TokenType::Accept: {
-                                   double max_len = pop();
-                                   double addr = pop();
-
-                                   if (addr < 0 || addr + max_len > memory.size()) {
-                                       throw std::runtime_error("ACCEPT memory out of bounds");
-                                   }
-
-                                   std::string input_line;
-                                   std::getline(std::cin, input_line);
-
-                                   size_t actual_len = std::min((size_t)max_len, input_line.length());
-
-                                   for (size_t i = 0; i < actual_len; ++i) {
-                                       memory[(size_t)addr + i] = static_cast<double>(input_line[i]);
-                                   }
-
-                                   push(static_cast<double>(actual_len));
-                                   break;
-                               }
-                               case TokenType::ToNumber: {
-                                   double len = pop();
-                                   double addr = pop();
-
-                                   if (addr < 0 || addr + len > memory.size()) {
-                                       throw std::runtime_error(">NUMBER memory out of bounds");
-                                   }
-
-                                   std::string str_to_convert;
-                                   for (size_t i = 0; i < (size_t)len; ++i) {
-                                       str_to_convert += static_cast<char>(memory[(size_t)addr + i]);
-                                   }
-
-                                   try {
-                                       double num = std::stod(str_to_convert);
-                                       push(num);
-                                   } catch (const std::invalid_argument& e) {
-                                       throw std::runtime_error("Invalid number format for >NUMBER");
-                                   }
-                                   break;
-                               }
-                case TokenType::If: case TokenType::Else: case TokenType::Then:
-                case TokenType::Colon: case TokenType::Semicolon:
-                case TokenType::Do: case TokenType::Loop: {
-                    throw std::runtime_error("Unexpected control flow word during execution: " + token.text);
-                }
+            case TokenType::Accept: {
+                Cell max_len = pop();
+                Cell addr = pop();
+                push(acceptLine(memory, addr, max_len));
+                break;
+            }
+            case TokenType::ToNumber: {
+                Cell len = pop();
+                Cell addr = pop();
+                push(numberFromMemory(memory, addr, len));
+                break;
+            }
+            case TokenType::Type: {
+                Cell len = pop();
+                Cell addr = pop();
+                typeBytes(memory, addr, len);
+                break;
+            }
+            case TokenType::MapFile: {
+                Cell mode = pop();
+                Cell len = pop();
+                Cell addr = pop();
+                Cell base, cells;
+                mapFileInto(memory, addr, len, mode, base, cells);
+                push(base);
+                push(cells);
+                break;
+            }
+            case TokenType::Unmap: {
+                unmapFileAt(memory, pop());
+                break;
+            }
+            case TokenType::Move: {
+                Cell count = pop();
+                Cell to = pop();
+                Cell from = pop();
+                moveCells(memory, from, to, count);
+                break;
+            }
+            case TokenType::Fill: {
+                Cell value = pop();
+                Cell count = pop();
+                Cell addr = pop();
+                fillCells(memory, addr, count, value);
+                break;
+            }
+            case TokenType::Erase: {
+                Cell count = pop();
+                Cell addr = pop();
+                eraseCells(memory, addr, count);
+                break;
+            }
+            case TokenType::Compare: {
+                Cell len2 = pop();
+                Cell addr2 = pop();
+                Cell len1 = pop();
+                Cell addr1 = pop();
+                push(compareBytes(memory, addr1, len1, addr2, len2));
+                break;
+            }
+            case TokenType::Search: {
+                Cell len2 = pop();
+                Cell addr2 = pop();
+                Cell len = pop();
+                Cell addr = pop();
+                bool found = searchBytes(memory, addr, len, addr2, len2);
+                push(addr);
+                push(len);
+                push(found ? 1 : 0);
+                break;
+            }
+            case TokenType::Scan: {
+                Cell value = pop();
+                Cell count = pop();
+                Cell addr = pop();
+                scanCells(memory, addr, count, value);
+                push(addr);
+                push(count);
+                break;
+            }
+            case TokenType::VAdd: {
+                Cell count = pop();
+                Cell to = pop();
+                Cell b = pop();
+                Cell a = pop();
+                vectorAdd(memory, a, b, to, count);
+                break;
+            }
+            case TokenType::VSub: {
+                Cell count = pop();
+                Cell to = pop();
+                Cell b = pop();
+                Cell a = pop();
+                vectorSub(memory, a, b, to, count);
+                break;
+            }
+            case TokenType::VMul: {
+                Cell count = pop();
+                Cell to = pop();
+                Cell b = pop();
+                Cell a = pop();
+                vectorMul(memory, a, b, to, count);
+                break;
+            }
+            case TokenType::VScale: {
+                Cell k = pop();
+                Cell count = pop();
+                Cell to = pop();
+                Cell from = pop();
+                vectorScale(memory, from, to, count, k);
+                break;
+            }
+            case TokenType::VDot: {
+                Cell count = pop();
+                Cell b = pop();
+                Cell a = pop();
+                push(vectorDot(memory, a, b, count));
+                break;
+            }
+            case TokenType::VSum: {
+                Cell count = pop();
+                Cell addr = pop();
+                push(vectorSum(memory, addr, count));
+                break;
+            }
+            case TokenType::VMin: {
+                Cell count = pop();
+                Cell addr = pop();
+                push(vectorMin(memory, addr, count));
+                break;
+            }
+            case TokenType::VMax: {
+                Cell count = pop();
+                Cell addr = pop();
+                push(vectorMax(memory, addr, count));
+                break;
+            }
+            // The parser only accepts these where they have a loop or
+            // definition to leave.
+            case TokenType::Leave: {
+                return Flow::Leave;
+            }
+            case TokenType::Unloop: {
+                loop_frames.pop_back();
+                break;
+            }
+            case TokenType::Exit: {
+                return Flow::Exit;
+            }
+            case TokenType::If: case TokenType::Else: case TokenType::Then:
+            case TokenType::Colon: case TokenType::Semicolon:
+            case TokenType::Do: case TokenType::Loop:
+            case TokenType::QDo: case TokenType::PlusLoop: {
+                throw std::runtime_error("Unexpected control flow word during execution: " + std::string(token.text));
+            }
 
-                default: {
-                    throw std::runtime_error("Unknown word: " + token.text);
-                }
+            default: {
+                throw std::runtime_error("Unknown word: " + std::string(token.text));
             }
         }
     }
+    return Flow::Next;
 }
+
+#define PELI_INSTANTIATE_INTERPRETER(Cell) template class BasicInterpreter<Cell>;
+PELI_CELL_TYPES(PELI_INSTANTIATE_INTERPRETER)
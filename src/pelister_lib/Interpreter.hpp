@@ -1,26 +1,117 @@
 #pragma once
 
 #include "ast.hpp"
+#include "Bytecode.hpp"
+#include "Cell.hpp"
+#include "Jit.hpp"
+#include "Optimizer.hpp"
+#include "Runtime.hpp"
+#include <filesystem>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <unordered_set>
 #include <memory>
 
-class Interpreter {
+enum class ExecutionMode {
+    Bytecode, // Compile to bytecode and run it on the dispatch-loop VM.
+    TreeWalk  // Reference mode: walk the AST directly.
+};
+
+struct InterpreterOptions {
+    ExecutionMode mode = ExecutionMode::Bytecode;
+    size_t data_stack_depth = 4096;
+    size_t return_stack_depth = 1024;
+    // Nesting depth of calls to user words; tail calls do not count.
+    size_t call_depth = 65536;
+    OptimizerOptions optimizer{kMaxOptLevel};
+    // Translate compiled code to native code where BasicJit<Cell> supports it.
+    bool jit = false;
+    // Cells of memory; see CellMemory for how they are committed.
+    size_t memory_cells = kMemoryCells;
+    bool huge_pages = false;
+};
+
+// Stacks, memory and arithmetic all operate on `Cell`; see PELI_CELL_TYPES
+// for the variants the library is built with.
+template <typename Cell>
+class BasicInterpreter {
 public:
-    Interpreter();
-    void evaluate(const ProgramNode& ast);
+    explicit BasicInterpreter(ExecutionMode mode = ExecutionMode::Bytecode);
+    explicit BasicInterpreter(const InterpreterOptions& options);
+    // Runs a parsed program. INCLUDE and REQUIRE name files relative to
+    // `directory`, or to the working directory when it is empty. Every
+    // module the program pulls in is parsed before anything runs, several at
+    // once on worker threads, and then run in source order. Parsed modules
+    // are kept, so later programs that include them again skip the parse.
+    void evaluate(const Ast& ast, const std::string& directory = "");
     void printStack() const;
-    const std::vector<double>& getStack() const;
+    std::vector<Cell> getStack() const;
+    const BasicCodeSpace<Cell>& getCodeSpace() const;
+
+    // Saves the compiled words and memory as an image that runs `entry`, if
+    // not empty, when loaded; see Image.hpp. Bytecode mode only.
+    void saveImage(const std::string& path, const std::string& entry) const;
+    // Loads an image into this interpreter, which must not have run anything
+    // yet, and runs its entry word. The file is mapped, not parsed.
+    void loadImage(const std::string& path);
 private:
-    void push(double value);
-    double pop();
-    void rpush(double value);
-    double rpop();
-
-    std::vector<double> stack;
-    std::unordered_map<std::string, std::unique_ptr<ProgramNode>> dictionary;
-    std::vector<double> memory;
-    std::vector<long> loop_indices;
-    std::vector<double> return_stack;
+    // The control frame of a running DO loop, pushed once when it starts.
+    struct LoopFrame {
+        long index;
+        long limit;
+
+        bool step(long n) { return loopStep(index, limit, n); }
+    };
+
+    // How a tree-walked body finished: normally, by LEAVE out of the
+    // innermost loop or by EXIT out of the current definition.
+    enum class Flow { Next, Leave, Exit };
+
+    // A parsed module and the directory its own includes are relative to.
+    struct Module {
+        std::filesystem::path directory;
+        Ast ast;
+    };
+
+    Flow evaluateTree(const AstNode& block);
+    Flow evaluateNode(const AstNode& node);
+    void run(const Ast& ast, const std::filesystem::path& directory);
+    void loadModules(const Ast& ast, const std::filesystem::path& directory);
+    void include(const AstNode& node, const std::filesystem::path& directory);
+    void runSegment(const std::vector<const AstNode*>& nodes);
+    void execute(size_t entry);
+
+    void push(Cell value);
+    Cell pop();
+    void rpush(Cell value);
+    Cell rpop();
+
+    ExecutionMode mode;
+    OptimizerOptions optimizer;
+    CellStack<Cell> stack;
+    // Tree-walked definitions, each a tree of its own.
+    std::unordered_map<Symbol, std::shared_ptr<const Ast>> dictionary;
+    CellMemory<Cell> memory;
+    CellStack<Cell> return_stack;
+
+    // Parsed modules by resolved path; those run so far, which REQUIRE
+    // skips; and those running now, innermost last.
+    std::unordered_map<std::string, std::unique_ptr<const Module>> modules;
+    std::unordered_set<std::string> included;
+    std::vector<std::string> including;
+
+    BasicCodeSpace<Cell> code_space;
+    std::vector<LoopFrame> loop_frames;
+    std::vector<const Instruction*> call_frames;
+    size_t call_depth;
+    bool use_jit;
+    BasicJit<Cell> jit;
 };
+
+using Interpreter = BasicInterpreter<double>;
+
+#define PELI_DECLARE_INTERPRETER(Cell) extern template class BasicInterpreter<Cell>;
+PELI_CELL_TYPES(PELI_DECLARE_INTERPRETER)
+#undef PELI_DECLARE_INTERPRETER
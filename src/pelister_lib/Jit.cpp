@@ -0,0 +1,777 @@
+#include "Jit.hpp"
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+#if PELI_JIT_AVAILABLE
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+const char* jitStatusMessage(int64_t status) {
+    switch (status) {
+        case kJitUnderflow: return "Stack underflow";
+        case kJitOverflow: return "Stack overflow";
+        case kJitOutOfBounds: return kOutOfBounds;
+        case kJitReadOnly: return kReadOnlyStore;
+        default: return "Unknown JIT status";
+    }
+}
+
+#if PELI_JIT_AVAILABLE
+namespace {
+
+// Just enough of an x86-64 assembler for the templates below. Instructions
+// are written as raw bytes; the comments next to them give the mnemonic.
+// Native code keeps the VM registers in fixed machine registers:
+//   rax  top of stack (raw cell bits)     rbx  sp, the cell below it
+//   r12  innermost loop index             r13  innermost loop limit
+//   r8   memory base                      r9   memory size in cells
+//   r10  data stack base                  r11  memory store limit in cells
+//   r14  JitState*
+// Outer loops are pushed on the native stack, two slots per level.
+class Assembler {
+public:
+    void raw(std::initializer_list<uint8_t> bytes) { code.insert(code.end(), bytes); }
+
+    void imm32(int32_t value) { append(&value, sizeof(value)); }
+    void imm64(uint64_t value) { append(&value, sizeof(value)); }
+
+    size_t here() const { return code.size(); }
+
+    // Emits a jmp/jcc with a blank rel32 and returns the position to patch.
+    size_t jump() {
+        raw({0xE9});
+        imm32(0);
+        return here() - 4;
+    }
+    size_t jumpIf(uint8_t condition) {
+        raw({0x0F, condition});
+        imm32(0);
+        return here() - 4;
+    }
+    void patch(size_t at, size_t target) {
+        int32_t rel = static_cast<int32_t>(static_cast<long>(target) - static_cast<long>(at + 4));
+        std::memcpy(&code[at], &rel, sizeof(rel));
+    }
+
+    // Stack cell access relative to rbx.
+    void storeTos(int8_t disp) { raw({0x48, 0x89, 0x43, static_cast<uint8_t>(disp)}); }   // mov [rbx+d], rax
+    void loadTos(int8_t disp) { raw({0x48, 0x8B, 0x43, static_cast<uint8_t>(disp)}); }    // mov rax, [rbx+d]
+    void loadRcx(int8_t disp) { raw({0x48, 0x8B, 0x4B, static_cast<uint8_t>(disp)}); }    // mov rcx, [rbx+d]
+    void loadRdx(int8_t disp) { raw({0x48, 0x8B, 0x53, static_cast<uint8_t>(disp)}); }    // mov rdx, [rbx+d]
+    void storeRcx(int8_t disp) { raw({0x48, 0x89, 0x4B, static_cast<uint8_t>(disp)}); }   // mov [rbx+d], rcx
+    void storeRdx(int8_t disp) { raw({0x48, 0x89, 0x53, static_cast<uint8_t>(disp)}); }   // mov [rbx+d], rdx
+    void moveSp(int8_t cells) { raw({0x48, 0x8D, 0x5B, static_cast<uint8_t>(cells * 8)}); } // lea rbx, [rbx+8n]
+
+    void push() { storeTos(8); moveSp(1); }
+    void pop() { loadTos(0); moveSp(-1); }
+
+    void movRaxImm(uint64_t value) { raw({0x48, 0xB8}); imm64(value); } // mov rax, imm64
+    void movRcxImm(uint64_t value) { raw({0x48, 0xB9}); imm64(value); } // mov rcx, imm64
+    void movRaxRcx() { raw({0x48, 0x89, 0xC8}); }                       // mov rax, rcx
+    void movRcxRax() { raw({0x48, 0x89, 0xC1}); }                       // mov rcx, rax
+    void boolToRax() { raw({0x0F, 0xB6, 0xC0}); }                       // movzx eax, al
+
+    // f64 helpers: xmm0/xmm1 are scratch.
+    void xmm0FromStack() { raw({0xF2, 0x0F, 0x10, 0x43, 0x00}); } // movsd xmm0, [rbx]
+    void xmm0FromRax() { raw({0x66, 0x48, 0x0F, 0x6E, 0xC0}); }    // movq xmm0, rax
+    void xmm1FromRax() { raw({0x66, 0x48, 0x0F, 0x6E, 0xC8}); }    // movq xmm1, rax
+    void xmm1FromRcx() { raw({0x66, 0x48, 0x0F, 0x6E, 0xC9}); }    // movq xmm1, rcx
+    void raxFromXmm0() { raw({0x66, 0x48, 0x0F, 0x7E, 0xC0}); }    // movq rax, xmm0
+    void boolToXmm0() {
+        boolToRax();
+        raw({0xF2, 0x48, 0x0F, 0x2A, 0xC0}); // cvtsi2sd xmm0, rax
+        raxFromXmm0();
+    }
+    void zeroXmm1() { raw({0x66, 0x0F, 0x57, 0xC9}); } // xorpd xmm1, xmm1
+
+    std::vector<uint8_t> code;
+
+private:
+    void append(const void* data, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        code.insert(code.end(), bytes, bytes + size);
+    }
+};
+
+constexpr uint8_t kJumpIfZero = 0x84;
+constexpr uint8_t kJumpIfBelow = 0x82;
+constexpr uint8_t kJumpIfAboveOrEqual = 0x83;
+constexpr uint8_t kJumpIfNotSign = 0x89;
+constexpr uint8_t kJumpIfLess = 0x8C;
+constexpr uint8_t kJumpIfGreaterOrEqual = 0x8D;
+constexpr uint8_t kJumpIfGreater = 0x8F;
+
+template <typename Cell>
+bool translatable(const Instruction& instr) {
+    constexpr bool f64 = std::is_same_v<Cell, double>;
+    switch (instr.op) {
+        case OpCode::Check: case OpCode::Lit:
+        case OpCode::Add: case OpCode::Sub: case OpCode::Mul:
+        case OpCode::Equals: case OpCode::LessThan: case OpCode::GreaterThan:
+        case OpCode::Not: case OpCode::Dup: case OpCode::Drop: case OpCode::Swap:
+        case OpCode::Over: case OpCode::Rot: case OpCode::TwoDup: case OpCode::Square:
+        case OpCode::AddI: case OpCode::MulI:
+        case OpCode::Fetch: case OpCode::Store: case OpCode::FetchIOffset:
+        case OpCode::CFetch: case OpCode::CStore:
+        case OpCode::LoopI: case OpCode::LoopJ: case OpCode::LoopK:
+        case OpCode::Jump: case OpCode::JumpIfZero:
+        case OpCode::Do: case OpCode::QDo: case OpCode::Loop: case OpCode::PlusLoop: case OpCode::Leave:
+            return true;
+        case OpCode::And: case OpCode::Or:
+            return !f64;
+        default:
+            return false;
+    }
+}
+
+// Decides which instructions of code[begin, end) become native. A DO...LOOP
+// is native only when its whole body is, so the loop registers are never
+// live across a return to the VM; I, J and K need that many native loops
+// around them, and LEAVE one. `fence` marks positions a run must start at, such as inline
+// sites that may later be patched back into calls.
+template <typename Cell>
+std::vector<bool> selectNative(const std::vector<Instruction>& code, size_t begin, size_t end,
+                               const std::vector<bool>& fence) {
+    size_t n = end - begin;
+    std::vector<bool> native(n);
+    // Pairs each loop start with its end and back; n when unpaired.
+    std::vector<size_t> partner(n, n);
+    for (size_t i = 0; i < n; ++i) {
+        const Instruction& instr = code[begin + i];
+        native[i] = translatable<Cell>(instr);
+        if (isLoopStart(instr.op)) {
+            long loop = static_cast<long>(i) + instr.arg - 1;
+            if (loop <= static_cast<long>(i) || loop >= static_cast<long>(n) ||
+                !isLoopEnd(code[begin + loop].op)) {
+                native[i] = false;
+                continue;
+            }
+            partner[i] = static_cast<size_t>(loop);
+            partner[loop] = i;
+        }
+    }
+    for (size_t i = 0; i < n; ++i) {
+        if (isLoopEnd(code[begin + i].op) && (partner[i] == n || !native[partner[i]])) {
+            native[i] = false;
+        }
+    }
+
+    for (bool changed = true; changed;) {
+        changed = false;
+        // How many native loops enclose each instruction.
+        std::vector<int> depth(n, 0);
+        std::vector<size_t> open;
+        for (size_t i = 0; i < n; ++i) {
+            OpCode op = code[begin + i].op;
+            if (isLoopEnd(op) && !open.empty() && open.back() == i) {
+                open.pop_back();
+            }
+            depth[i] = static_cast<int>(open.size());
+            if (isLoopStart(op) && native[i]) {
+                open.push_back(partner[i]);
+            }
+        }
+
+        auto drop = [&](size_t i) {
+            if (native[i]) {
+                native[i] = false;
+                changed = true;
+            }
+        };
+        for (size_t i = 0; i < n; ++i) {
+            OpCode op = code[begin + i].op;
+            int needed = op == OpCode::LoopK ? 3 : op == OpCode::LoopJ ? 2
+                       : (op == OpCode::LoopI || op == OpCode::FetchIOffset || op == OpCode::Leave) ? 1 : 0;
+            if (depth[i] < needed) {
+                drop(i);
+            }
+            if (isLoopStart(op) && native[i]) {
+                for (size_t j = i + 1; j <= partner[i]; ++j) {
+                    if (!native[j] || fence[j]) {
+                        drop(i);
+                        drop(partner[i]);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    return native;
+}
+
+// Called from native stores at or above the store limit.
+template <typename Cell>
+bool writableForJit(const CellMemory<Cell>* memory, size_t begin, size_t count) {
+    return memory->writable(begin, count);
+}
+
+// Translates code[from, to) into one native function that returns where the
+// VM should continue.
+template <typename Cell>
+void translateRun(Assembler& a, const BasicCodeSpace<Cell>& space, size_t from, size_t to,
+                  const CellStack<Cell>& stack, const CellMemory<Cell>& memory) {
+    constexpr bool f64 = std::is_same_v<Cell, double>;
+    auto bits = [](Cell value) {
+        uint64_t raw;
+        std::memcpy(&raw, &value, sizeof(raw));
+        return raw;
+    };
+
+    // Prologue: save callee-saved registers and load the VM registers.
+    a.raw({0x55});                   // push rbp
+    a.raw({0x48, 0x89, 0xE5});       // mov rbp, rsp
+    a.raw({0x53});                   // push rbx
+    a.raw({0x41, 0x54});             // push r12
+    a.raw({0x41, 0x55});             // push r13
+    a.raw({0x41, 0x56});             // push r14
+    a.raw({0x49, 0x89, 0xFE});       // mov r14, rdi
+    a.raw({0x48, 0x8B, 0x1F});       // mov rbx, [rdi]
+    a.raw({0x48, 0x8B, 0x47, 0x08}); // mov rax, [rdi+8]
+    a.raw({0x49, 0xBA});             // mov r10, stack base
+    a.imm64(reinterpret_cast<uint64_t>(stack.base));
+    a.raw({0x49, 0xB8});             // mov r8, memory base
+    a.imm64(reinterpret_cast<uint64_t>(memory.data()));
+    a.raw({0x49, 0xB9});             // mov r9, memory size
+    a.imm64(memory.size());
+    // Only MAP-FILE and UNMAP move the store limit, and they never run
+    // natively, so it holds for the whole run.
+    a.raw({0x49, 0xBB});             // mov r11, &store limit
+    a.imm64(reinterpret_cast<uint64_t>(memory.storeLimitAddress()));
+    a.raw({0x4D, 0x8B, 0x1B});       // mov r11, [r11]
+
+    std::vector<size_t> labels(to - from);
+    std::vector<std::pair<size_t, size_t>> jumps; // (rel32 position, bytecode target)
+    std::vector<std::pair<size_t, int64_t>> errors; // (rel32 position, status)
+    struct Fault {
+        size_t at;
+        int pops;
+        int64_t status = kJitOutOfBounds;
+    };
+    std::vector<Fault> faults; // failed memory access, after popping `pops` cells
+    struct StoreCheck {
+        size_t at;     // the jae past the store limit
+        size_t resume; // the store itself
+        bool bytes;
+    };
+    std::vector<StoreCheck> store_checks; // stores at or above the store limit
+
+    auto jumpTo = [&](size_t at, size_t target) { jumps.emplace_back(at, target); };
+    auto indexFromTos = [&](int pops, bool bytes = false) {
+        // rcx = memory index of the address in rax; faults unless 0 <= addr < size,
+        // counted in cells or, for C@ and C!, in bytes.
+        if constexpr (f64) {
+            a.xmm0FromRax();
+            a.zeroXmm1();
+            a.raw({0x66, 0x0F, 0x2E, 0xC1});       // ucomisd xmm0, xmm1
+            faults.push_back({a.jumpIf(kJumpIfBelow), pops});
+            a.raw({0xF2, 0x48, 0x0F, 0x2C, 0xC8}); // cvttsd2si rcx, xmm0
+        } else {
+            a.movRcxRax();
+        }
+        if (bytes) {
+            a.raw({0x4A, 0x8D, 0x14, 0xCD}); // lea rdx, [r9*8]
+            a.imm32(0);
+            a.raw({0x48, 0x39, 0xD1});       // cmp rcx, rdx
+        } else {
+            a.raw({0x4C, 0x39, 0xC9});       // cmp rcx, r9
+        }
+        faults.push_back({a.jumpIf(kJumpIfAboveOrEqual), pops});
+    };
+    auto checkStore = [&](bool bytes) {
+        // Stores at or above the store limit may be into a read-only file;
+        // the store checks after the run decide those out of line.
+        if (bytes) {
+            a.raw({0x4A, 0x8D, 0x14, 0xDD}); // lea rdx, [r11*8]
+            a.imm32(0);
+            a.raw({0x48, 0x39, 0xD1});       // cmp rcx, rdx
+        } else {
+            a.raw({0x4C, 0x39, 0xD9});       // cmp rcx, r11
+        }
+        size_t at = a.jumpIf(kJumpIfAboveOrEqual);
+        store_checks.push_back({at, a.here(), bytes});
+    };
+    auto loopIndex = [&](int level) {
+        // Pushes the index of the loop `level` levels out as a cell.
+        a.push();
+        if (level == 0) {
+            a.raw({0x4C, 0x89, 0xE1}); // mov rcx, r12
+        } else {
+            // Each outer level is two slots (index above limit) on the native stack.
+            a.raw({0x48, 0x8B, 0x4C, 0x24, static_cast<uint8_t>(16 * level - 8)}); // mov rcx, [rsp+d]
+        }
+        if constexpr (f64) {
+            a.raw({0xF2, 0x48, 0x0F, 0x2A, 0xC1}); // cvtsi2sd xmm0, rcx
+            a.raxFromXmm0();
+        } else {
+            a.movRaxRcx();
+        }
+    };
+    auto binaryF64 = [&](uint8_t op) {
+        a.xmm0FromStack();
+        a.xmm1FromRax();
+        a.raw({0xF2, 0x0F, op, 0xC1}); // op xmm0, xmm1
+        a.raxFromXmm0();
+        a.moveSp(-1);
+    };
+    auto compare = [&](OpCode op) {
+        if constexpr (f64) {
+            a.xmm0FromStack();
+            a.xmm1FromRax();
+            if (op == OpCode::Equals) {
+                a.raw({0x66, 0x0F, 0x2E, 0xC1}); // ucomisd xmm0, xmm1
+                a.raw({0x0F, 0x94, 0xC0});       // sete al
+                a.raw({0x0F, 0x9B, 0xC1});       // setnp cl
+                a.raw({0x20, 0xC8});             // and al, cl
+            } else if (op == OpCode::LessThan) {
+                a.raw({0x66, 0x0F, 0x2E, 0xC8}); // ucomisd xmm1, xmm0
+                a.raw({0x0F, 0x97, 0xC0});       // seta al
+            } else {
+                a.raw({0x66, 0x0F, 0x2E, 0xC1}); // ucomisd xmm0, xmm1
+                a.raw({0x0F, 0x97, 0xC0});       // seta al
+            }
+            a.boolToXmm0();
+        } else {
+            a.raw({0x48, 0x39, 0x43, 0x00}); // cmp [rbx], rax
+            uint8_t set = op == OpCode::Equals ? 0x94 : op == OpCode::LessThan ? 0x9C : 0x9F;
+            a.raw({0x0F, set, 0xC0});        // sete/setl/setg al
+            a.boolToRax();
+        }
+        a.moveSp(-1);
+    };
+
+    for (size_t pc = from; pc < to; ++pc) {
+        labels[pc - from] = a.here();
+        const Instruction& instr = space.code[pc];
+        switch (instr.op) {
+            case OpCode::Check: {
+                int need = checkNeed(instr.arg);
+                int grow = checkGrow(instr.arg);
+                a.raw({0x48, 0x89, 0xD9});       // mov rcx, rbx
+                a.raw({0x4C, 0x29, 0xD1});       // sub rcx, r10
+                a.raw({0x48, 0xC1, 0xF9, 0x03}); // sar rcx, 3  (depth - 2)
+                if (need > 0) {
+                    a.raw({0x48, 0x81, 0xF9});   // cmp rcx, need - 2
+                    a.imm32(need - 2);
+                    errors.emplace_back(a.jumpIf(kJumpIfLess), kJitUnderflow);
+                }
+                if (grow > 0) {
+                    a.raw({0x48, 0x81, 0xF9});   // cmp rcx, capacity - grow - 2
+                    a.imm32(static_cast<int32_t>(stack.capacity()) - grow - 2);
+                    errors.emplace_back(a.jumpIf(kJumpIfGreater), kJitOverflow);
+                }
+                break;
+            }
+            case OpCode::Lit:
+                a.push();
+                a.movRaxImm(bits(space.constants[instr.arg]));
+                break;
+            case OpCode::Add:
+                if constexpr (f64) {
+                    binaryF64(0x58); // addsd
+                } else {
+                    a.raw({0x48, 0x03, 0x43, 0x00}); // add rax, [rbx]
+                    a.moveSp(-1);
+                }
+                break;
+            case OpCode::Sub:
+                if constexpr (f64) {
+                    binaryF64(0x5C); // subsd
+                } else {
+                    a.loadRcx(0);
+                    a.raw({0x48, 0x29, 0xC1}); // sub rcx, rax
+                    a.movRaxRcx();
+                    a.moveSp(-1);
+                }
+                break;
+            case OpCode::Mul:
+                if constexpr (f64) {
+                    binaryF64(0x59); // mulsd
+                } else {
+                    a.raw({0x48, 0x0F, 0xAF, 0x43, 0x00}); // imul rax, [rbx]
+                    a.moveSp(-1);
+                }
+                break;
+            case OpCode::Equals: case OpCode::LessThan: case OpCode::GreaterThan:
+                compare(instr.op);
+                break;
+            case OpCode::And:
+                a.raw({0x48, 0x23, 0x43, 0x00}); // and rax, [rbx]
+                a.moveSp(-1);
+                break;
+            case OpCode::Or:
+                a.raw({0x48, 0x0B, 0x43, 0x00}); // or rax, [rbx]
+                a.moveSp(-1);
+                break;
+            case OpCode::Not:
+                if constexpr (f64) {
+                    a.xmm0FromRax();
+                    a.zeroXmm1();
+                    a.raw({0x66, 0x0F, 0x2E, 0xC1}); // ucomisd xmm0, xmm1
+                    a.raw({0x0F, 0x94, 0xC0});       // sete al
+                    a.raw({0x0F, 0x9B, 0xC1});       // setnp cl
+                    a.raw({0x20, 0xC8});             // and al, cl
+                    a.boolToXmm0();
+                } else {
+                    a.raw({0x48, 0x85, 0xC0});       // test rax, rax
+                    a.raw({0x0F, 0x94, 0xC0});       // sete al
+                    a.boolToRax();
+                }
+                break;
+            case OpCode::Dup:
+                a.push();
+                break;
+            case OpCode::Drop:
+                a.pop();
+                break;
+            case OpCode::Swap:
+                a.loadRcx(0);
+                a.storeTos(0);
+                a.movRaxRcx();
+                break;
+            case OpCode::Over:
+                a.loadRcx(0);
+                a.push();
+                a.movRaxRcx();
+                break;
+            case OpCode::Rot:
+                a.loadRcx(-8);
+                a.loadRdx(0);
+                a.storeRdx(-8);
+                a.storeTos(0);
+                a.movRaxRcx();
+                break;
+            case OpCode::TwoDup:
+                a.loadRcx(0);
+                a.storeTos(8);
+                a.storeRcx(16);
+                a.moveSp(2);
+                break;
+            case OpCode::Square:
+                if constexpr (f64) {
+                    a.xmm0FromRax();
+                    a.raw({0xF2, 0x0F, 0x59, 0xC0}); // mulsd xmm0, xmm0
+                    a.raxFromXmm0();
+                } else {
+                    a.raw({0x48, 0x0F, 0xAF, 0xC0}); // imul rax, rax
+                }
+                break;
+            case OpCode::AddI: case OpCode::MulI:
+                a.movRcxImm(bits(space.constants[instr.arg]));
+                if constexpr (f64) {
+                    a.xmm0FromRax();
+                    a.xmm1FromRcx();
+                    a.raw({0xF2, 0x0F, static_cast<uint8_t>(instr.op == OpCode::AddI ? 0x58 : 0x59), 0xC1});
+                    a.raxFromXmm0();
+                } else if (instr.op == OpCode::AddI) {
+                    a.raw({0x48, 0x01, 0xC8});       // add rax, rcx
+                } else {
+                    a.raw({0x48, 0x0F, 0xAF, 0xC1}); // imul rax, rcx
+                }
+                break;
+            case OpCode::Fetch:
+                indexFromTos(1);
+                a.raw({0x49, 0x8B, 0x04, 0xC8}); // mov rax, [r8+rcx*8]
+                break;
+            case OpCode::Store:
+                indexFromTos(2);
+                checkStore(false);
+                a.raw({0x48, 0x8B, 0x7B, 0x00}); // mov rdi, [rbx]
+                a.raw({0x49, 0x89, 0x3C, 0xC8}); // mov [r8+rcx*8], rdi
+                a.loadTos(-8);
+                a.moveSp(-2);
+                break;
+            case OpCode::CFetch:
+                indexFromTos(1, true);
+                a.raw({0x41, 0x0F, 0xB6, 0x04, 0x08}); // movzx eax, byte [r8+rcx]
+                if constexpr (f64) {
+                    a.raw({0xF2, 0x48, 0x0F, 0x2A, 0xC0}); // cvtsi2sd xmm0, rax
+                    a.raxFromXmm0();
+                }
+                break;
+            case OpCode::CStore:
+                indexFromTos(2, true);
+                checkStore(true);
+                if constexpr (f64) {
+                    a.xmm0FromStack();
+                    a.raw({0xF2, 0x48, 0x0F, 0x2C, 0xF8}); // cvttsd2si rdi, xmm0
+                } else {
+                    a.raw({0x48, 0x8B, 0x7B, 0x00});       // mov rdi, [rbx]
+                }
+                a.raw({0x41, 0x88, 0x3C, 0x08});           // mov [r8+rcx], dil
+                a.loadTos(-8);
+                a.moveSp(-2);
+                break;
+            case OpCode::FetchIOffset:
+                // The address is I + offset, computed in cells like `I lit + @`.
+                a.movRcxImm(bits(space.constants[instr.arg]));
+                if constexpr (f64) {
+                    a.raw({0x66, 0x48, 0x0F, 0x6E, 0xC9}); // movq xmm1, rcx
+                    a.raw({0xF2, 0x49, 0x0F, 0x2A, 0xC4}); // cvtsi2sd xmm0, r12
+                    a.raw({0xF2, 0x0F, 0x58, 0xC1});       // addsd xmm0, xmm1
+                    a.zeroXmm1();
+                    a.raw({0x66, 0x0F, 0x2E, 0xC1});       // ucomisd xmm0, xmm1
+                    faults.push_back({a.jumpIf(kJumpIfBelow), 0});
+                    a.raw({0xF2, 0x48, 0x0F, 0x2C, 0xC8}); // cvttsd2si rcx, xmm0
+                } else {
+                    a.raw({0x4C, 0x01, 0xE1});             // add rcx, r12
+                }
+                a.raw({0x4C, 0x39, 0xC9});                 // cmp rcx, r9
+                faults.push_back({a.jumpIf(kJumpIfAboveOrEqual), 0});
+                a.push();
+                a.raw({0x49, 0x8B, 0x04, 0xC8});           // mov rax, [r8+rcx*8]
+                break;
+            case OpCode::LoopI:
+                loopIndex(0);
+                break;
+            case OpCode::LoopJ:
+                loopIndex(1);
+                break;
+            case OpCode::LoopK:
+                loopIndex(2);
+                break;
+            case OpCode::Jump:
+                jumpTo(a.jump(), pc + instr.arg);
+                break;
+            case OpCode::JumpIfZero:
+                a.movRcxRax();
+                a.pop();
+                if constexpr (f64) {
+                    a.raw({0x48, 0x01, 0xC9}); // add rcx, rcx  (zero for +0.0 and -0.0)
+                } else {
+                    a.raw({0x48, 0x85, 0xC9}); // test rcx, rcx
+                }
+                jumpTo(a.jumpIf(kJumpIfZero), pc + instr.arg);
+                break;
+            case OpCode::Do: case OpCode::QDo:
+                // rcx = start, rdx = limit, both popped.
+                if constexpr (f64) {
+                    a.xmm0FromRax();
+                    a.raw({0xF2, 0x48, 0x0F, 0x2C, 0xC8}); // cvttsd2si rcx, xmm0
+                    a.xmm0FromStack();
+                    a.raw({0xF2, 0x48, 0x0F, 0x2C, 0xD0}); // cvttsd2si rdx, xmm0
+                } else {
+                    a.movRcxRax();
+                    a.loadRdx(0);
+                }
+                a.loadTos(-8);
+                a.moveSp(-2);
+                a.raw({0x48, 0x39, 0xD1});             // cmp rcx, rdx
+                jumpTo(a.jumpIf(instr.op == OpCode::Do ? kJumpIfGreaterOrEqual : kJumpIfZero), pc + instr.arg);
+                a.raw({0x41, 0x54});                   // push r12
+                a.raw({0x41, 0x55});                   // push r13
+                a.raw({0x49, 0x89, 0xCC});             // mov r12, rcx
+                a.raw({0x49, 0x89, 0xD5});             // mov r13, rdx
+                break;
+            case OpCode::Loop:
+                a.raw({0x49, 0xFF, 0xC4});             // inc r12
+                a.raw({0x4D, 0x39, 0xEC});             // cmp r12, r13
+                jumpTo(a.jumpIf(kJumpIfLess), pc + instr.arg);
+                a.raw({0x41, 0x5D});                   // pop r13
+                a.raw({0x41, 0x5C});                   // pop r12
+                break;
+            case OpCode::PlusLoop:
+                // Loops again while index - limit keeps its sign.
+                if constexpr (f64) {
+                    a.xmm0FromRax();
+                    a.raw({0xF2, 0x48, 0x0F, 0x2C, 0xC8}); // cvttsd2si rcx, xmm0
+                } else {
+                    a.movRcxRax();
+                }
+                a.pop();
+                a.raw({0x4C, 0x89, 0xE2});             // mov rdx, r12
+                a.raw({0x4C, 0x29, 0xEA});             // sub rdx, r13
+                a.raw({0x49, 0x01, 0xCC});             // add r12, rcx
+                a.raw({0x48, 0x89, 0xD7});             // mov rdi, rdx
+                a.raw({0x48, 0x01, 0xCF});             // add rdi, rcx
+                a.raw({0x48, 0x31, 0xD7});             // xor rdi, rdx
+                jumpTo(a.jumpIf(kJumpIfNotSign), pc + instr.arg);
+                a.raw({0x41, 0x5D});                   // pop r13
+                a.raw({0x41, 0x5C});                   // pop r12
+                break;
+            case OpCode::Leave:
+                a.raw({0x41, 0x5D});                   // pop r13
+                a.raw({0x41, 0x5C});                   // pop r12
+                jumpTo(a.jump(), pc + instr.arg);
+                break;
+            default:
+                throw std::logic_error(std::string("JIT cannot translate ") + opcodeName(instr.op));
+        }
+    }
+
+    // Leaving the run: write the VM registers back and return `result`.
+    auto exitWith = [&](int64_t result) {
+        a.raw({0x49, 0x89, 0x1E});       // mov [r14], rbx
+        a.raw({0x49, 0x89, 0x46, 0x08}); // mov [r14+8], rax
+        a.movRaxImm(static_cast<uint64_t>(result));
+        a.raw({0x48, 0x8D, 0x65, 0xE0}); // lea rsp, [rbp-32]
+        a.raw({0x41, 0x5E});             // pop r14
+        a.raw({0x41, 0x5D});             // pop r13
+        a.raw({0x41, 0x5C});             // pop r12
+        a.raw({0x5B});                   // pop rbx
+        a.raw({0x5D});                   // pop rbp
+        a.raw({0xC3});                   // ret
+    };
+
+    // Falling off the end continues with the instruction after the run.
+    std::map<size_t, size_t> exits;
+    exits[to] = a.here();
+    exitWith(static_cast<int64_t>(to));
+
+    for (const auto& [at, target] : jumps) {
+        if (target >= from && target < to) {
+            a.patch(at, labels[target - from]);
+            continue;
+        }
+        auto exit = exits.find(target);
+        if (exit == exits.end()) {
+            exit = exits.emplace(target, a.here()).first;
+            exitWith(static_cast<int64_t>(target));
+        }
+        a.patch(at, exit->second);
+    }
+    for (const auto& [at, status] : errors) {
+        a.patch(at, a.here());
+        exitWith(status);
+    }
+    for (const StoreCheck& check : store_checks) {
+        // Asks the memory whether the cell or byte at rcx is writable, with
+        // every live caller-saved register kept; six pushes keep rsp aligned.
+        a.patch(check.at, a.here());
+        a.raw({0x50, 0x51, 0x41, 0x50, 0x41, 0x51, 0x41, 0x52, 0x41, 0x53}); // push rax, rcx, r8-r11
+        a.raw({0x48, 0xBF});                   // mov rdi, &memory
+        a.imm64(reinterpret_cast<uint64_t>(&memory));
+        a.raw({0x48, 0x89, 0xCE});             // mov rsi, rcx
+        if (!check.bytes) {
+            a.raw({0x48, 0xC1, 0xE6, 0x03});   // shl rsi, 3
+        }
+        a.raw({0xBA});                         // mov edx, width
+        a.imm32(check.bytes ? 1 : static_cast<int32_t>(sizeof(Cell)));
+        a.movRaxImm(reinterpret_cast<uint64_t>(&writableForJit<Cell>));
+        a.raw({0xFF, 0xD0});                   // call rax
+        a.raw({0x84, 0xC0});                   // test al, al
+        a.raw({0x41, 0x5B, 0x41, 0x5A, 0x41, 0x59, 0x41, 0x58, 0x59, 0x58}); // pop r11-r8, rcx, rax
+        faults.push_back({a.jumpIf(kJumpIfZero), 2, kJitReadOnly});
+        a.patch(a.jump(), check.resume);
+    }
+    for (const Fault& fault : faults) {
+        // Like the VM, a failed access has already consumed its operands.
+        a.patch(fault.at, a.here());
+        if (fault.pops > 0) {
+            a.loadTos(static_cast<int8_t>(-8 * (fault.pops - 1)));
+            a.moveSp(static_cast<int8_t>(-fault.pops));
+        }
+        exitWith(fault.status);
+    }
+}
+
+} // namespace
+#endif
+
+template <typename Cell>
+BasicJit<Cell>::BasicJit(const CellStack<Cell>& stack, const CellMemory<Cell>& memory)
+    : stack(stack), memory(memory) {}
+
+template <typename Cell>
+BasicJit<Cell>::~BasicJit() {
+#if PELI_JIT_AVAILABLE
+    for (const Chunk& chunk : chunks) {
+        munmap(chunk.pages, chunk.size);
+    }
+#endif
+}
+
+template <typename Cell>
+void BasicJit<Cell>::compile(BasicCodeSpace<Cell>& space, size_t begin, size_t end) {
+#if PELI_JIT_AVAILABLE
+    if constexpr (supported) {
+        if (begin >= end) {
+            return;
+        }
+
+        // Inline sites can be patched back into a Call at any time, so a run
+        // may only start at one, never contain it. Their ends are fenced
+        // too, so the patched-in Jump lands on a run again.
+        std::vector<bool> fence(end - begin, false);
+        for (const InlineSite& site : space.inline_sites) {
+            if (site.begin >= begin && site.begin < end) {
+                fence[site.begin - begin] = true;
+            }
+            if (site.end >= begin && site.end < end) {
+                fence[site.end - begin] = true;
+            }
+        }
+
+        std::vector<bool> native = selectNative<Cell>(space.code, begin, end, fence);
+
+        // Short runs cost more to enter and leave than they save.
+        const size_t minimumRun = 3;
+
+        Assembler a;
+        std::vector<std::pair<size_t, size_t>> found; // (bytecode start, native offset)
+        size_t i = begin;
+        while (i < end) {
+            if (!native[i - begin]) {
+                ++i;
+                continue;
+            }
+            size_t start = i++;
+            bool loops = isLoopStart(space.code[start].op);
+            while (i < end && native[i - begin] && !fence[i - begin]) {
+                loops = loops || isLoopStart(space.code[i].op);
+                ++i;
+            }
+            if (i - start < minimumRun && !loops) {
+                continue;
+            }
+            found.emplace_back(start, a.here());
+            translateRun<Cell>(a, space, start, i, stack, memory);
+        }
+        if (found.empty()) {
+            return;
+        }
+
+        long page = sysconf(_SC_PAGESIZE);
+        size_t size = (a.code.size() + page - 1) / page * page;
+        void* pages = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (pages == MAP_FAILED) {
+            return;
+        }
+        std::memcpy(pages, a.code.data(), a.code.size());
+        if (mprotect(pages, size, PROT_READ | PROT_EXEC) != 0) {
+            munmap(pages, size);
+            return;
+        }
+        chunks.push_back({pages, size, begin});
+
+        for (const auto& [start, offset] : found) {
+            space.displaced[start] = space.code[start];
+            space.code[start] = {OpCode::Native, static_cast<int32_t>(runs.size())};
+            runs.push_back({start, reinterpret_cast<Entry>(static_cast<uint8_t*>(pages) + offset)});
+        }
+    }
+#else
+    (void)space;
+    (void)begin;
+    (void)end;
+#endif
+}
+
+template <typename Cell>
+void BasicJit<Cell>::release(BasicCodeSpace<Cell>& space, size_t mark) {
+    while (!runs.empty() && runs.back().begin >= mark) {
+        space.displaced.erase(runs.back().begin);
+        runs.pop_back();
+    }
+#if PELI_JIT_AVAILABLE
+    while (!chunks.empty() && chunks.back().begin >= mark) {
+        munmap(chunks.back().pages, chunks.back().size);
+        chunks.pop_back();
+    }
+#endif
+}
+
+#define PELI_INSTANTIATE_JIT(Cell) template class BasicJit<Cell>;
+PELI_CELL_TYPES(PELI_INSTANTIATE_JIT)
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "Bytecode.hpp"
+#include "Memory.hpp"
+#include "Stack.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+// The JIT emits x86-64 machine code into mmap'd pages, so it is only built
+// for Linux on x86-64. Elsewhere compile() leaves the bytecode untouched.
+#if defined(__x86_64__) && defined(__linux__)
+#define PELI_JIT_AVAILABLE 1
+#else
+#define PELI_JIT_AVAILABLE 0
+#endif
+
+// The VM registers a native run reads on entry and writes back on exit.
+template <typename Cell>
+struct JitState {
+    Cell* sp;
+    Cell tos;
+};
+
+// Negative results of a native run, in place of the bytecode position the VM
+// resumes at. The run leaves the stack as the VM would have at the error.
+enum JitStatus : int64_t {
+    kJitUnderflow = -1,
+    kJitOverflow = -2,
+    kJitOutOfBounds = -3,
+    kJitReadOnly = -4,
+};
+
+const char* jitStatusMessage(int64_t status);
+
+// A template JIT for f64 and i64 cells. Each region handed to compile() is
+// split into runs of instructions it can translate: stack shuffles,
+// arithmetic, comparisons, memory access, IF branches and DO...LOOPs whose
+// whole body is native. The top of the stack stays in a register, IF turns
+// into a compare-and-branch and a native loop keeps its index and limit in
+// registers. Everything else (calls, I/O, the return stack, division) is
+// left to the VM: a run ends before it and the VM carries on from there.
+//
+// The first instruction of a run is replaced by a Native instruction that
+// enters it; the original is kept in the code space's `displaced` table.
+template <typename Cell>
+class BasicJit {
+public:
+    static constexpr bool supported =
+        PELI_JIT_AVAILABLE && (std::is_same_v<Cell, double> || std::is_same_v<Cell, int64_t>);
+
+    BasicJit(const CellStack<Cell>& stack, const CellMemory<Cell>& memory);
+    ~BasicJit();
+    BasicJit(const BasicJit&) = delete;
+    BasicJit& operator=(const BasicJit&) = delete;
+
+    // Translates the runs found in code[begin, end) of `space`.
+    void compile(BasicCodeSpace<Cell>& space, size_t begin, size_t end);
+    // Drops the runs at or after `mark`, when the code behind them is discarded.
+    void release(BasicCodeSpace<Cell>& space, size_t mark);
+
+    // Runs native run `run`; returns where the VM resumes or a JitStatus.
+    int64_t enter(int32_t run, JitState<Cell>& state) const { return runs[run].entry(&state); }
+    size_t runCount() const { return runs.size(); }
+
+private:
+    using Entry = int64_t (*)(JitState<Cell>*);
+
+    struct Run {
+        size_t begin;
+        Entry entry;
+    };
+
+    struct Chunk {
+        void* pages;
+        size_t size;
+        size_t begin;
+    };
+
+    const CellStack<Cell>& stack;
+    const CellMemory<Cell>& memory;
+    std::vector<Run> runs;
+    std::vector<Chunk> chunks;
+};
+
+#define PELI_DECLARE_JIT(Cell) extern template class BasicJit<Cell>;
+PELI_CELL_TYPES(PELI_DECLARE_JIT)
+#undef PELI_DECLARE_JIT
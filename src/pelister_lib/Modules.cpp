@@ -0,0 +1,62 @@
+#include "Modules.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "SourceFile.hpp"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+std::string resolveModule(const std::filesystem::path& directory, std::string_view name) {
+    std::filesystem::path path(name);
+    if (path.is_relative()) {
+        path = directory / path;
+    }
+    std::error_code error;
+    std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+    return (error ? path.lexically_normal() : canonical).string();
+}
+
+std::vector<Ast> parseModules(const std::vector<std::string>& paths) {
+    std::vector<std::optional<Ast>> trees(paths.size());
+    std::vector<std::string> errors(paths.size());
+    std::atomic<size_t> next{0};
+
+    // Workers claim files one at a time, so a large module does not hold
+    // up the small ones queued behind it.
+    auto work = [&]() {
+        for (size_t i = next++; i < paths.size(); i = next++) {
+            try {
+                SourceFile source(paths[i]);
+                Lexer lexer(source.text());
+                Parser parser(lexer);
+                trees[i] = parser.parse();
+            } catch (const std::exception& e) {
+                errors[i] = e.what();
+            }
+        }
+    };
+
+    size_t threads = std::min<size_t>(paths.size(), std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < threads; ++i) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    std::vector<Ast> result;
+    result.reserve(paths.size());
+    for (size_t i = 0; i < paths.size(); ++i) {
+        if (!trees[i]) {
+            throw std::runtime_error("In module '" + paths[i] + "': " + errors[i]);
+        }
+        result.push_back(std::move(*trees[i]));
+    }
+    return result;
+}
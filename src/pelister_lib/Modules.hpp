@@ -0,0 +1,18 @@
+#pragma once
+
+#include "ast.hpp"
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The file an INCLUDE or REQUIRE names: relative names are looked up in
+// `directory`, the directory of the file that names them. Each file has a
+// single name, so two spellings of one path load the same module.
+std::string resolveModule(const std::filesystem::path& directory, std::string_view name);
+
+// Reads and parses the files at `paths`, several at a time on worker
+// threads when there is more than one. The trees come back in the order of
+// `paths`; if any file fails to load, the error of the first one in that
+// order is thrown, as std::runtime_error naming the file.
+std::vector<Ast> parseModules(const std::vector<std::string>& paths);
@@ -0,0 +1,210 @@
+#include "Optimizer.hpp"
+#include "CodeRewriter.hpp"
+
+namespace {
+
+// Evaluates a binary primitive on two constants exactly as the VM would;
+// false for operations that would raise an error at run time instead.
+template <typename Cell>
+bool foldBinary(OpCode op, Cell a, Cell b, Cell& out) {
+    switch (op) {
+        case OpCode::Add: out = cellAdd(a, b); return true;
+        case OpCode::Sub: out = cellSub(a, b); return true;
+        case OpCode::Mul: out = cellMul(a, b); return true;
+        case OpCode::Div:
+            if (b == 0) return false;
+            out = cellDiv(a, b); return true;
+        case OpCode::Mod:
+            if (b == 0) return false;
+            out = cellMod(a, b); return true;
+        case OpCode::Equals: out = a == b ? 1 : 0; return true;
+        case OpCode::LessThan: out = a < b ? 1 : 0; return true;
+        case OpCode::GreaterThan: out = a > b ? 1 : 0; return true;
+        case OpCode::And: out = cellAnd(a, b); return true;
+        case OpCode::Or: out = cellOr(a, b); return true;
+        default: return false;
+    }
+}
+
+// Rewrites the straight-line body of one basic block. Instructions are
+// shifted onto `out` one at a time and the tail is reduced after each, so a
+// rewrite can feed the next one (`10 DUP *` folds to `10 10 *`, then `100`).
+template <typename Cell>
+class PeepholeOptimizer {
+public:
+    PeepholeOptimizer(std::vector<Cell>& constants, const OptimizerOptions& options, const std::string& where)
+        : constants(constants), options(options), where(where) {}
+
+    void shift(Instruction instr) {
+        out.push_back(instr);
+        while (reduce()) {
+        }
+    }
+
+    std::vector<Instruction> take() { return std::move(out); }
+
+private:
+    bool tail(std::initializer_list<OpCode> ops) const {
+        if (out.size() < ops.size()) {
+            return false;
+        }
+        size_t i = out.size() - ops.size();
+        for (OpCode op : ops) {
+            if (out[i++].op != op) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const Instruction& back(size_t n) const { return out[out.size() - 1 - n]; }
+    Cell constant(size_t n) const { return constants[back(n).arg]; }
+
+    int32_t addConstant(Cell value) {
+        constants.push_back(value);
+        return static_cast<int32_t>(constants.size() - 1);
+    }
+
+    // Drops the last `count` instructions and appends `replacement`.
+    bool rewrite(const char* rule, size_t count, std::initializer_list<Instruction> replacement) {
+        out.resize(out.size() - count);
+        out.insert(out.end(), replacement);
+        if (options.log) {
+            *options.log << where << ": " << rule << "\n";
+        }
+        return true;
+    }
+
+    bool reduce() {
+        if (out.empty()) {
+            return false;
+        }
+        OpCode last = back(0).op;
+
+        if (out.size() >= 3 && back(1).op == OpCode::Lit && back(2).op == OpCode::Lit) {
+            Cell value;
+            if (foldBinary(last, constant(2), constant(1), value)) {
+                return rewrite("lit lit op => Lit", 3, {{OpCode::Lit, addConstant(value)}});
+            }
+            if (last == OpCode::Swap) {
+                Instruction a = back(2), b = back(1);
+                return rewrite("lit lit SWAP => Lit Lit", 3, {b, a});
+            }
+        }
+        if (out.size() >= 2 && back(1).op == OpCode::Lit) {
+            Instruction lit = back(1);
+            switch (last) {
+                case OpCode::Not:
+                    return rewrite("lit NOT => Lit", 2, {{OpCode::Lit, addConstant(constant(1) == 0 ? 1 : 0)}});
+                case OpCode::Dup:
+                    return rewrite("lit DUP => Lit Lit", 2, {lit, lit});
+                case OpCode::Drop:
+                    return rewrite("lit DROP => (nothing)", 2, {});
+                default:
+                    break;
+            }
+        }
+
+        if (options.level < 2) {
+            return false;
+        }
+
+        if (tail({OpCode::Over, OpCode::Over})) {
+            return rewrite("OVER OVER => TwoDup", 2, {{OpCode::TwoDup, 0}});
+        }
+        if (tail({OpCode::Dup, OpCode::Mul})) {
+            return rewrite("DUP * => Square", 2, {{OpCode::Square, 0}});
+        }
+        if (tail({OpCode::Lit, OpCode::LoopI, OpCode::Add})) {
+            // Addition commutes exactly, for floats as well as wrapping integers.
+            int32_t offset = back(2).arg;
+            return rewrite("lit I + => LoopI AddI", 3, {{OpCode::LoopI, 0}, {OpCode::AddI, offset}});
+        }
+        if (tail({OpCode::Lit, OpCode::Add})) {
+            return rewrite("lit + => AddI", 2, {{OpCode::AddI, back(1).arg}});
+        }
+        if (tail({OpCode::Lit, OpCode::Sub})) {
+            // a - c and a + (-c) agree bit for bit: integers wrap alike, and
+            // IEEE subtraction is addition of the negated operand. For
+            // floats, -c must be a true negation; 0 - c would turn a 0
+            // literal into +0.0, and -0.0 + +0.0 is +0.0, not -0.0.
+            Cell negated;
+            if constexpr (cellIsInteger<Cell>) {
+                negated = cellSub<Cell>(0, constant(1));
+            } else {
+                negated = -constant(1);
+            }
+            return rewrite("lit - => AddI", 2, {{OpCode::AddI, addConstant(negated)}});
+        }
+        if (tail({OpCode::Lit, OpCode::Mul})) {
+            return rewrite("lit * => MulI", 2, {{OpCode::MulI, back(1).arg}});
+        }
+        if constexpr (cellIsInteger<Cell>) {
+            // Only wrapping integer addition is associative.
+            if (tail({OpCode::AddI, OpCode::AddI})) {
+                Cell sum = cellAdd(constant(1), constant(0));
+                return rewrite("AddI AddI => AddI", 2, {{OpCode::AddI, addConstant(sum)}});
+            }
+        }
+        if (tail({OpCode::LoopI, OpCode::AddI, OpCode::Fetch})) {
+            return rewrite("I lit + @ => FetchIOffset", 3, {{OpCode::FetchIOffset, back(1).arg}});
+        }
+        return false;
+    }
+
+    std::vector<Cell>& constants;
+    const OptimizerOptions& options;
+    const std::string& where;
+    std::vector<Instruction> out;
+};
+
+} // namespace
+
+template <typename Cell>
+std::vector<Instruction> optimizeRegion(const std::vector<Instruction>& code, std::vector<Cell>& constants,
+                                        std::vector<size_t>& entries, const OptimizerOptions& options,
+                                        const std::string& where) {
+    if (options.level <= 0) {
+        return code;
+    }
+
+    std::vector<bool> leaders = findLeaders(code);
+    CodeRewriter rewriter(code);
+
+    size_t i = 0;
+    while (i < code.size()) {
+        // Only block starts can be jumped to or entered, so the instructions
+        // inside a block are free to be folded into one another. A jump
+        // always ends its block.
+        rewriter.begin(i);
+        PeepholeOptimizer<Cell> peephole(constants, options, where);
+        size_t jump = code.size();
+        do {
+            if (isJump(code[i].op)) {
+                jump = i++;
+                break;
+            }
+            peephole.shift(code[i]);
+            ++i;
+        } while (i < code.size() && !leaders[i]);
+
+        for (const Instruction& instr : peephole.take()) {
+            rewriter.emit(instr);
+        }
+        if (jump < code.size()) {
+            rewriter.emitSourceJump(code[jump], jump);
+        }
+    }
+
+    std::vector<Instruction> result = rewriter.finish();
+    for (size_t& entry : entries) {
+        entry = rewriter.map(entry);
+    }
+    return result;
+}
+
+#define PELI_INSTANTIATE_OPTIMIZER(Cell)                                                              \
+    template std::vector<Instruction> optimizeRegion<Cell>(const std::vector<Instruction>&,          \
+                                                           std::vector<Cell>&, std::vector<size_t>&, \
+                                                           const OptimizerOptions&, const std::string&);
+PELI_CELL_TYPES(PELI_INSTANTIATE_OPTIMIZER)
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Bytecode.hpp"
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// How hard the compiler works on a region before it is checked and appended.
+//   0: emit the straight lowering of the AST.
+//   1: fold constant subexpressions (`10 DUP * 3.14159 *` becomes one Lit).
+//   2: also fuse common sequences into superinstructions (`OVER OVER` into
+//      TwoDup, `lit +` into AddI, `I lit + @` into FetchIOffset, ...).
+//   3: also inline calls to small words and turn a word's last call into a
+//      TailCall that reuses the caller's frame.
+// Every rewrite that fires is reported to `log`, when set.
+struct OptimizerOptions {
+    int level = 0;
+    std::ostream* log = nullptr;
+};
+
+constexpr int kMaxOptLevel = 3;
+
+// The longest body, in instructions, that is copied into its callers.
+constexpr size_t kInlineLimit = 12;
+
+// Rewrites `code` one basic block at a time, so no rewrite ever spans a jump
+// target. Folded constants are appended to `constants`; `entries` holds
+// region-local entry points that are remapped in place. `where` names the
+// region in the log.
+template <typename Cell>
+std::vector<Instruction> optimizeRegion(const std::vector<Instruction>& code, std::vector<Cell>& constants,
+                                        std::vector<size_t>& entries, const OptimizerOptions& options,
+                                        const std::string& where);
+
+#define PELI_DECLARE_OPTIMIZER(Cell)                                                                         \
+    extern template std::vector<Instruction> optimizeRegion<Cell>(const std::vector<Instruction>&,          \
+                                                                  std::vector<Cell>&, std::vector<size_t>&, \
+                                                                  const OptimizerOptions&, const std::string&);
+PELI_CELL_TYPES(PELI_DECLARE_OPTIMIZER)
+#undef PELI_DECLARE_OPTIMIZER
@@ -0,0 +1,53 @@
+#include "SourceFile.hpp"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#if PELI_MMAP_AVAILABLE
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+SourceFile::SourceFile(const std::string& path) {
+#if PELI_MMAP_AVAILABLE
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open file '" + path + "'");
+    }
+    struct stat info;
+    // Empty files cannot be mapped, and pipes or devices have no size to
+    // map; both are read the ordinary way below.
+    if (::fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        void* view = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view != MAP_FAILED) {
+            data = static_cast<const char*>(view);
+            size = static_cast<size_t>(info.st_size);
+            mapped = true;
+        }
+    }
+    ::close(fd);
+    if (mapped) {
+        return;
+    }
+#endif
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open file '" + path + "'");
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    contents = buffer.str();
+    data = contents.data();
+    size = contents.size();
+}
+
+SourceFile::~SourceFile() {
+#if PELI_MMAP_AVAILABLE
+    if (mapped) {
+        ::munmap(const_cast<char*>(data), size);
+    }
+#endif
+}
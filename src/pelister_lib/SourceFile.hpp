@@ -0,0 +1,27 @@
+#pragma once
+
+#include "Memory.hpp"
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// A program file held in memory for the lexer to slice. Where the platform
+// allows, the file is mapped read-only rather than copied, so the source is
+// never duplicated on the way to its tokens.
+class SourceFile {
+public:
+    // Throws std::runtime_error when the file cannot be opened or read.
+    explicit SourceFile(const std::string& path);
+    ~SourceFile();
+    SourceFile(const SourceFile&) = delete;
+    SourceFile& operator=(const SourceFile&) = delete;
+
+    std::string_view text() const { return {data, size}; }
+
+private:
+    const char* data = "";
+    size_t size = 0;
+    bool mapped = false;
+    // Holds the contents when the file could not be mapped.
+    std::string contents;
+};
@@ -0,0 +1,212 @@
+#include "Symbols.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// Names are looked up far more often than they are added, and from any
+// thread, so lookups take no lock. Each name is stored once, as a record of
+// its length and then its bytes, which never moves; the records are listed
+// by Symbol in segments that never move either: segment k holds 2^(k +
+// kFirstBits) of them, starting at Symbol 2^(k + kFirstBits) -
+// 2^kFirstBits. Whoever holds a Symbol got it from a lookup that saw it
+// published, so its segment is in place.
+constexpr int kFirstBits = 8;
+constexpr int kSegments = 32 - kFirstBits;
+
+// Names are a few bytes long, so they are hashed a word at a time, without
+// the set-up hashBytes spends on long texts.
+uint64_t hashName(std::string_view name) {
+    constexpr uint64_t k0 = 0x9E3779B97F4A7C15ull;
+    constexpr uint64_t k1 = 0xC2B2AE3D27D4EB4Full;
+    uint64_t hash = (name.size() + 1) * k0;
+    const char* p = name.data();
+    size_t left = name.size();
+    for (; left >= 8; p += 8, left -= 8) {
+        uint64_t word;
+        std::memcpy(&word, p, sizeof(word));
+        hash = (hash ^ word) * k1;
+        hash ^= hash >> 29;
+    }
+    if (left > 0) {
+        uint64_t word = 0;
+        std::memcpy(&word, p, left);
+        hash = (hash ^ word) * k1;
+    }
+    hash ^= hash >> 32;
+    hash *= k0;
+    return hash ^ (hash >> 29);
+}
+
+class SymbolTable {
+public:
+    SymbolTable() { index.store(newIndex(1024), std::memory_order_relaxed); }
+
+    Symbol intern(std::string_view name) {
+        uint64_t hash = hashName(name);
+        Symbol symbol = find(name, hash);
+        if (symbol != kNoSymbol) {
+            return symbol;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        symbol = find(name, hash);
+        if (symbol != kNoSymbol) {
+            return symbol;
+        }
+        symbol = static_cast<Symbol>(count.load(std::memory_order_relaxed));
+        if (symbol == kNoSymbol - 1) {
+            throw std::runtime_error("Too many distinct word names");
+        }
+        auto [segment, offset] = locate(symbol);
+        if (!segments[segment]) {
+            segments[segment] = std::make_unique<const char*[]>(size_t{1} << (segment + kFirstBits));
+        }
+        const char* record = store(name);
+        segments[segment][offset] = record;
+
+        Index* current = index.load(std::memory_order_relaxed);
+        if ((static_cast<size_t>(symbol) + 1) * 2 > current->mask + 1) {
+            current = grow(*current, symbol);
+        }
+        insert(*current, hash, symbol, record);
+        count.store(symbol + 1, std::memory_order_release);
+        return symbol;
+    }
+
+    Symbol find(std::string_view name) const { return find(name, hashName(name)); }
+
+    std::string_view name(Symbol symbol) const {
+        auto [segment, offset] = locate(symbol);
+        return text(segments[segment][offset]);
+    }
+
+    size_t size() const { return count.load(std::memory_order_acquire); }
+
+private:
+    // An open-addressed hash index. A slot's key holds the top half of a
+    // name's hash above its Symbol plus one, or zero when empty, and is
+    // published with release order after the slot's record.
+    struct Slot {
+        std::atomic<uint64_t> key{0};
+        std::atomic<const char*> record{nullptr};
+    };
+    struct Index {
+        size_t mask;
+        std::unique_ptr<Slot[]> slots;
+    };
+
+    static std::string_view text(const char* record) {
+        uint32_t length;
+        std::memcpy(&length, record, sizeof(length));
+        return {record + sizeof(length), length};
+    }
+
+    Symbol find(std::string_view name, uint64_t hash) const {
+        const Index* current = index.load(std::memory_order_acquire);
+        uint32_t tag = static_cast<uint32_t>(hash >> 32);
+        for (size_t i = hash & current->mask;; i = (i + 1) & current->mask) {
+            const Slot& slot = current->slots[i];
+            uint64_t key = slot.key.load(std::memory_order_acquire);
+            if (key == 0) {
+                return kNoSymbol;
+            }
+            if (static_cast<uint32_t>(key >> 32) == tag && text(slot.record.load(std::memory_order_relaxed)) == name) {
+                return static_cast<Symbol>(key) - 1;
+            }
+        }
+    }
+
+    static void insert(Index& target, uint64_t hash, Symbol symbol, const char* record) {
+        size_t i = hash & target.mask;
+        while (target.slots[i].key.load(std::memory_order_relaxed) != 0) {
+            i = (i + 1) & target.mask;
+        }
+        target.slots[i].record.store(record, std::memory_order_relaxed);
+        target.slots[i].key.store((hash >> 32 << 32) | (static_cast<uint64_t>(symbol) + 1),
+                                  std::memory_order_release);
+    }
+
+    Index* newIndex(size_t size) {
+        auto created = std::make_unique<Index>();
+        created->mask = size - 1;
+        created->slots = std::make_unique<Slot[]>(size);
+        indices.push_back(std::move(created));
+        return indices.back().get();
+    }
+
+    // Lookups may still be reading the old index, so it is kept; they miss
+    // what is added from now on, and take the lock to add it again.
+    Index* grow(const Index& old, Symbol symbols) {
+        Index* bigger = newIndex((old.mask + 1) * 2);
+        for (Symbol symbol = 0; symbol < symbols; ++symbol) {
+            auto [segment, offset] = locate(symbol);
+            const char* record = segments[segment][offset];
+            insert(*bigger, hashName(text(record)), symbol, record);
+        }
+        index.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+
+    static std::pair<int, size_t> locate(Symbol symbol) {
+        uint64_t biased = static_cast<uint64_t>(symbol) + (1u << kFirstBits);
+        int segment = 63 - __builtin_clzll(biased) - kFirstBits;
+        return {segment, static_cast<size_t>(biased - (uint64_t{1} << (segment + kFirstBits)))};
+    }
+
+    const char* store(std::string_view name) {
+        uint32_t length = static_cast<uint32_t>(name.size());
+        size_t needed = sizeof(length) + name.size();
+        if (needed > chunk_left) {
+            size_t size = std::max<size_t>(needed, 16384);
+            chunks.push_back(std::make_unique<char[]>(size));
+            chunk_next = chunks.back().get();
+            chunk_left = size;
+        }
+        const char* record = chunk_next;
+        std::memcpy(chunk_next, &length, sizeof(length));
+        std::memcpy(chunk_next + sizeof(length), name.data(), name.size());
+        chunk_next += needed;
+        chunk_left -= needed;
+        return record;
+    }
+
+    std::mutex mutex;
+    std::atomic<Index*> index;
+    std::vector<std::unique_ptr<Index>> indices;
+    std::unique_ptr<const char*[]> segments[kSegments];
+    std::atomic<size_t> count{0};
+    std::vector<std::unique_ptr<char[]>> chunks;
+    char* chunk_next = nullptr;
+    size_t chunk_left = 0;
+};
+
+// Never destroyed, so names stay valid in static destructors and threads
+// that outlive main.
+SymbolTable& table() {
+    static SymbolTable* symbols = new SymbolTable;
+    return *symbols;
+}
+
+} // namespace
+
+Symbol internSymbol(std::string_view name) {
+    return table().intern(name);
+}
+
+Symbol findSymbol(std::string_view name) {
+    return table().find(name);
+}
+
+std::string_view symbolName(Symbol symbol) {
+    return table().name(symbol);
+}
+
+size_t symbolCount() {
+    return table().size();
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string_view>
+
+// The names of words, interned once for the whole process: equal names get
+// the same Symbol, so trees and dictionaries store, compare and hash names
+// as integers and keep a single copy of each. Interning is thread-safe, as
+// modules are lexed side by side, and looking a name up takes no lock. A
+// name lives as long as the process.
+using Symbol = uint32_t;
+
+// Stands for no name at all, such as on a ." token.
+constexpr Symbol kNoSymbol = std::numeric_limits<Symbol>::max();
+
+Symbol internSymbol(std::string_view name);
+// The Symbol of `name`, or kNoSymbol when it was never interned.
+Symbol findSymbol(std::string_view name);
+std::string_view symbolName(Symbol symbol);
+// Symbols handed out so far; every one is below this.
+size_t symbolCount();
@@ -0,0 +1,534 @@
+#include "Interpreter.hpp"
+#include <stdexcept>
+#include <iostream>
+#include <cmath>
+
+// GCC and Clang support labels-as-values, which lets every handler jump
+// straight to the next one instead of going back through a central switch.
+#if defined(__GNUC__) || defined(__clang__)
+#define PELI_THREADED_DISPATCH 1
+#else
+#define PELI_THREADED_DISPATCH 0
+#endif
+
+#if PELI_THREADED_DISPATCH
+#define VM_CASE(name) op_##name:
+#define VM_DISPATCH() goto *dispatch_table[static_cast<size_t>(ip->op)]
+#else
+#define VM_CASE(name) case OpCode::name:
+#define VM_DISPATCH() continue
+#endif
+#define VM_NEXT() { ++ip; VM_DISPATCH(); }
+#define VM_JUMP(offset) { ip += (offset); VM_DISPATCH(); }
+
+// The top of the data stack lives in `tos`; `sp` points at the cell below it.
+// Depth is only checked by the Check that starts each basic block, so these
+// never test for underflow or overflow themselves.
+#define VM_PUSH(value) { *++sp = tos; tos = (value); }
+#define VM_POP(dest) { dest = tos; tos = *sp--; }
+// Writes the cached registers back so the stack is consistent for anything
+// outside the loop that looks at it.
+#define VM_SYNC() { sp[1] = tos; stack.top = sp + 1; }
+#define VM_ERROR(message) { VM_SYNC(); throw std::runtime_error(message); }
+
+template <typename Cell>
+void BasicInterpreter<Cell>::execute(size_t entry) {
+    const Instruction* const code = code_space.code.data();
+    const Cell* const constants = code_space.constants.data();
+    const size_t* const entries = code_space.dictionary.entryTable();
+    const Instruction* ip = code + entry;
+
+    Cell* const base = stack.base;
+    const ptrdiff_t capacity = static_cast<ptrdiff_t>(stack.capacity());
+    Cell* sp = stack.top - 1;
+    Cell tos = *stack.top;
+
+    call_frames.clear();
+    loop_frames.clear();
+
+#if PELI_THREADED_DISPATCH
+    static void* const dispatch_table[] = {
+#define PELI_OPCODE_LABEL(name) &&op_##name,
+        PELI_OPCODES(PELI_OPCODE_LABEL)
+#undef PELI_OPCODE_LABEL
+    };
+    VM_DISPATCH();
+#else
+    for (;;) switch (ip->op) {
+#endif
+
+    VM_CASE(Check) {
+        ptrdiff_t depth = sp - base + 2;
+        if (depth < checkNeed(ip->arg)) VM_ERROR("Stack underflow");
+        if (depth + checkGrow(ip->arg) > capacity) VM_ERROR("Stack overflow");
+        VM_NEXT();
+    }
+    VM_CASE(Lit) {
+        VM_PUSH(constants[ip->arg]);
+        VM_NEXT();
+    }
+    VM_CASE(Add) {
+        tos = cellAdd(*sp--, tos);
+        VM_NEXT();
+    }
+    VM_CASE(Sub) {
+        tos = cellSub(*sp--, tos);
+        VM_NEXT();
+    }
+    VM_CASE(Mul) {
+        tos = cellMul(*sp--, tos);
+        VM_NEXT();
+    }
+    VM_CASE(Div) {
+        Cell b; VM_POP(b);
+        if (b == 0) {
+            tos = *sp--;
+            VM_ERROR("Division by zero");
+        }
+        tos = cellDiv(tos, b);
+        VM_NEXT();
+    }
+    VM_CASE(Mod) {
+        Cell b; VM_POP(b);
+        if (cellIsInteger<Cell> && b == 0) {
+            tos = *sp--;
+            VM_ERROR("Division by zero");
+        }
+        tos = cellMod(tos, b);
+        VM_NEXT();
+    }
+    VM_CASE(Equals) {
+        tos = *sp-- == tos ? 1 : 0;
+        VM_NEXT();
+    }
+    VM_CASE(LessThan) {
+        tos = *sp-- < tos ? 1 : 0;
+        VM_NEXT();
+    }
+    VM_CASE(GreaterThan) {
+        tos = *sp-- > tos ? 1 : 0;
+        VM_NEXT();
+    }
+    VM_CASE(And) {
+        tos = cellAnd(*sp--, tos);
+        VM_NEXT();
+    }
+    VM_CASE(Or) {
+        tos = cellOr(*sp--, tos);
+        VM_NEXT();
+    }
+    VM_CASE(Not) {
+        tos = tos == 0 ? 1 : 0;
+        VM_NEXT();
+    }
+    VM_CASE(Dup) {
+        *++sp = tos;
+        VM_NEXT();
+    }
+    VM_CASE(Drop) {
+        tos = *sp--;
+        VM_NEXT();
+    }
+    VM_CASE(Swap) {
+        Cell a = *sp; *sp = tos; tos = a;
+        VM_NEXT();
+    }
+    VM_CASE(Over) {
+        Cell a = *sp; *++sp = tos; tos = a;
+        VM_NEXT();
+    }
+    VM_CASE(Rot) {
+        Cell a = sp[-1]; sp[-1] = sp[0]; sp[0] = tos; tos = a;
+        VM_NEXT();
+    }
+    VM_CASE(ToR) {
+        if (return_stack.depth() >= return_stack.capacity()) VM_ERROR("Return stack overflow");
+        *++return_stack.top = tos;
+        tos = *sp--;
+        VM_NEXT();
+    }
+    VM_CASE(RFrom) {
+        if (return_stack.empty()) VM_ERROR("Return stack underflow");
+        VM_PUSH(*return_stack.top--);
+        VM_NEXT();
+    }
+    VM_CASE(RFetch) {
+        if (return_stack.empty()) VM_ERROR("Return stack underflow");
+        VM_PUSH(*return_stack.top);
+        VM_NEXT();
+    }
+    VM_CASE(Store) {
+        Cell addr; VM_POP(addr);
+        Cell val; VM_POP(val);
+        const char* error = nullptr;
+        Cell* cell = cellForStore(memory, addr, error);
+        if (!cell) VM_ERROR(error);
+        *cell = val;
+        VM_NEXT();
+    }
+    VM_CASE(Fetch) {
+        size_t index;
+        if (!cellToIndex(tos, memory.size(), index)) {
+            tos = *sp--;
+            VM_ERROR("Memory access out of bounds");
+        }
+        tos = memory[index];
+        VM_NEXT();
+    }
+    VM_CASE(CStore) {
+        Cell addr; VM_POP(addr);
+        Cell val; VM_POP(val);
+        const char* error = nullptr;
+        unsigned char* byte = byteForStore(memory, addr, error);
+        if (!byte) VM_ERROR(error);
+        *byte = cellToByte(val);
+        VM_NEXT();
+    }
+    VM_CASE(CFetch) {
+        const unsigned char* byte = byteAt(memory, tos);
+        if (!byte) {
+            tos = *sp--;
+            VM_ERROR("Memory access out of bounds");
+        }
+        tos = static_cast<Cell>(*byte);
+        VM_NEXT();
+    }
+    // The compiler only emits LoopI, LoopJ and LoopK inside enough loops of
+    // their own definition, so the frames are there.
+    VM_CASE(LoopI) {
+        VM_PUSH(static_cast<Cell>(loop_frames.back().index));
+        VM_NEXT();
+    }
+    VM_CASE(LoopJ) {
+        VM_PUSH(static_cast<Cell>(loop_frames[loop_frames.size() - 2].index));
+        VM_NEXT();
+    }
+    VM_CASE(LoopK) {
+        VM_PUSH(static_cast<Cell>(loop_frames[loop_frames.size() - 3].index));
+        VM_NEXT();
+    }
+    VM_CASE(LoopIndex) {
+        size_t level = static_cast<size_t>(ip->arg);
+        if (loop_frames.size() < level) {
+            VM_ERROR(level == 1 ? "'I' can only be used inside a DO...LOOP"
+                     : level == 2 ? "'J' can only be used inside nested DO...LOOPs"
+                                  : "'K' can only be used inside triply-nested DO...LOOPs");
+        }
+        VM_PUSH(static_cast<Cell>(loop_frames[loop_frames.size() - level].index));
+        VM_NEXT();
+    }
+    VM_CASE(Dot) {
+        Cell a; VM_POP(a);
+        std::cout << a << " ";
+        VM_NEXT();
+    }
+    VM_CASE(DotS) {
+        VM_SYNC();
+        printStack();
+        VM_NEXT();
+    }
+    VM_CASE(Cr) {
+        std::cout << std::endl;
+        VM_NEXT();
+    }
+    VM_CASE(Print) {
+        std::cout << code_space.strings[ip->arg];
+        VM_NEXT();
+    }
+    VM_CASE(Accept) {
+        Cell max_len; VM_POP(max_len);
+        Cell addr; VM_POP(addr);
+        VM_SYNC();
+        Cell length = acceptLine(memory, addr, max_len);
+        VM_PUSH(length);
+        VM_NEXT();
+    }
+    VM_CASE(ToNumber) {
+        Cell len; VM_POP(len);
+        Cell addr; VM_POP(addr);
+        VM_SYNC();
+        Cell value = numberFromMemory(memory, addr, len);
+        VM_PUSH(value);
+        VM_NEXT();
+    }
+    VM_CASE(Type) {
+        Cell len; VM_POP(len);
+        Cell addr; VM_POP(addr);
+        VM_SYNC();
+        typeBytes(memory, addr, len);
+        VM_NEXT();
+    }
+    VM_CASE(MapFile) {
+        Cell mode; VM_POP(mode);
+        Cell len; VM_POP(len);
+        Cell addr; VM_POP(addr);
+        VM_SYNC();
+        Cell base, cells;
+        mapFileInto(memory, addr, len, mode, base, cells);
+        VM_PUSH(base);
+        VM_PUSH(cells);
+        VM_NEXT();
+    }
+    VM_CASE(Unmap) {
+        Cell base; VM_POP(base);
+        VM_SYNC();
+        unmapFileAt(memory, base);
+        VM_NEXT();
+    }
+    VM_CASE(Move) {
+        Cell count; VM_POP(count);
+        Cell to; VM_POP(to);
+        Cell from; VM_POP(from);
+        VM_SYNC();
+        moveCells(memory, from, to, count);
+        VM_NEXT();
+    }
+    VM_CASE(Fill) {
+        Cell value; VM_POP(value);
+        Cell count; VM_POP(count);
+        Cell addr; VM_POP(addr);
+        VM_SYNC();
+        fillCells(memory, addr, count, value);
+        VM_NEXT();
+    }
+    VM_CASE(Erase) {
+        Cell count; VM_POP(count);
+        Cell addr; VM_POP(addr);
+        VM_SYNC();
+        eraseCells(memory, addr, count);
+        VM_NEXT();
+    }
+    VM_CASE(Compare) {
+        Cell len2; VM_POP(len2);
+        Cell addr2; VM_POP(addr2);
+        Cell len1; VM_POP(len1);
+        Cell addr1; VM_POP(addr1);
+        VM_SYNC();
+        Cell order = compareBytes(memory, addr1, len1, addr2, len2);
+        VM_PUSH(order);
+        VM_NEXT();
+    }
+    VM_CASE(Search) {
+        Cell len2; VM_POP(len2);
+        Cell addr2; VM_POP(addr2);
+        Cell len; VM_POP(len);
+        Cell addr; VM_POP(addr);
+        VM_SYNC();
+        bool found = searchBytes(memory, addr, len, addr2, len2);
+        VM_PUSH(addr);
+        VM_PUSH(len);
+        VM_PUSH(found ? 1 : 0);
+        VM_NEXT();
+    }
+    VM_CASE(Scan) {
+        Cell value; VM_POP(value);
+        Cell count; VM_POP(count);
+        Cell addr; VM_POP(addr);
+        VM_SYNC();
+        scanCells(memory, addr, count, value);
+        VM_PUSH(addr);
+        VM_PUSH(count);
+        VM_NEXT();
+    }
+    VM_CASE(VAdd) {
+        Cell count; VM_POP(count);
+        Cell to; VM_POP(to);
+        Cell b; VM_POP(b);
+        Cell a; VM_POP(a);
+        VM_SYNC();
+        vectorAdd(memory, a, b, to, count);
+        VM_NEXT();
+    }
+    VM_CASE(VSub) {
+        Cell count; VM_POP(count);
+        Cell to; VM_POP(to);
+        Cell b; VM_POP(b);
+        Cell a; VM_POP(a);
+        VM_SYNC();
+        vectorSub(memory, a, b, to, count);
+        VM_NEXT();
+    }
+    VM_CASE(VMul) {
+        Cell count; VM_POP(count);
+        Cell to; VM_POP(to);
+        Cell b; VM_POP(b);
+        Cell a; VM_POP(a);
+        VM_SYNC();
+        vectorMul(memory, a, b, to, count);
+        VM_NEXT();
+    }
+    VM_CASE(VScale) {
+        Cell k; VM_POP(k);
+        Cell count; VM_POP(count);
+        Cell to; VM_POP(to);
+        Cell from; VM_POP(from);
+        VM_SYNC();
+        vectorScale(memory, from, to, count, k);
+        VM_NEXT();
+    }
+    VM_CASE(VDot) {
+        Cell count; VM_POP(count);
+        Cell b; VM_POP(b);
+        Cell a; VM_POP(a);
+        VM_SYNC();
+        Cell dot = vectorDot(memory, a, b, count);
+        VM_PUSH(dot);
+        VM_NEXT();
+    }
+    VM_CASE(VSum) {
+        Cell count; VM_POP(count);
+        Cell addr; VM_POP(addr);
+        VM_SYNC();
+        Cell sum = vectorSum(memory, addr, count);
+        VM_PUSH(sum);
+        VM_NEXT();
+    }
+    VM_CASE(VMin) {
+        Cell count; VM_POP(count);
+        Cell addr; VM_POP(addr);
+        VM_SYNC();
+        Cell least = vectorMin(memory, addr, count);
+        VM_PUSH(least);
+        VM_NEXT();
+    }
+    VM_CASE(VMax) {
+        Cell count; VM_POP(count);
+        Cell addr; VM_POP(addr);
+        VM_SYNC();
+        Cell greatest = vectorMax(memory, addr, count);
+        VM_PUSH(greatest);
+        VM_NEXT();
+    }
+    VM_CASE(Jump) {
+        VM_JUMP(ip->arg);
+    }
+    VM_CASE(JumpIfZero) {
+        Cell flag; VM_POP(flag);
+        if (flag == 0) {
+            VM_JUMP(ip->arg);
+        }
+        VM_NEXT();
+    }
+    VM_CASE(Do) {
+        Cell start; VM_POP(start);
+        Cell limit; VM_POP(limit);
+        if ((long)start >= (long)limit) {
+            VM_JUMP(ip->arg);
+        }
+        loop_frames.push_back({(long)start, (long)limit});
+        VM_NEXT();
+    }
+    VM_CASE(Loop) {
+        LoopFrame& frame = loop_frames.back();
+        if (++frame.index < frame.limit) {
+            VM_JUMP(ip->arg);
+        }
+        loop_frames.pop_back();
+        VM_NEXT();
+    }
+    VM_CASE(QDo) {
+        Cell start; VM_POP(start);
+        Cell limit; VM_POP(limit);
+        if ((long)start == (long)limit) {
+            VM_JUMP(ip->arg);
+        }
+        loop_frames.push_back({(long)start, (long)limit});
+        VM_NEXT();
+    }
+    VM_CASE(PlusLoop) {
+        Cell step; VM_POP(step);
+        if (loop_frames.back().step((long)step)) {
+            VM_JUMP(ip->arg);
+        }
+        loop_frames.pop_back();
+        VM_NEXT();
+    }
+    VM_CASE(Leave) {
+        loop_frames.pop_back();
+        VM_JUMP(ip->arg);
+    }
+    VM_CASE(Unloop) {
+        loop_frames.pop_back();
+        VM_NEXT();
+    }
+    VM_CASE(Call) {
+        size_t target = entries[ip->arg];
+        if (target == Dictionary::unbound) {
+            VM_ERROR("Unknown word: " + code_space.dictionary.name(ip->arg));
+        }
+        if (call_frames.size() >= call_depth) VM_ERROR("Call stack overflow");
+        call_frames.push_back(ip + 1);
+        ip = code + target;
+        VM_DISPATCH();
+    }
+    VM_CASE(TailCall) {
+        // The callee returns straight to our caller, so no frame is pushed.
+        size_t target = entries[ip->arg];
+        if (target == Dictionary::unbound) {
+            VM_ERROR("Unknown word: " + code_space.dictionary.name(ip->arg));
+        }
+        ip = code + target;
+        VM_DISPATCH();
+    }
+    VM_CASE(Define) {
+        const PendingDefinition& def = code_space.definitions[ip->arg];
+        code_space.bind(def.slot, def.entry);
+        VM_NEXT();
+    }
+    VM_CASE(Exit) {
+        ip = call_frames.back();
+        call_frames.pop_back();
+        VM_DISPATCH();
+    }
+    VM_CASE(Halt) {
+        VM_SYNC();
+        return;
+    }
+
+    // Superinstructions formed by the peephole optimizer.
+    VM_CASE(TwoDup) {
+        Cell a = *sp;
+        sp[1] = tos;
+        sp[2] = a;
+        sp += 2;
+        VM_NEXT();
+    }
+    VM_CASE(Square) {
+        tos = cellMul(tos, tos);
+        VM_NEXT();
+    }
+    VM_CASE(AddI) {
+        tos = cellAdd(tos, constants[ip->arg]);
+        VM_NEXT();
+    }
+    VM_CASE(MulI) {
+        tos = cellMul(tos, constants[ip->arg]);
+        VM_NEXT();
+    }
+    VM_CASE(FetchIOffset) {
+        Cell addr = cellAdd(static_cast<Cell>(loop_frames.back().index), constants[ip->arg]);
+        size_t index;
+        if (!cellToIndex(addr, memory.size(), index)) VM_ERROR("Memory access out of bounds");
+        VM_PUSH(memory[index]);
+        VM_NEXT();
+    }
+
+    // Native code for a run of instructions starting here; it returns the
+    // position to carry on from, or a JitStatus.
+    VM_CASE(Native) {
+        JitState<Cell> state{sp, tos};
+        int64_t next = jit.enter(ip->arg, state);
+        sp = state.sp;
+        tos = state.tos;
+        if (next < 0) VM_ERROR(jitStatusMessage(next));
+        ip = code + next;
+        VM_DISPATCH();
+    }
+
+#if !PELI_THREADED_DISPATCH
+    }
+#endif
+}
+
+#define PELI_INSTANTIATE_EXECUTE(Cell) template void BasicInterpreter<Cell>::execute(size_t);
+PELI_CELL_TYPES(PELI_INSTANTIATE_EXECUTE)
@@ -0,0 +1,335 @@
+#include "ast.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+
+// Serialized trees are mostly one- and two-byte words, so integers are
+// written as LEB128 varints and signed ones zigzag-encoded first.
+void putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>(value | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+class Decoder {
+public:
+    explicit Decoder(std::string_view bytes) : at(bytes.data()), end(bytes.data() + bytes.size()) {}
+
+    uint8_t byte() {
+        if (at == end) {
+            malformed();
+        }
+        return static_cast<uint8_t>(*at++);
+    }
+    uint64_t varint() {
+        if (at != end && !(*at & 0x80)) {
+            return static_cast<uint8_t>(*at++);
+        }
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t next = byte();
+            value |= static_cast<uint64_t>(next & 0x7F) << shift;
+            if (!(next & 0x80)) {
+                return value;
+            }
+        }
+        malformed();
+    }
+    const char* take(uint64_t size) {
+        if (size > static_cast<uint64_t>(end - at)) {
+            malformed();
+        }
+        const char* start = at;
+        at += size;
+        return start;
+    }
+    bool done() const { return at == end; }
+
+    [[noreturn]] static void malformed() { throw std::runtime_error("Serialized tree is malformed"); }
+
+private:
+    const char* at;
+    const char* end;
+};
+
+uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// The first byte of a node: its kind and its flags.
+constexpr uint8_t kKindMask = 0x07;
+constexpr int kFlagsShift = 3;
+
+} // namespace
+
+std::string AstNode::toString() const {
+    switch (node_kind) {
+        case AstKind::Block: return "Program";
+        case AstKind::Number: return std::to_string(getValue());
+        case AstKind::Word: return std::string(getText());
+        case AstKind::If: return "IF";
+        case AstKind::Definition: return ":" + std::string(getName());
+        case AstKind::DoLoop:
+            return std::string(isConditional() ? "?DO" : "DO") + (isPlusLoop() ? "-+LOOP" : "-LOOP");
+        case AstKind::Include: return std::string(isOnce() ? "REQUIRE " : "INCLUDE ") + std::string(getPath());
+    }
+    return "";
+}
+
+Ast Ast::copyOf(const AstNode& subtree) {
+    Ast ast;
+    ast.nodes.assign(&subtree, &subtree + subtree.size);
+    for (AstNode& node : ast.nodes) {
+        if (node.hasText()) {
+            node.payload.text = ast.addText(node.arenaText()).data() - sizeof(uint32_t);
+        }
+    }
+    return ast;
+}
+
+size_t Ast::open(const AstNode& node) {
+    nodes.push_back(node);
+    return nodes.size() - 1;
+}
+
+void Ast::close(size_t index, uint8_t flags) {
+    nodes[index].size = static_cast<uint32_t>(nodes.size() - index);
+    nodes[index].flags |= flags;
+}
+
+void Ast::clear() {
+    nodes.clear();
+    chunks.clear();
+    chunk_next = nullptr;
+    chunk_left = 0;
+    arena_bytes = 0;
+}
+
+std::string_view Ast::addText(std::string_view text) {
+    uint32_t length = static_cast<uint32_t>(std::min<size_t>(text.size(), UINT32_MAX));
+    size_t needed = sizeof(length) + length;
+    if (needed > chunk_left) {
+        size_t size = std::max<size_t>(needed, 4096);
+        chunks.push_back(std::make_unique<char[]>(size));
+        chunk_next = chunks.back().get();
+        chunk_left = size;
+        arena_bytes += size;
+    }
+    std::memcpy(chunk_next, &length, sizeof(length));
+    std::memcpy(chunk_next + sizeof(length), text.data(), length);
+    std::string_view copy(chunk_next + sizeof(length), length);
+    chunk_next += needed;
+    chunk_left -= needed;
+    return copy;
+}
+
+std::string Ast::serialize() const {
+    // Each distinct text is written once, up front, and nodes refer to it
+    // by index. Leaves have no size to record.
+    // Names are written by their text, as Symbols only hold within a run.
+    std::unordered_map<std::string_view, uint64_t> indices;
+    std::vector<std::string_view> texts;
+    auto textOf = [](const AstNode& node) {
+        return node.hasSymbol() ? symbolName(node.payload.symbol) : node.arenaText();
+    };
+    for (const AstNode& node : nodes) {
+        if (node.hasSymbol() || node.hasText()) {
+            if (indices.emplace(textOf(node), texts.size()).second) {
+                texts.push_back(textOf(node));
+            }
+        }
+    }
+
+    std::string out;
+    putVarint(out, texts.size());
+    for (std::string_view text : texts) {
+        putVarint(out, text.size());
+        out += text;
+    }
+    putVarint(out, nodes.size());
+    for (const AstNode& node : nodes) {
+        uint8_t head = static_cast<uint8_t>(node.node_kind) | static_cast<uint8_t>(node.flags << kFlagsShift);
+        switch (node.node_kind) {
+            case AstKind::Number:
+                out += static_cast<char>(head);
+                if (node.isIntegral()) {
+                    putVarint(out, zigzag(node.payload.integer));
+                } else {
+                    out.append(reinterpret_cast<const char*>(&node.payload.value), sizeof(double));
+                }
+                break;
+            case AstKind::Word:
+                out += static_cast<char>(head);
+                out += static_cast<char>(node.type);
+                putVarint(out, indices[textOf(node)]);
+                break;
+            case AstKind::Definition:
+                out += static_cast<char>(head);
+                putVarint(out, indices[textOf(node)]);
+                putVarint(out, node.size);
+                break;
+            case AstKind::Include:
+                out += static_cast<char>(head);
+                putVarint(out, indices[textOf(node)]);
+                break;
+            default:
+                out += static_cast<char>(head);
+                putVarint(out, node.size);
+                break;
+        }
+    }
+    return out;
+}
+
+Ast Ast::deserialize(std::string_view bytes) {
+    Decoder in(bytes);
+    Ast ast;
+
+    uint64_t text_count = in.varint();
+    if (text_count > bytes.size()) {
+        Decoder::malformed();
+    }
+    // Each text is interned, or copied into the arena, the first time a
+    // node needs it as a name, or as text.
+    struct Text {
+        std::string_view bytes;
+        Symbol symbol = kNoSymbol;
+        const char* copy = nullptr;
+    };
+    std::vector<Text> texts;
+    texts.reserve(static_cast<size_t>(text_count));
+    for (uint64_t i = 0; i < text_count; ++i) {
+        uint64_t size = in.varint();
+        texts.push_back({std::string_view(in.take(size), static_cast<size_t>(size))});
+    }
+    auto text = [&]() -> Text& {
+        uint64_t index = in.varint();
+        if (index >= texts.size()) {
+            Decoder::malformed();
+        }
+        return texts[static_cast<size_t>(index)];
+    };
+    auto name = [&]() {
+        Text& entry = text();
+        if (entry.symbol == kNoSymbol) {
+            entry.symbol = internSymbol(entry.bytes);
+        }
+        return entry.symbol;
+    };
+    auto arena = [&]() {
+        Text& entry = text();
+        if (!entry.copy) {
+            entry.copy = ast.addText(entry.bytes).data() - sizeof(uint32_t);
+        }
+        return entry.copy;
+    };
+
+    // Every node takes at least two bytes.
+    uint64_t count = in.varint();
+    if (count == 0 || count > bytes.size() / 2) {
+        Decoder::malformed();
+    }
+
+    // The compiler and interpreters trust the shape of the tree, so as the
+    // nodes are read every subtree has to fit its parent, and every parent
+    // end up with the children its kind calls for: Blocks hold statements,
+    // the other kinds hold Blocks.
+    struct Open {
+        size_t end;
+        AstKind kind;
+        size_t children;
+    };
+    std::vector<Open> parents;
+    auto finish = [](const Open& parent) {
+        size_t expected = parent.kind == AstKind::If ? 2
+                          : parent.kind == AstKind::Definition || parent.kind == AstKind::DoLoop ? 1
+                                                                                                  : 0;
+        if (parent.kind != AstKind::Block && parent.children != expected) {
+            Decoder::malformed();
+        }
+    };
+
+    ast.nodes.reserve(static_cast<size_t>(count));
+    for (size_t i = 0; i < count; ++i) {
+        uint8_t head = in.byte();
+        uint8_t kind = head & kKindMask;
+        if (kind > static_cast<uint8_t>(AstKind::Include)) {
+            Decoder::malformed();
+        }
+        AstNode node(static_cast<AstKind>(kind));
+        node.flags = head >> kFlagsShift;
+        switch (node.node_kind) {
+            case AstKind::Number:
+                if (node.isIntegral()) {
+                    node.payload.integer = unzigzag(in.varint());
+                    if ((node.flags & AstNode::kNegativeZero) && node.payload.integer != 0) {
+                        Decoder::malformed();
+                    }
+                } else {
+                    std::memcpy(&node.payload.value, in.take(sizeof(double)), sizeof(double));
+                }
+                break;
+            case AstKind::Word: {
+                uint8_t type = in.byte();
+                if (type > static_cast<uint8_t>(TokenType::Unknown)) {
+                    Decoder::malformed();
+                }
+                node.type = static_cast<TokenType>(type);
+                if (node.hasText()) {
+                    node.payload.text = arena();
+                } else {
+                    node.payload.symbol = name();
+                }
+                break;
+            }
+            case AstKind::Definition:
+                node.payload.symbol = name();
+                node.size = static_cast<uint32_t>(std::min<uint64_t>(in.varint(), UINT32_MAX));
+                break;
+            case AstKind::Include:
+                node.payload.text = arena();
+                break;
+            default:
+                node.size = static_cast<uint32_t>(std::min<uint64_t>(in.varint(), UINT32_MAX));
+                break;
+        }
+
+        while (!parents.empty() && parents.back().end == i) {
+            finish(parents.back());
+            parents.pop_back();
+        }
+        size_t limit = parents.empty() ? count : parents.back().end;
+        if (node.size == 0 || node.size > limit - i ||
+            (i == 0) != parents.empty() ||
+            (!parents.empty() && (node.node_kind == AstKind::Block) == (parents.back().kind == AstKind::Block))) {
+            Decoder::malformed();
+        }
+        if (!parents.empty()) {
+            ++parents.back().children;
+        }
+        Open self{i + node.size, node.node_kind, 0};
+        if (node.size > 1) {
+            parents.push_back(self);
+        } else {
+            finish(self);
+        }
+        ast.nodes.push_back(node);
+    }
+    if (!in.done() || ast.nodes[0].node_kind != AstKind::Block || ast.nodes[0].size != count) {
+        Decoder::malformed();
+    }
+    while (!parents.empty()) {
+        finish(parents.back());
+        parents.pop_back();
+    }
+    return ast;
+}
@@ -1,80 +1,257 @@
 #pragma once
 
+#include "Cell.hpp"
 #include "lexer.hpp"
+#include "Symbols.hpp"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <memory>
 #include <string>
-#include <utility>
+#include <string_view>
 #include <vector>
 
-class AstNode {
-public:
-    virtual ~AstNode() = default;
-    virtual std::string toString() const = 0;
-};
+// The tree is flat: every node of a parse lives in one contiguous array, in
+// pre-order, so a node's subtree is the `size` nodes starting at the node
+// itself and its children follow it directly, each one `size` nodes past
+// the last. Sizes are relative, which keeps a subtree valid wherever it is
+// copied to.
+//
+//   Block       the statements of a program, definition, branch or loop
+//   Number      a literal
+//   Word        a builtin or user word: `type` from its token and its name
+//               as a Symbol; a ." is a Word with the text to print instead
+//   If          two Blocks: the true branch, then the (maybe empty) false one
+//   Definition  a colon definition; its name a Symbol, its child its body
+//   DoLoop      a DO or ?DO loop with its body Block; see the flags below
+//   Include     INCLUDE or REQUIRE (kOnce) of the file named by its text;
+//               only at the top level of a program or module
+//
+// A node is 16 bytes: names are Symbols and the rare texts that are not
+// names live in the tree's arena (see Ast::addText).
+//
+// DO skips its body when start >= limit; ?DO only when start == limit, so a
+// ?DO...+LOOP with a negative step can count down. +LOOP takes its step from
+// the stack and ends the loop once the index crosses from limit - 1 to limit.
+enum class AstKind : uint8_t { Block, Number, Word, If, Definition, DoLoop, Include };
 
-class NumberNode : public AstNode {
-public:
-    explicit NumberNode(double value) : value(value) {}
-    std::string toString() const override { return std::to_string(value); }
-    double getValue() const { return value; }
-private:
-    double value;
-};
+class AstNode;
 
-class WordNode : public AstNode {
+// The children of a node, in order.
+class AstChildren {
 public:
-    explicit WordNode(Token token) : token(std::move(token)) {}
-    std::string toString() const override { return token.text; }
-    const Token& getToken() const { return token; }
+    class iterator {
+    public:
+        explicit iterator(const AstNode* node) : node(node) {}
+        const AstNode& operator*() const { return *node; }
+        const AstNode* operator->() const { return node; }
+        iterator& operator++();
+        bool operator==(const iterator& other) const { return node == other.node; }
+        bool operator!=(const iterator& other) const { return node != other.node; }
+    private:
+        const AstNode* node;
+    };
+
+    AstChildren(const AstNode* first, const AstNode* last) : first(first), last(last) {}
+    iterator begin() const { return iterator(first); }
+    iterator end() const { return iterator(last); }
+    bool empty() const { return first == last; }
 private:
-    Token token;
+    const AstNode* first;
+    const AstNode* last;
 };
 
-class ProgramNode : public AstNode {
+class AstNode {
 public:
-    std::string toString() const override { return "Program"; }
-    void addNode(std::unique_ptr<AstNode> node) {
-        nodes.push_back(std::move(node));
+    static constexpr uint8_t kConditional = 1; // ?DO
+    static constexpr uint8_t kPlusLoop = 2;    // +LOOP
+    static constexpr uint8_t kIntegral = 4;    // exact 64-bit integer literal
+    static constexpr uint8_t kOnce = 8;        // REQUIRE
+    // An integral literal's double is the integer's, except for -0.
+    static constexpr uint8_t kNegativeZero = 8;
+
+    static AstNode block() { return AstNode(AstKind::Block); }
+    static AstNode number(double value) {
+        AstNode node(AstKind::Number);
+        node.payload.value = value;
+        return node;
     }
-    const std::vector<std::unique_ptr<AstNode>>& getNodes() const {
-        return nodes;
+    static AstNode number(double value, int64_t integer) {
+        AstNode node(AstKind::Number);
+        node.flags = kIntegral | (integer == 0 && std::signbit(value) ? kNegativeZero : 0);
+        node.payload.integer = integer;
+        return node;
+    }
+    static AstNode word(TokenType type, Symbol name) {
+        AstNode node(AstKind::Word);
+        node.type = type;
+        node.payload.symbol = name;
+        return node;
+    }
+    static AstNode word(TokenType type, std::string_view name) { return word(type, internSymbol(name)); }
+    // `text` must come from Ast::addText.
+    static AstNode dotQuote(std::string_view text) {
+        AstNode node(AstKind::Word);
+        node.type = TokenType::DotQuote;
+        node.payload.text = text.data() - sizeof(uint32_t);
+        return node;
+    }
+    static AstNode ifThen() { return AstNode(AstKind::If); }
+    static AstNode definition(Symbol name) {
+        AstNode node(AstKind::Definition);
+        node.payload.symbol = name;
+        return node;
+    }
+    // +LOOP is only known at the end of the loop; see Ast::close.
+    static AstNode doLoop(bool conditional) {
+        AstNode node(AstKind::DoLoop);
+        node.flags = conditional ? kConditional : 0;
+        return node;
     }
-private:
-    std::vector<std::unique_ptr<AstNode>> nodes;
-};
 
-class IfNode : public AstNode {
-public:
-    IfNode(std::unique_ptr<ProgramNode> true_branch, std::unique_ptr<ProgramNode> false_branch)
-        : true_branch(std::move(true_branch)), false_branch(std::move(false_branch)) {}
-    std::string toString() const override { return "IF"; }
-    const ProgramNode& getTrueBranch() const { return *true_branch; }
-    const ProgramNode& getFalseBranch() const { return *false_branch; }
-    bool hasFalseBranch() const { return false_branch != nullptr; }
-private:
-    std::unique_ptr<ProgramNode> true_branch;
-    std::unique_ptr<ProgramNode> false_branch;
-};
+    // `path` must come from Ast::addText.
+    static AstNode include(std::string_view path, bool once) {
+        AstNode node(AstKind::Include);
+        node.flags = once ? kOnce : 0;
+        node.payload.text = path.data() - sizeof(uint32_t);
+        return node;
+    }
+
+    AstKind kind() const { return node_kind; }
+    std::string toString() const;
+
+    AstChildren children() const { return AstChildren(this + 1, this + size); }
+    // Nodes in the subtree, this one included.
+    uint32_t subtreeSize() const { return size; }
+
+    // Number
+    double getValue() const {
+        if (!isIntegral()) {
+            return payload.value;
+        }
+        return flags & kNegativeZero ? -0.0 : static_cast<double>(payload.integer);
+    }
+    bool isIntegral() const { return flags & kIntegral; }
+    int64_t getInteger() const { return payload.integer; }
+    // False when the literal does not fit in a Cell. Integral literals use
+    // their exact value instead of the double it rounds to.
+    template <typename Cell>
+    bool toCell(Cell& out) const {
+        if constexpr (cellIsInteger<Cell>) {
+            if (isIntegral()) {
+                return cellFromLiteral(getInteger(), out);
+            }
+        }
+        return cellFromLiteral(getValue(), out);
+    }
+
+    // Word
+    Token getToken() const {
+        Token token{type, getText()};
+        token.symbol = getSymbol();
+        return token;
+    }
+    std::string_view getText() const { return hasSymbol() ? symbolName(payload.symbol) : arenaText(); }
+    // The name of a Word or Definition; kNoSymbol for a ." Word.
+    Symbol getSymbol() const { return hasSymbol() ? payload.symbol : kNoSymbol; }
+
+    // If
+    const AstNode& getTrueBranch() const { return this[1]; }
+    const AstNode& getFalseBranch() const { return this[1 + this[1].size]; }
+
+    // Definition and DoLoop
+    std::string_view getName() const { return symbolName(payload.symbol); }
+    const AstNode& getBody() const { return this[1]; }
+    bool isConditional() const { return flags & kConditional; }
+    bool isPlusLoop() const { return flags & kPlusLoop; }
+
+    // Include
+    std::string_view getPath() const { return arenaText(); }
+    bool isOnce() const { return flags & kOnce; }
 
-class FunctionDefinitionNode : public AstNode {
-public:
-    FunctionDefinitionNode(std::string name, std::unique_ptr<ProgramNode> body)
-        : name(std::move(name)), body(std::move(body)) {}
-    std::string toString() const override { return ":" + name; }
-    const std::string& getName() const { return name; }
-    const ProgramNode& getBody() const { return *body; }
-    std::unique_ptr<ProgramNode> releaseBody() { return std::move(body); }
 private:
-    std::string name;
-    std::unique_ptr<ProgramNode> body;
+    friend class Ast;
+
+    bool hasSymbol() const {
+        return (node_kind == AstKind::Word && type != TokenType::DotQuote) || node_kind == AstKind::Definition;
+    }
+    bool hasText() const {
+        return (node_kind == AstKind::Word && type == TokenType::DotQuote) || node_kind == AstKind::Include;
+    }
+    std::string_view arenaText() const {
+        uint32_t length;
+        std::memcpy(&length, payload.text, sizeof(length));
+        return {payload.text + sizeof(length), length};
+    }
+
+    union Payload {
+        double value;      // Number
+        int64_t integer;   // Number, kIntegral
+        Symbol symbol;     // hasSymbol()
+        const char* text;  // hasText(): a length, then the text
+        Payload() : integer(0) {}
+    };
+
+    explicit AstNode(AstKind kind) : node_kind(kind) {}
+
+    AstKind node_kind;
+    uint8_t flags = 0;
+    TokenType type = TokenType::Unknown;
+    uint32_t size = 1;
+    Payload payload;
 };
 
-class DoLoopNode : public AstNode {
+static_assert(sizeof(AstNode) == 16, "nodes are packed to 16 bytes");
+
+inline AstChildren::iterator& AstChildren::iterator::operator++() {
+    node += node->subtreeSize();
+    return *this;
+}
+
+// A parsed program: the node array, rooted at a Block, and an arena holding
+// the texts of its ." strings and includes; names are interned Symbols. Both
+// are freed in one go with the tree, and node references stay valid when it
+// is moved.
+class Ast {
 public:
-    DoLoopNode(std::unique_ptr<ProgramNode> body) : body(std::move(body)) {}
-    std::string toString() const override { return "DO-LOOP"; }
-    const ProgramNode& getBody() const { return *body; }
-    std::unique_ptr<ProgramNode> releaseBody() { return std::move(body); }
+    Ast() = default;
+    Ast(Ast&&) = default;
+    Ast& operator=(Ast&&) = default;
+    Ast(const Ast&) = delete;
+    Ast& operator=(const Ast&) = delete;
+
+    // A tree whose root is a copy of `subtree`, text and all.
+    static Ast copyOf(const AstNode& subtree);
+
+    const AstNode& root() const { return nodes.front(); }
+    size_t nodeCount() const { return nodes.size(); }
+
+    // Building, in pre-order: `open` a node, add its children, then `close`
+    // it, along with any flags only known at its end. Leaves are simply
+    // added.
+    size_t open(const AstNode& node);
+    void close(size_t index, uint8_t flags = 0);
+    void add(const AstNode& node) { nodes.push_back(node); }
+    // Copies `text` into the arena, after its length; the result lives as
+    // long as the tree.
+    std::string_view addText(std::string_view text);
+    // Drops every node and all text, keeping the node array's capacity.
+    void clear();
+    // Bytes held by the node array and the arena; names are counted once,
+    // in the symbol table, not here.
+    size_t memoryBytes() const { return nodes.capacity() * sizeof(AstNode) + arena_bytes; }
+
+    // The tree as bytes, for AstCache, and the tree back from them. Only a
+    // build with the same AstKind and TokenType numbering can read them
+    // back; `deserialize` throws std::runtime_error unless the bytes hold a
+    // well-formed tree.
+    std::string serialize() const;
+    static Ast deserialize(std::string_view bytes);
+
 private:
-    std::unique_ptr<ProgramNode> body;
+    std::vector<AstNode> nodes;
+    std::vector<std::unique_ptr<char[]>> chunks;
+    char* chunk_next = nullptr;
+    size_t chunk_left = 0;
+    size_t arena_bytes = 0;
 };
@@ -1,8 +1,22 @@
 #include "lexer.hpp"
-#include <cctype>
-#include <unordered_map>
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <system_error>
 
-static const std::unordered_map<std::string, TokenType> keywords = {
+namespace {
+
+struct Keyword {
+    std::string_view text;
+    TokenType type;
+};
+
+constexpr Keyword keywords[] = {
     {"+", TokenType::Plus},
     {"-", TokenType::Minus},
     {"*", TokenType::Multiply},
@@ -25,6 +39,8 @@ static const std::unordered_map<std::string, TokenType> keywords = {
     {"NOT", TokenType::Not},
     {"!", TokenType::Store},
     {"@", TokenType::Fetch},
+    {"C!", TokenType::CStore},
+    {"C@", TokenType::CFetch},
     {":", TokenType::Colon},
     {";", TokenType::Semicolon},
     {"IF", TokenType::If},
@@ -32,6 +48,11 @@ static const std::unordered_map<std::string, TokenType> keywords = {
     {"THEN", TokenType::Then},
     {"DO", TokenType::Do},
     {"LOOP", TokenType::Loop},
+    {"?DO", TokenType::QDo},
+    {"+LOOP", TokenType::PlusLoop},
+    {"LEAVE", TokenType::Leave},
+    {"UNLOOP", TokenType::Unloop},
+    {"EXIT", TokenType::Exit},
     {"I", TokenType::LoopIndexI},
     {"J", TokenType::LoopIndexJ},
     {"K", TokenType::LoopIndexK},
@@ -40,71 +61,311 @@ static const std::unordered_map<std::string, TokenType> keywords = {
     {"EMIT", TokenType::Emit},
     {"CR", TokenType::Cr},
     {"ACCEPT", TokenType::Accept},
-    {">NUMBER", TokenType::ToNumber}
+    {">NUMBER", TokenType::ToNumber},
+    {"TYPE", TokenType::Type},
+    {"MAP-FILE", TokenType::MapFile},
+    {"UNMAP", TokenType::Unmap},
+    {"MOVE", TokenType::Move},
+    {"FILL", TokenType::Fill},
+    {"ERASE", TokenType::Erase},
+    {"COMPARE", TokenType::Compare},
+    {"SEARCH", TokenType::Search},
+    {"SCAN", TokenType::Scan},
+    {"V+", TokenType::VAdd},
+    {"V-", TokenType::VSub},
+    {"V*", TokenType::VMul},
+    {"VSCALE", TokenType::VScale},
+    {"VSUM", TokenType::VSum},
+    {"VDOT", TokenType::VDot},
+    {"VMIN", TokenType::VMin},
+    {"VMAX", TokenType::VMax},
+    {"INCLUDE", TokenType::Include},
+    {"REQUIRE", TokenType::Require}
 };
 
-bool is_double(const std::string& s) {
-    if (s.empty()) return false;
-    char* p;
-    strtod(s.c_str(), &p);
-    return (*p == 0);
+constexpr size_t kKeywordCount = sizeof(keywords) / sizeof(keywords[0]);
+constexpr int kKeywordBits = 8;
+static_assert(kKeywordCount < 255, "keyword slots hold an index in a byte");
+
+// Hashes a word by its length and its first, second and last characters,
+// which already tell every builtin apart; the seed is searched at compile
+// time (see buildKeywordTable) so that no two builtins share a slot. The
+// length gets a round of its own so that it cannot cancel out the first
+// character ("C@" and "@" would otherwise always collide), and the high bits
+// are folded into the low ones before the slot is taken, so that each new
+// seed moves every builtin to a fresh slot.
+constexpr uint32_t keywordHash(std::string_view word, uint32_t seed) {
+    uint32_t h = (seed ^ static_cast<uint32_t>(word.size())) * 16777619u;
+    h = (h ^ static_cast<unsigned char>(word[0])) * 16777619u;
+    h = (h ^ static_cast<unsigned char>(word[word.size() > 1 ? 1 : 0])) * 16777619u;
+    h = (h ^ static_cast<unsigned char>(word[word.size() - 1])) * 16777619u;
+    h ^= h >> 15;
+    return (h * 2654435761u) >> (32 - kKeywordBits);
+}
+
+// Slot i holds the index of the builtin hashing to i plus one, or zero.
+struct KeywordTable {
+    uint32_t seed = 0;
+    uint8_t slots[1 << kKeywordBits] = {};
+};
+
+constexpr KeywordTable buildKeywordTable() {
+    for (uint32_t seed = 2166136261u;; ++seed) {
+        KeywordTable table;
+        table.seed = seed;
+        bool perfect = true;
+        for (size_t i = 0; i < kKeywordCount && perfect; ++i) {
+            uint8_t& slot = table.slots[keywordHash(keywords[i].text, seed)];
+            perfect = slot == 0;
+            slot = static_cast<uint8_t>(i + 1);
+        }
+        if (perfect) {
+            return table;
+        }
+    }
+}
+
+constexpr KeywordTable keywordTable = buildKeywordTable();
+
+// The index of the builtin spelled `word` in `keywords`, or -1.
+int findKeyword(std::string_view word) {
+    if (word.empty()) {
+        return -1;
+    }
+    uint8_t slot = keywordTable.slots[keywordHash(word, keywordTable.seed)];
+    if (slot == 0 || keywords[slot - 1].text != word) {
+        return -1;
+    }
+    return slot - 1;
+}
+
+// The builtins' symbols, by index in `keywords`, interned on first use so
+// that they need no lookup per token.
+const Symbol* keywordSymbols() {
+    static const auto symbols = [] {
+        std::array<Symbol, kKeywordCount> interned{};
+        for (size_t i = 0; i < kKeywordCount; ++i) {
+            interned[i] = internSymbol(keywords[i].text);
+        }
+        return interned;
+    }();
+    return symbols.data();
+}
+
+} // namespace
+
+bool lookupKeyword(std::string_view word, TokenType& type) {
+    int keyword = findKeyword(word);
+    if (keyword < 0) {
+        return false;
+    }
+    type = keywords[keyword].type;
+    return true;
+}
+
+// Parses a whole word as a number, once, without regard to the locale.
+// Decimal integers that fit in 64 bits are kept exactly; everything else
+// strtod accepts (a leading '+', fractions, exponents, 0x hex, inf and nan)
+// is read as a double.
+static bool parseNumber(std::string_view word, Token& token) {
+    const char* begin = word.data();
+    const char* end = begin + word.size();
+    bool negative = false;
+    if (begin < end && (*begin == '+' || *begin == '-')) {
+        negative = *begin == '-';
+        ++begin;
+    }
+    if (begin == end || *begin == '+' || *begin == '-') {
+        return false;
+    }
+
+    uint64_t magnitude;
+    auto integer = std::from_chars(begin, end, magnitude);
+    uint64_t limit = static_cast<uint64_t>(std::numeric_limits<int64_t>::max()) + (negative ? 1 : 0);
+    if (integer.ec == std::errc() && integer.ptr == end && magnitude <= limit) {
+        token.integer = static_cast<int64_t>(negative ? 0 - magnitude : magnitude);
+        token.number = negative && magnitude == 0 ? -0.0 : static_cast<double>(token.integer);
+        token.integral = true;
+        return true;
+    }
+
+    double value = 0;
+    std::from_chars_result result;
+    if (end - begin > 2 && begin[0] == '0' && (begin[1] == 'x' || begin[1] == 'X') && begin[2] != '-') {
+        result = std::from_chars(begin + 2, end, value, std::chars_format::hex);
+    } else {
+        result = std::from_chars(begin, end, value);
+    }
+    if (result.ptr != end || (result.ec != std::errc() && result.ec != std::errc::result_out_of_range)) {
+        return false;
+    }
+    if (result.ec == std::errc::result_out_of_range) {
+        // Rare enough to hand to strtod for the overflowed or denormal value.
+        std::string copy(begin, end);
+        value = std::strtod(copy.c_str(), nullptr);
+    }
+    token.number = negative ? -value : value;
+    return true;
 }
 
-Lexer::Lexer(std::string source) : source_text(std::move(source)), position(0) {}
+Lexer::Lexer(std::string_view source, const ByteScanner& scanner)
+    : source_text(source), position(0), scanner(&scanner) {}
+
+Lexer::Lexer(std::istream& input, size_t chunk, const ByteScanner& scanner)
+    : position(0), scanner(&scanner), input(&input), chunk(std::max<size_t>(chunk, 1)) {}
 
 Token Lexer::getNextToken() {
-    while (position < source_text.length() && std::isspace(source_text[position])) {
-        position++;
+    if (has_peeked) {
+        has_peeked = false;
+        return peeked;
     }
+    fresh_buffer = false;
+    return scan();
+}
 
-    if (position >= source_text.length()) {
-        return {TokenType::EndOfFile, ""};
+Token Lexer::peekToken() {
+    if (!has_peeked) {
+        fresh_buffer = false;
+        peeked = scan();
+        has_peeked = true;
     }
+    return peeked;
+}
 
-    if (source_text.substr(position, 2) == ".\"") {
-            position += 2; // Consume ."
-            size_t start = position;
-            while (position < source_text.length() && source_text[position] != '"') {
-                position++;
-            }
-            std::string text = source_text.substr(start, position - start);
-            if (position < source_text.length()) {
-                position++; // Consume the closing "
-            }
-            return {TokenType::DotQuote, text};
+bool Lexer::buffered() const {
+    if (has_peeked) {
+        return true;
+    }
+    return scanTo(scanner->skipSpace) < source_text.length();
+}
+
+// True when there is a character at `position + ahead`, reading more of a
+// streamed source if needed. `start` is where the token being scanned
+// begins; its bytes are kept, and it moves with `position` when they do.
+bool Lexer::more(size_t& start, size_t ahead) {
+    while (position + ahead >= source_text.length()) {
+        if (!input || !refill(start)) {
+            return false;
         }
+    }
+    return true;
+}
+
+bool Lexer::refill(size_t& start) {
+    // The last token handed out may live in the current buffer, so the
+    // first refill of a scan carries the partial token over to the other
+    // one. Later refills only ever see that partial token.
+    if (!fresh_buffer) {
+        current_buffer = 1 - current_buffer;
+        buffers[current_buffer].assign(source_text.substr(start));
+        fresh_buffer = true;
+    } else {
+        buffers[current_buffer].erase(0, start);
+    }
+    position -= start;
+    start = 0;
+
+    std::string& buffer = buffers[current_buffer];
+    size_t used = buffer.size();
+    buffer.resize(used + chunk + 1);
+    input->get(&buffer[used], static_cast<std::streamsize>(chunk + 1), '\n');
+    size_t read = static_cast<size_t>(input->gcount());
+    if (read == 0 && !input->eof()) {
+        input->clear(); // An empty line
+    }
+    if (read < chunk && input->peek() == '\n') {
+        buffer[used + read++] = static_cast<char>(input->get());
+    }
+    buffer.resize(used + read);
+    source_text = buffer;
+    return read > 0;
+}
 
-    if (source_text[position] == '(') {
-        position++; // Consume the initial '('
-        int nesting_level = 1;
+size_t Lexer::scanTo(const char* (*find)(const char*, const char*)) const {
+    const char* text = source_text.data();
+    return static_cast<size_t>(find(text + position, text + source_text.length()) - text);
+}
 
-        while (position < source_text.length() && nesting_level > 0) {
-            if (source_text[position] == '(') {
-                nesting_level++;
-            } else if (source_text[position] == ')') {
-                nesting_level--;
+Token Lexer::scan() {
+    // Whitespace and comments come in runs of any length, and may each
+    // need any number of refills.
+    size_t start;
+    for (;;) {
+        position = scanTo(scanner->skipSpace);
+        start = position;
+        if (position == source_text.length()) {
+            if (!more(start)) {
+                return {TokenType::EndOfFile, ""};
             }
-            position++;
+            continue;
         }
+        if (source_text[position] != '(') {
+            break;
+        }
+        skipComment();
+    }
 
-        return getNextToken(); // Get the next real token
+    if (source_text[position] == '.' && more(start, 1) && source_text[position + 1] == '"') {
+        position += 2; // Consume ."
+        start = position;
+        for (;;) {
+            const void* quote = std::memchr(source_text.data() + position, '"', source_text.length() - position);
+            if (quote) {
+                position = static_cast<size_t>(static_cast<const char*>(quote) - source_text.data());
+                break;
+            }
+            position = source_text.length();
+            if (!more(start)) {
+                break;
+            }
+        }
+        std::string_view text = source_text.substr(start, position - start);
+        if (position < source_text.length()) {
+            position++; // Consume the closing "
+        }
+        return {TokenType::DotQuote, text};
     }
 
-    size_t start = position;
-    while (position < source_text.length() && !std::isspace(source_text[position])) {
-        position++;
+    for (;;) {
+        position = scanTo(scanner->findSpace);
+        if (position < source_text.length() || !more(start)) {
+            break;
+        }
     }
 
-    std::string word = source_text.substr(start, position - start);
+    std::string_view word = source_text.substr(start, position - start);
 
-    auto it = keywords.find(word);
-    if (it != keywords.end()) {
-        return {it->second, word};
+    if (int keyword = findKeyword(word); keyword >= 0) {
+        Token token{keywords[keyword].type, word};
+        token.symbol = keywordSymbols()[keyword];
+        return token;
     }
 
-    if (is_double(word)) {
-        return {TokenType::Number, word};
+    Token number{TokenType::Number, word};
+    if (parseNumber(word, number)) {
+        return number;
     }
 
-    return {TokenType::Word, word};
+    Token token{TokenType::Word, word};
+    token.symbol = internSymbol(word);
+    return token;
+}
+
+// Skips a ( ... ) comment, nested ones included, up to the end of input
+// when it is never closed.
+void Lexer::skipComment() {
+    position++; // Consume the initial '('
+    int nesting_level = 1;
+    while (nesting_level > 0) {
+        position = scanTo(scanner->findParen);
+        size_t start = position; // Nothing of a comment is kept
+        if (position == source_text.length()) {
+            if (!more(start)) {
+                return;
+            }
+            continue;
+        }
+        nesting_level += source_text[position] == '(' ? 1 : -1;
+        position++;
+    }
 }
@@ -1,8 +1,13 @@
 #pragma once
+#include "ByteScanner.hpp"
+#include "Symbols.hpp"
+#include <cstdint>
+#include <istream>
 #include <string>
+#include <string_view>
 
 
-enum class TokenType {
+enum class TokenType : uint8_t {
     // Core Types
     Number,
     Word,
@@ -22,12 +27,14 @@ enum class TokenType {
 
     // Memory / Variables
     Store, Fetch, // ! and @
+    CStore, CFetch, // C! and C@
 
     // Defining Words
     Colon, Semicolon,
 
     // Control Flow
     If, Else, Then, Do, Loop,
+    QDo, PlusLoop, Leave, Unloop, Exit, // ?DO, +LOOP
     LoopIndexI,
     LoopIndexJ,
     LoopIndexK,
@@ -36,6 +43,13 @@ enum class TokenType {
     Dot, Emit, Cr,DotS,DotQuote,
     Accept,
     ToNumber,
+    Type,
+    MapFile, Unmap,
+    Move, Fill, Erase, Compare, Search, Scan,
+    VAdd, VSub, VMul, VScale, VSum, VDot, VMin, VMax,
+
+    // Modules
+    Include, Require,
 
     // Special / End
     LeftParen,
@@ -43,16 +57,65 @@ enum class TokenType {
     Unknown
 };
 
+// `text` is a slice of the lexer's source, so a token is only valid for as
+// long as the source it came from. Number tokens also carry their value,
+// parsed once by the lexer; decimal integers that fit in 64 bits are
+// `integral` and hold their exact value in `integer` as well. Words and
+// builtins carry their interned name as `symbol`, which outlives the source.
 struct Token {
     TokenType type;
-    std::string text;
+    std::string_view text;
+    double number = 0;
+    int64_t integer = 0;
+    bool integral = false;
+    Symbol symbol = kNoSymbol;
 };
 
+// Recognizes the builtin words; false for anything else.
+bool lookupKeyword(std::string_view word, TokenType& type);
+
+// Splits source text into tokens without copying it. The caller keeps the
+// source alive for as long as the lexer and its tokens are in use.
+//
+// A streamed lexer reads its source from an istream instead, a line or at
+// most `chunk` bytes at a time, into two buffers it alternates between, so
+// its memory stays bounded however long the input. Its tokens are slices of
+// those buffers, and each stays valid while the token after it is read,
+// which covers a parser's current token and one peeked past it.
+//
+// Whitespace, comments and word ends are found with `scanner`, the widest
+// one the CPU supports unless a test or benchmark picks another.
 class Lexer {
 public:
-    explicit Lexer(std::string source);
+    explicit Lexer(std::string_view source, const ByteScanner& scanner = ByteScanner::best());
+    explicit Lexer(std::istream& input, size_t chunk = 64 * 1024,
+                   const ByteScanner& scanner = ByteScanner::best());
     Token getNextToken();
+    // Returns the next token without consuming it.
+    Token peekToken();
+    // Whether the next token starts in input that has already been read, so
+    // reading it will not wait on a streamed source.
+    bool buffered() const;
 private:
-    std::string source_text;
+    Token scan();
+    void skipComment();
+    size_t scanTo(const char* (*find)(const char*, const char*)) const;
+    bool more(size_t& start, size_t ahead = 0);
+    bool refill(size_t& start);
+
+    std::string_view source_text;
     size_t position;
+    const ByteScanner* scanner;
+
+    Token peeked;
+    bool has_peeked = false;
+
+    // Streaming only.
+    std::istream* input = nullptr;
+    size_t chunk = 0;
+    std::string buffers[2];
+    int current_buffer = 0;
+    // Whether the current buffer holds no token handed out since the last
+    // call, so a refill may reuse it rather than switch buffers.
+    bool fresh_buffer = false;
 };
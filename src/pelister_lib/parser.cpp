@@ -5,102 +5,203 @@ Parser::Parser(Lexer& lexer) : lexer(lexer), currentToken({TokenType::Unknown, "
     advance();
 }
 
+// The next token is only read once it is needed, so that a statement can
+// run before the input after it has arrived.
 void Parser::advance() {
-    currentToken = lexer.getNextToken();
+    pending = true;
 }
 
-std::unique_ptr<ProgramNode> Parser::parse() {
-    auto programNode = std::make_unique<ProgramNode>();
-    while (currentToken.type != TokenType::EndOfFile) {
-        programNode->addNode(parseStatement());
+const Token& Parser::current() {
+    if (pending) {
+        currentToken = lexer.getNextToken();
+        pending = false;
     }
-    return programNode;
+    return currentToken;
 }
 
-std::unique_ptr<AstNode> Parser::parseStatement() {
-    if (currentToken.type == TokenType::If) {
-        return parseIfStatement();
+Ast Parser::parse() {
+    ast = Ast();
+    size_t program = ast.open(AstNode::block());
+    while (current().type != TokenType::EndOfFile) {
+        parseStatement(true);
     }
-    if (currentToken.type == TokenType::Colon) {
-        return parseFunctionDefinition();
+    ast.close(program);
+    return std::move(ast);
+}
+
+bool Parser::parseNext(Ast& statements, size_t limit) {
+    if (current().type == TokenType::EndOfFile) {
+        return false;
+    }
+    // Reuses the storage of the statements the caller is done with.
+    ast = std::move(statements);
+    ast.clear();
+    size_t block = ast.open(AstNode::block());
+    size_t count = 0;
+    do {
+        parseStatement(true);
+    } while (++count < limit && (!pending || lexer.buffered()) && current().type != TokenType::EndOfFile);
+    ast.close(block);
+    statements = std::move(ast);
+    return true;
+}
+
+void Parser::parseStatement(bool top_level) {
+    if (current().type == TokenType::Include || current().type == TokenType::Require) {
+        parseInclude(top_level);
+        return;
+    }
+    if (current().type == TokenType::If) {
+        parseIfStatement();
+        return;
     }
-    if (currentToken.type == TokenType::Do) {
-        return parseDoLoop();
+    if (current().type == TokenType::Colon) {
+        parseFunctionDefinition();
+        return;
     }
+    if (current().type == TokenType::Do || current().type == TokenType::QDo) {
+        parseDoLoop();
+        return;
+    }
+    checkLoopExit();
 
-    std::unique_ptr<AstNode> node;
-    if (currentToken.type == TokenType::Number) {
-        node = std::make_unique<NumberNode>(std::stod(currentToken.text));
+    if (current().type == TokenType::Number) {
+        ast.add(current().integral ? AstNode::number(current().number, current().integer)
+                                      : AstNode::number(current().number));
     } else {
-        node = std::make_unique<WordNode>(currentToken);
+        ast.add(current().type == TokenType::DotQuote ? AstNode::dotQuote(ast.addText(current().text))
+                                                      : AstNode::word(current().type, current().symbol));
     }
     advance();
-    return node;
 }
 
-std::unique_ptr<FunctionDefinitionNode> Parser::parseFunctionDefinition() {
+// The file name is the next word, taken as written. Loading a file is not
+// something a definition or a branch can do, so only the top level may.
+void Parser::parseInclude(bool top_level) {
+    std::string word(current().text);
+    if (!top_level) {
+        throw std::runtime_error(word + " is only allowed at the top level");
+    }
+    bool once = current().type == TokenType::Require;
+    advance(); // Consume 'INCLUDE' or 'REQUIRE'
+    if (current().type == TokenType::EndOfFile) {
+        throw std::runtime_error("Expected a file name after " + word);
+    }
+    ast.add(AstNode::include(ast.addText(current().text), once));
+    advance(); // Consume the file name
+}
+
+// LEAVE and UNLOOP act on the innermost DO loop of the same definition.
+// UNLOOP only makes sense right before EXIT, which must first UNLOOP every
+// loop it returns out of.
+void Parser::checkLoopExit() {
+    switch (current().type) {
+        case TokenType::Leave:
+            if (loop_depth == 0) {
+                throw std::runtime_error("LEAVE outside of a DO loop");
+            }
+            break;
+        case TokenType::Unloop: {
+            if (unloops == loop_depth) {
+                throw std::runtime_error("UNLOOP outside of a DO loop");
+            }
+            ++unloops;
+            Token next = lexer.peekToken();
+            if (next.type != TokenType::Unloop && next.type != TokenType::Exit) {
+                throw std::runtime_error("UNLOOP must be followed by EXIT");
+            }
+            break;
+        }
+        case TokenType::Exit:
+            if (!in_definition) {
+                throw std::runtime_error("EXIT outside of a definition");
+            }
+            if (unloops != loop_depth) {
+                throw std::runtime_error("EXIT inside a DO loop needs an UNLOOP for each loop");
+            }
+            unloops = 0;
+            break;
+        default:
+            break;
+    }
+}
+
+void Parser::parseFunctionDefinition() {
     advance(); // Consume ':'
-    if (currentToken.type != TokenType::Word) {
+    if (current().type != TokenType::Word) {
         throw std::runtime_error("Expected function name after ':'");
     }
-    std::string name = currentToken.text;
+    size_t definition = ast.open(AstNode::definition(current().symbol));
     advance(); // Consume function name
 
-    auto body = std::make_unique<ProgramNode>();
-    while (currentToken.type != TokenType::Semicolon) {
-        if (currentToken.type == TokenType::EndOfFile) {
+    // A definition nested in a loop cannot reach the loop.
+    int outer_depth = loop_depth;
+    bool outer_definition = in_definition;
+    loop_depth = 0;
+    in_definition = true;
+
+    size_t body = ast.open(AstNode::block());
+    while (current().type != TokenType::Semicolon) {
+        if (current().type == TokenType::EndOfFile) {
             throw std::runtime_error("Unterminated function definition; missing ';'");
         }
-        body->addNode(parseStatement());
+        parseStatement();
     }
     advance(); // Consume ';'
-    return std::make_unique<FunctionDefinitionNode>(name, std::move(body));
+    ast.close(body);
+    ast.close(definition);
+    loop_depth = outer_depth;
+    in_definition = outer_definition;
 }
 
-std::unique_ptr<IfNode> Parser::parseIfStatement() {
+void Parser::parseIfStatement() {
     advance(); // Consume 'IF'
+    size_t ifThen = ast.open(AstNode::ifThen());
 
-    auto true_branch = std::make_unique<ProgramNode>();
-    while (currentToken.type != TokenType::Else && currentToken.type != TokenType::Then) {
-        if (currentToken.type == TokenType::EndOfFile) {
+    size_t true_branch = ast.open(AstNode::block());
+    while (current().type != TokenType::Else && current().type != TokenType::Then) {
+        if (current().type == TokenType::EndOfFile) {
             throw std::runtime_error("Unterminated IF statement; missing THEN");
         }
-        true_branch->addNode(parseStatement());
+        parseStatement();
     }
+    ast.close(true_branch);
 
-    std::unique_ptr<ProgramNode> false_branch = nullptr;
-    if (currentToken.type == TokenType::Else) {
+    // Without an ELSE the false branch is an empty block.
+    size_t false_branch = ast.open(AstNode::block());
+    if (current().type == TokenType::Else) {
         advance(); // Consume 'ELSE'
-        false_branch = std::make_unique<ProgramNode>();
-        while (currentToken.type != TokenType::Then) {
-            if (currentToken.type == TokenType::EndOfFile) {
+        while (current().type != TokenType::Then) {
+            if (current().type == TokenType::EndOfFile) {
                 throw std::runtime_error("Unterminated IF..ELSE statement; missing THEN");
             }
-            false_branch->addNode(parseStatement());
+            parseStatement();
         }
     }
+    ast.close(false_branch);
 
-    if (currentToken.type != TokenType::Then) {
+    if (current().type != TokenType::Then) {
         throw std::runtime_error("Expected THEN to close IF statement");
     }
     advance(); // Consume 'THEN'
-
-    if (!false_branch) {
-        false_branch = std::make_unique<ProgramNode>();
-    }
-
-    return std::make_unique<IfNode>(std::move(true_branch), std::move(false_branch));
+    ast.close(ifThen);
 }
 
-std::unique_ptr<DoLoopNode> Parser::parseDoLoop() {
-    advance(); // Consume 'DO'
-    auto body = std::make_unique<ProgramNode>();
-    while (currentToken.type != TokenType::Loop) {
-        if (currentToken.type == TokenType::EndOfFile) {
+void Parser::parseDoLoop() {
+    bool conditional = current().type == TokenType::QDo;
+    advance(); // Consume 'DO' or '?DO'
+    ++loop_depth;
+    size_t loop = ast.open(AstNode::doLoop(conditional));
+    size_t body = ast.open(AstNode::block());
+    while (current().type != TokenType::Loop && current().type != TokenType::PlusLoop) {
+        if (current().type == TokenType::EndOfFile) {
             throw std::runtime_error("Unterminated DO loop; missing LOOP");
         }
-        body->addNode(parseStatement());
+        parseStatement();
     }
-    advance(); // Consume 'LOOP'
-    return std::make_unique<DoLoopNode>(std::move(body));
+    bool plusLoop = current().type == TokenType::PlusLoop;
+    advance(); // Consume 'LOOP' or '+LOOP'
+    --loop_depth;
+    ast.close(body);
+    ast.close(loop, plusLoop ? AstNode::kPlusLoop : 0);
 }
@@ -1,18 +1,34 @@
 #pragma once
 #include "lexer.hpp"
 #include "ast.hpp"
-#include <memory>
 
 class Parser {
 public:
     explicit Parser(Lexer& lexer);
-    std::unique_ptr<ProgramNode> parse();
+    Ast parse();
+    // Parses the next top-level statements into `statements`: one, then
+    // more while their input has already been read, up to `limit` in all.
+    // False once the input is exhausted.
+    bool parseNext(Ast& statements, size_t limit = 1);
 private:
-    std::unique_ptr<AstNode> parseStatement();
-    std::unique_ptr<IfNode> parseIfStatement();
-    std::unique_ptr<FunctionDefinitionNode> parseFunctionDefinition();
-    std::unique_ptr<DoLoopNode> parseDoLoop();
+    void parseStatement(bool top_level = false);
+    void parseInclude(bool top_level);
+    void parseIfStatement();
+    void parseFunctionDefinition();
+    void parseDoLoop();
+    void checkLoopExit();
     Lexer& lexer;
     Token currentToken;
+    bool pending = false;
     void advance();
+    const Token& current();
+
+    // The tree being built.
+    Ast ast;
+
+    // Lexical context for LEAVE, UNLOOP and EXIT: the DO loops open in the
+    // current definition and the UNLOOPs just seen.
+    int loop_depth = 0;
+    int unloops = 0;
+    bool in_definition = false;
 };
@@ -0,0 +1,225 @@
+#include "Bulk.hpp"
+#include "Vector.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+// The cells [begin, begin + count) that `addr` and `len` name, for `word`.
+template <typename Cell>
+size_t cellRange(const CellMemory<Cell>& memory, Cell addr, Cell len, const char* word, size_t& count) {
+    size_t begin;
+    if (!cellToRange(addr, len, memory.size(), begin, count)) {
+        throw std::runtime_error(std::string(word) + " memory out of bounds");
+    }
+    return begin;
+}
+
+// Like cellRange, for a range that is about to be stored to.
+template <typename Cell>
+size_t storeRange(const CellMemory<Cell>& memory, Cell addr, Cell len, const char* word, size_t& count) {
+    size_t begin = cellRange(memory, addr, len, word, count);
+    if (!memory.writable(begin * sizeof(Cell), count * sizeof(Cell))) {
+        throw std::runtime_error(std::string(word) + " into read-only memory");
+    }
+    return begin;
+}
+
+template <typename Cell>
+const unsigned char* byteRange(const CellMemory<Cell>& memory, Cell addr, Cell len, const char* word,
+                               size_t& count) {
+    size_t begin;
+    if (!cellToRange(addr, len, memory.size() * sizeof(Cell), begin, count)) {
+        throw std::runtime_error(std::string(word) + " memory out of bounds");
+    }
+    return reinterpret_cast<const unsigned char*>(memory.data()) + begin;
+}
+
+} // namespace
+
+template <typename Cell>
+void moveCells(CellMemory<Cell>& memory, Cell from, Cell to, Cell count) {
+    size_t n;
+    size_t source = cellRange(memory, from, count, "MOVE", n);
+    size_t target = storeRange(memory, to, count, "MOVE", n);
+    std::memmove(memory.data() + target, memory.data() + source, n * sizeof(Cell));
+}
+
+template <typename Cell>
+void fillCells(CellMemory<Cell>& memory, Cell addr, Cell count, Cell value) {
+    size_t n;
+    Cell* begin = memory.data() + storeRange(memory, addr, count, "FILL", n);
+    // Values whose bytes are all alike, zero above all, are a memset.
+    unsigned char bytes[sizeof(Cell)];
+    std::memcpy(bytes, &value, sizeof(Cell));
+    if (std::all_of(bytes, bytes + sizeof(Cell), [&](unsigned char b) { return b == bytes[0]; })) {
+        std::memset(begin, bytes[0], n * sizeof(Cell));
+    } else {
+        std::fill_n(begin, n, value);
+    }
+}
+
+template <typename Cell>
+void eraseCells(CellMemory<Cell>& memory, Cell addr, Cell count) {
+    size_t n;
+    Cell* begin = memory.data() + storeRange(memory, addr, count, "ERASE", n);
+    std::memset(begin, 0, n * sizeof(Cell));
+}
+
+template <typename Cell>
+Cell compareBytes(const CellMemory<Cell>& memory, Cell addr1, Cell len1, Cell addr2, Cell len2) {
+    size_t n1, n2;
+    const unsigned char* a = byteRange(memory, addr1, len1, "COMPARE", n1);
+    const unsigned char* b = byteRange(memory, addr2, len2, "COMPARE", n2);
+    int order = std::memcmp(a, b, std::min(n1, n2));
+    if (order == 0) {
+        order = n1 < n2 ? -1 : n1 > n2 ? 1 : 0;
+    }
+    return static_cast<Cell>(order < 0 ? -1 : order > 0 ? 1 : 0);
+}
+
+template <typename Cell>
+bool searchBytes(const CellMemory<Cell>& memory, Cell& addr, Cell& len, Cell addr2, Cell len2) {
+    size_t n, m;
+    const unsigned char* hay = byteRange(memory, addr, len, "SEARCH", n);
+    const unsigned char* needle = byteRange(memory, addr2, len2, "SEARCH", m);
+    if (m > n) {
+        return false;
+    }
+    if (m == 0) {
+        return true;
+    }
+    // memchr finds candidates for the first byte many bytes at a time.
+    const unsigned char* last = hay + (n - m);
+    for (const unsigned char* at = hay; at <= last; ++at) {
+        at = static_cast<const unsigned char*>(std::memchr(at, needle[0], static_cast<size_t>(last - at) + 1));
+        if (!at) {
+            return false;
+        }
+        if (std::memcmp(at + 1, needle + 1, m - 1) == 0) {
+            const unsigned char* base = reinterpret_cast<const unsigned char*>(memory.data());
+            addr = static_cast<Cell>(at - base);
+            len = static_cast<Cell>(n - static_cast<size_t>(at - hay));
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename Cell>
+void scanCells(const CellMemory<Cell>& memory, Cell& addr, Cell& count, Cell value) {
+    size_t n;
+    size_t begin = cellRange(memory, addr, count, "SCAN", n);
+    const Cell* cells = memory.data() + begin;
+    // Whole blocks are tested without branching on each cell, which the
+    // compiler turns into vector compares; only the block with a match is
+    // looked at one cell at a time.
+    constexpr size_t kBlock = 16;
+    size_t i = 0;
+    for (; i + kBlock <= n; i += kBlock) {
+        bool found = false;
+        for (size_t k = 0; k < kBlock; ++k) {
+            found |= cells[i + k] == value;
+        }
+        if (found) {
+            break;
+        }
+    }
+    while (i < n && !(cells[i] == value)) {
+        ++i;
+    }
+    addr = static_cast<Cell>(begin + i);
+    count = static_cast<Cell>(n - i);
+}
+
+template <typename Cell>
+void vectorAdd(CellMemory<Cell>& memory, Cell a, Cell b, Cell to, Cell count) {
+    size_t n;
+    const Cell* base = memory.data();
+    size_t first = cellRange(memory, a, count, "V+", n);
+    size_t second = cellRange(memory, b, count, "V+", n);
+    size_t target = storeRange(memory, to, count, "V+", n);
+    VectorKernels<Cell>::best().add(base + first, base + second, memory.data() + target, n);
+}
+
+template <typename Cell>
+void vectorSub(CellMemory<Cell>& memory, Cell a, Cell b, Cell to, Cell count) {
+    size_t n;
+    const Cell* base = memory.data();
+    size_t first = cellRange(memory, a, count, "V-", n);
+    size_t second = cellRange(memory, b, count, "V-", n);
+    size_t target = storeRange(memory, to, count, "V-", n);
+    VectorKernels<Cell>::best().sub(base + first, base + second, memory.data() + target, n);
+}
+
+template <typename Cell>
+void vectorMul(CellMemory<Cell>& memory, Cell a, Cell b, Cell to, Cell count) {
+    size_t n;
+    const Cell* base = memory.data();
+    size_t first = cellRange(memory, a, count, "V*", n);
+    size_t second = cellRange(memory, b, count, "V*", n);
+    size_t target = storeRange(memory, to, count, "V*", n);
+    VectorKernels<Cell>::best().mul(base + first, base + second, memory.data() + target, n);
+}
+
+template <typename Cell>
+void vectorScale(CellMemory<Cell>& memory, Cell from, Cell to, Cell count, Cell k) {
+    size_t n;
+    size_t source = cellRange(memory, from, count, "VSCALE", n);
+    size_t target = storeRange(memory, to, count, "VSCALE", n);
+    VectorKernels<Cell>::best().scale(memory.data() + source, memory.data() + target, n, k);
+}
+
+template <typename Cell>
+Cell vectorSum(const CellMemory<Cell>& memory, Cell addr, Cell count) {
+    size_t n;
+    size_t begin = cellRange(memory, addr, count, "VSUM", n);
+    return VectorKernels<Cell>::best().sum(memory.data() + begin, n);
+}
+
+template <typename Cell>
+Cell vectorDot(const CellMemory<Cell>& memory, Cell a, Cell b, Cell count) {
+    size_t n;
+    size_t first = cellRange(memory, a, count, "VDOT", n);
+    size_t second = cellRange(memory, b, count, "VDOT", n);
+    return VectorKernels<Cell>::best().dot(memory.data() + first, memory.data() + second, n);
+}
+
+template <typename Cell>
+Cell vectorMin(const CellMemory<Cell>& memory, Cell addr, Cell count) {
+    size_t n;
+    size_t begin = cellRange(memory, addr, count, "VMIN", n);
+    if (n == 0) {
+        throw std::runtime_error("VMIN of no cells");
+    }
+    return VectorKernels<Cell>::best().min(memory.data() + begin, n);
+}
+
+template <typename Cell>
+Cell vectorMax(const CellMemory<Cell>& memory, Cell addr, Cell count) {
+    size_t n;
+    size_t begin = cellRange(memory, addr, count, "VMAX", n);
+    if (n == 0) {
+        throw std::runtime_error("VMAX of no cells");
+    }
+    return VectorKernels<Cell>::best().max(memory.data() + begin, n);
+}
+
+#define PELI_INSTANTIATE_BULK(Cell)                                                                \
+    template void moveCells<Cell>(CellMemory<Cell>&, Cell, Cell, Cell);                            \
+    template void fillCells<Cell>(CellMemory<Cell>&, Cell, Cell, Cell);                            \
+    template void eraseCells<Cell>(CellMemory<Cell>&, Cell, Cell);                                 \
+    template Cell compareBytes<Cell>(const CellMemory<Cell>&, Cell, Cell, Cell, Cell);             \
+    template bool searchBytes<Cell>(const CellMemory<Cell>&, Cell&, Cell&, Cell, Cell);            \
+    template void scanCells<Cell>(const CellMemory<Cell>&, Cell&, Cell&, Cell);                    \
+    template void vectorAdd<Cell>(CellMemory<Cell>&, Cell, Cell, Cell, Cell);                      \
+    template void vectorSub<Cell>(CellMemory<Cell>&, Cell, Cell, Cell, Cell);                      \
+    template void vectorMul<Cell>(CellMemory<Cell>&, Cell, Cell, Cell, Cell);                      \
+    template void vectorScale<Cell>(CellMemory<Cell>&, Cell, Cell, Cell, Cell);                    \
+    template Cell vectorSum<Cell>(const CellMemory<Cell>&, Cell, Cell);                            \
+    template Cell vectorDot<Cell>(const CellMemory<Cell>&, Cell, Cell, Cell);                      \
+    template Cell vectorMin<Cell>(const CellMemory<Cell>&, Cell, Cell);                            \
+    template Cell vectorMax<Cell>(const CellMemory<Cell>&, Cell, Cell);
+PELI_CELL_TYPES(PELI_INSTANTIATE_BULK)
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Cell.hpp"
+#include "Memory.hpp"
+
+// Words that work on a whole range of memory at once. Each checks its range
+// once, up front, and then runs at memcpy speed instead of a DO loop's worth
+// of dispatches and bounds checks. MOVE, FILL, ERASE, SCAN and the V words
+// count in cells like @ and !; COMPARE and SEARCH count in bytes like C@
+// and TYPE. Ranges that do not fit in memory, or that would store into a
+// read-only file, raise std::runtime_error before anything is touched.
+
+// MOVE: copies the `count` cells at `from` to `to`; the two may overlap.
+template <typename Cell>
+void moveCells(CellMemory<Cell>& memory, Cell from, Cell to, Cell count);
+
+// FILL: stores `value` in each of the `count` cells at `addr`.
+template <typename Cell>
+void fillCells(CellMemory<Cell>& memory, Cell addr, Cell count, Cell value);
+
+// ERASE: zeroes the `count` cells at `addr`.
+template <typename Cell>
+void eraseCells(CellMemory<Cell>& memory, Cell addr, Cell count);
+
+// COMPARE: -1, 0 or 1 as the `len1` bytes at `addr1` sort before, equal or
+// after the `len2` bytes at `addr2`, compared as unsigned bytes.
+template <typename Cell>
+Cell compareBytes(const CellMemory<Cell>& memory, Cell addr1, Cell len1, Cell addr2, Cell len2);
+
+// SEARCH: looks for the `len2` bytes at `addr2` in the `len1` bytes at
+// `addr`. If they are there, advances `addr` and shrinks `len` to the first
+// match and returns true; otherwise leaves both alone.
+template <typename Cell>
+bool searchBytes(const CellMemory<Cell>& memory, Cell& addr, Cell& len, Cell addr2, Cell len2);
+
+// SCAN: advances `addr` and shrinks `count` to the first of the `count`
+// cells at `addr` that equals `value`, or past them all when none does.
+template <typename Cell>
+void scanCells(const CellMemory<Cell>& memory, Cell& addr, Cell& count, Cell value);
+
+// V+, V- and V*: stores the sums, differences or products of the `count`
+// cells at `a` and `b`, cell by cell, in the `count` cells at `to`, which
+// may be `a` or `b`.
+template <typename Cell>
+void vectorAdd(CellMemory<Cell>& memory, Cell a, Cell b, Cell to, Cell count);
+template <typename Cell>
+void vectorSub(CellMemory<Cell>& memory, Cell a, Cell b, Cell to, Cell count);
+template <typename Cell>
+void vectorMul(CellMemory<Cell>& memory, Cell a, Cell b, Cell to, Cell count);
+
+// VSCALE: stores each of the `count` cells at `from` times `k` in the
+// `count` cells at `to`, which may be `from`.
+template <typename Cell>
+void vectorScale(CellMemory<Cell>& memory, Cell from, Cell to, Cell count, Cell k);
+
+// VSUM and VDOT: the sum of the `count` cells at `addr`, and the sum of
+// the products of the `count` cells at `a` and `b`.
+template <typename Cell>
+Cell vectorSum(const CellMemory<Cell>& memory, Cell addr, Cell count);
+template <typename Cell>
+Cell vectorDot(const CellMemory<Cell>& memory, Cell a, Cell b, Cell count);
+
+// VMIN and VMAX: the least and greatest of the `count` cells at `addr`;
+// `count` must be at least 1.
+template <typename Cell>
+Cell vectorMin(const CellMemory<Cell>& memory, Cell addr, Cell count);
+template <typename Cell>
+Cell vectorMax(const CellMemory<Cell>& memory, Cell addr, Cell count);
+
+#define PELI_DECLARE_BULK(Cell)                                                                           \
+    extern template void moveCells<Cell>(CellMemory<Cell>&, Cell, Cell, Cell);                            \
+    extern template void fillCells<Cell>(CellMemory<Cell>&, Cell, Cell, Cell);                            \
+    extern template void eraseCells<Cell>(CellMemory<Cell>&, Cell, Cell);                                 \
+    extern template Cell compareBytes<Cell>(const CellMemory<Cell>&, Cell, Cell, Cell, Cell);             \
+    extern template bool searchBytes<Cell>(const CellMemory<Cell>&, Cell&, Cell&, Cell, Cell);            \
+    extern template void scanCells<Cell>(const CellMemory<Cell>&, Cell&, Cell&, Cell);                    \
+    extern template void vectorAdd<Cell>(CellMemory<Cell>&, Cell, Cell, Cell, Cell);                      \
+    extern template void vectorSub<Cell>(CellMemory<Cell>&, Cell, Cell, Cell, Cell);                      \
+    extern template void vectorMul<Cell>(CellMemory<Cell>&, Cell, Cell, Cell, Cell);                      \
+    extern template void vectorScale<Cell>(CellMemory<Cell>&, Cell, Cell, Cell, Cell);                    \
+    extern template Cell vectorSum<Cell>(const CellMemory<Cell>&, Cell, Cell);                            \
+    extern template Cell vectorDot<Cell>(const CellMemory<Cell>&, Cell, Cell, Cell);                      \
+    extern template Cell vectorMin<Cell>(const CellMemory<Cell>&, Cell, Cell);                            \
+    extern template Cell vectorMax<Cell>(const CellMemory<Cell>&, Cell, Cell);
+PELI_CELL_TYPES(PELI_DECLARE_BULK)
+#undef PELI_DECLARE_BULK
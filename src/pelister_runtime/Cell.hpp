@@ -0,0 +1,189 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+// The cell types the library is built for. Every templated component is
+// explicitly instantiated for each entry in the translation unit that
+// defines it, and declared extern in its header.
+#define PELI_CELL_TYPES(X) \
+    X(double)              \
+    X(int64_t)             \
+    X(int32_t)
+
+template <typename Cell>
+struct CellTraits;
+
+template <>
+struct CellTraits<double> {
+    static constexpr const char* name = "f64";
+};
+
+template <>
+struct CellTraits<int64_t> {
+    static constexpr const char* name = "i64";
+};
+
+template <>
+struct CellTraits<int32_t> {
+    static constexpr const char* name = "i32";
+};
+
+template <typename Cell>
+constexpr bool cellIsInteger = std::is_integral_v<Cell>;
+
+// Integer cells wrap on overflow instead of invoking undefined behaviour.
+template <typename Cell>
+inline Cell cellAdd(Cell a, Cell b) {
+    if constexpr (cellIsInteger<Cell>) {
+        using U = std::make_unsigned_t<Cell>;
+        return static_cast<Cell>(static_cast<U>(a) + static_cast<U>(b));
+    } else {
+        return a + b;
+    }
+}
+
+template <typename Cell>
+inline Cell cellSub(Cell a, Cell b) {
+    if constexpr (cellIsInteger<Cell>) {
+        using U = std::make_unsigned_t<Cell>;
+        return static_cast<Cell>(static_cast<U>(a) - static_cast<U>(b));
+    } else {
+        return a - b;
+    }
+}
+
+template <typename Cell>
+inline Cell cellMul(Cell a, Cell b) {
+    if constexpr (cellIsInteger<Cell>) {
+        using U = std::make_unsigned_t<Cell>;
+        return static_cast<Cell>(static_cast<U>(a) * static_cast<U>(b));
+    } else {
+        return a * b;
+    }
+}
+
+// Callers reject a zero divisor before calling cellDiv or cellMod.
+template <typename Cell>
+inline Cell cellDiv(Cell a, Cell b) {
+    if constexpr (cellIsInteger<Cell>) {
+        if (b == -1) {
+            return cellSub<Cell>(0, a);
+        }
+    }
+    return a / b;
+}
+
+template <typename Cell>
+inline Cell cellMod(Cell a, Cell b) {
+    if constexpr (cellIsInteger<Cell>) {
+        return b == -1 ? 0 : a % b;
+    } else {
+        return std::fmod(a, b);
+    }
+}
+
+template <typename Cell>
+inline Cell cellAnd(Cell a, Cell b) {
+    if constexpr (cellIsInteger<Cell>) {
+        return a & b;
+    } else {
+        return static_cast<Cell>((long)a & (long)b);
+    }
+}
+
+template <typename Cell>
+inline Cell cellOr(Cell a, Cell b) {
+    if constexpr (cellIsInteger<Cell>) {
+        return a | b;
+    } else {
+        return static_cast<Cell>((long)a | (long)b);
+    }
+}
+
+// Converts a cell to an index into a region of `size` cells; false when the
+// address falls outside of it.
+template <typename Cell>
+inline bool cellToIndex(Cell addr, size_t size, size_t& index) {
+    if constexpr (cellIsInteger<Cell>) {
+        if (addr < 0 || static_cast<std::make_unsigned_t<Cell>>(addr) >= size) {
+            return false;
+        }
+    } else {
+        if (addr < 0 || addr >= size) {
+            return false;
+        }
+    }
+    index = static_cast<size_t>(addr);
+    return true;
+}
+
+// Converts an (addr, len) pair to a range of cells inside a region of `size`
+// cells; false when any part of it falls outside.
+template <typename Cell>
+inline bool cellToRange(Cell addr, Cell len, size_t size, size_t& begin, size_t& count) {
+    if (len < 0 || !cellToIndex(addr, size + 1, begin)) {
+        return false;
+    }
+    count = static_cast<size_t>(len);
+    return count <= size - begin;
+}
+
+// C!: the character a cell stores, its low eight bits.
+template <typename Cell>
+inline unsigned char cellToByte(Cell value) {
+    if constexpr (cellIsInteger<Cell>) {
+        return static_cast<unsigned char>(value);
+    } else {
+        return static_cast<unsigned char>((long)value);
+    }
+}
+
+// Converts a source literal to a cell; integer cells only accept integral
+// values that fit.
+template <typename Cell>
+inline bool cellFromLiteral(double value, Cell& out) {
+    if constexpr (cellIsInteger<Cell>) {
+        // max itself rounds up to a power of two as a double; -min is that
+        // same power of two, exactly, and the first value out of range.
+        if (value != std::trunc(value) ||
+            value < static_cast<double>(std::numeric_limits<Cell>::min()) ||
+            value >= -static_cast<double>(std::numeric_limits<Cell>::min())) {
+            return false;
+        }
+    }
+    out = static_cast<Cell>(value);
+    return true;
+}
+
+// Converts an integer literal; exact for integer cells it fits in.
+template <typename Cell>
+inline bool cellFromLiteral(int64_t value, Cell& out) {
+    if constexpr (cellIsInteger<Cell>) {
+        if (value < std::numeric_limits<Cell>::min() || value > std::numeric_limits<Cell>::max()) {
+            return false;
+        }
+    }
+    out = static_cast<Cell>(value);
+    return true;
+}
+
+// Parses text the way >NUMBER does; throws std::invalid_argument or
+// std::out_of_range on malformed input.
+template <typename Cell>
+inline Cell cellParse(const std::string& text) {
+    if constexpr (cellIsInteger<Cell>) {
+        long long value = std::stoll(text);
+        if (value < std::numeric_limits<Cell>::min() || value > std::numeric_limits<Cell>::max()) {
+            throw std::out_of_range(text);
+        }
+        return static_cast<Cell>(value);
+    } else {
+        return std::stod(text);
+    }
+}
@@ -0,0 +1,232 @@
+#include "Memory.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#if PELI_MMAP_AVAILABLE
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if PELI_MMAP_AVAILABLE
+namespace {
+
+int anonymousFlags() {
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+    flags |= MAP_NORESERVE;
+#endif
+    return flags;
+}
+
+#ifdef __linux__
+// The number of pages below `end`, a page of `base`, up to the last one the
+// OS has committed, present or swapped out, or SIZE_MAX when
+// /proc/self/pagemap cannot tell. Its entries are read downwards from `end`
+// a few thousand pages at a time, so only the unused top of a large memory
+// is looked at, and at a sixty-fourth of a byte per byte.
+size_t committedPages(const void* base, size_t end, size_t page) {
+    int fd = ::open("/proc/self/pagemap", O_RDONLY);
+    if (fd < 0) {
+        return std::numeric_limits<size_t>::max();
+    }
+    constexpr uint64_t kPresent = uint64_t(1) << 63;
+    constexpr uint64_t kSwapped = uint64_t(1) << 62;
+    size_t first = reinterpret_cast<uintptr_t>(base) / page;
+    uint64_t entries[4096];
+    while (end > 0) {
+        size_t n = std::min<size_t>(end, 4096);
+        size_t bytes = n * sizeof(uint64_t);
+        if (::pread(fd, entries, bytes, static_cast<off_t>((first + end - n) * sizeof(uint64_t))) !=
+            static_cast<ssize_t>(bytes)) {
+            ::close(fd);
+            return std::numeric_limits<size_t>::max();
+        }
+        for (size_t i = n; i > 0; --i) {
+            if (entries[i - 1] & (kPresent | kSwapped)) {
+                ::close(fd);
+                return end - n + i;
+            }
+        }
+        end -= n;
+    }
+    ::close(fd);
+    return 0;
+}
+#endif
+
+} // namespace
+#endif
+
+template <typename Cell>
+CellMemory<Cell>::CellMemory(size_t cells, bool huge_pages) : count(cells), store_limit(cells) {
+    if (cells == 0 || cells > std::numeric_limits<size_t>::max() / sizeof(Cell)) {
+        throw std::runtime_error("Memory of " + std::to_string(cells) + " cells is not supported");
+    }
+    size_t bytes = cells * sizeof(Cell);
+#if PELI_MMAP_AVAILABLE
+    if (bytes >= kMappedMemoryBytes) {
+        void* pages = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, anonymousFlags(), -1, 0);
+        if (pages == MAP_FAILED) {
+            throw std::runtime_error("Could not reserve " + std::to_string(bytes) + " bytes of memory");
+        }
+#ifdef MADV_HUGEPAGE
+        if (huge_pages) {
+            ::madvise(pages, bytes, MADV_HUGEPAGE);
+        }
+#endif
+        this->cells = static_cast<Cell*>(pages);
+        mapping = true;
+        return;
+    }
+#endif
+    (void)huge_pages;
+    try {
+        owned.reset(new Cell[cells]());
+    } catch (const std::bad_alloc&) {
+        throw std::runtime_error("Could not allocate " + std::to_string(bytes) + " bytes of memory");
+    }
+    this->cells = owned.get();
+}
+
+template <typename Cell>
+CellMemory<Cell>::~CellMemory() {
+#if PELI_MMAP_AVAILABLE
+    if (mapping) {
+        ::munmap(cells, count * sizeof(Cell));
+    }
+#endif
+}
+
+template <typename Cell>
+size_t CellMemory<Cell>::used() const {
+    size_t used = count;
+#if PELI_MMAP_AVAILABLE && defined(__linux__)
+    if (mapping) {
+        size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        size_t pages = committedPages(cells, (count * sizeof(Cell) + page - 1) / page, page);
+        used = std::min(used, pages == std::numeric_limits<size_t>::max() ? count : pages * page / sizeof(Cell));
+    }
+#endif
+    while (used > 0 && cells[used - 1] == 0) {
+        --used;
+    }
+    return used;
+}
+
+template <typename Cell>
+void CellMemory<Cell>::clear() {
+    while (!mapped_files.empty()) {
+        unmapFile(mapped_files.back().base);
+    }
+#if PELI_MMAP_AVAILABLE && defined(MADV_DONTNEED) && defined(__linux__)
+    // Private anonymous pages read back as zero once dropped.
+    if (mapping && ::madvise(cells, count * sizeof(Cell), MADV_DONTNEED) == 0) {
+        return;
+    }
+#endif
+    std::fill(cells, cells + count, Cell(0));
+}
+
+template <typename Cell>
+MappedFile CellMemory<Cell>::mapFile(const std::string& path, MapMode mode) {
+#if PELI_MMAP_AVAILABLE
+    if (!mapping) {
+        throw std::runtime_error("Files can only be mapped into memory of at least " +
+                                 std::to_string(kMappedMemoryBytes) + " bytes");
+    }
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open file '" + path + "'");
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || static_cast<size_t>(info.st_size) < sizeof(Cell)) {
+        ::close(fd);
+        throw std::runtime_error("File '" + path + "' holds no cells to map");
+    }
+    size_t size = static_cast<size_t>(info.st_size);
+    size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    size_t bytes = (size + page - 1) / page * page;
+
+    // The highest gap between files, below the last whole page of memory,
+    // that the file fits in.
+    size_t top = count * sizeof(Cell) / page * page;
+    auto next = mapped_files.begin();
+    for (; next != mapped_files.end(); ++next) {
+        size_t end = next->base * sizeof(Cell) + next->bytes;
+        if (top - end >= bytes) {
+            break;
+        }
+        top = next->base * sizeof(Cell);
+    }
+    if (top < bytes) {
+        ::close(fd);
+        throw std::runtime_error("No room in memory to map '" + path + "'");
+    }
+    size_t start = top - bytes;
+
+    // Read-only files share the page cache; copy-on-write ones get private
+    // copies of the pages they store to.
+    int prot = mode == MapMode::ReadOnly ? PROT_READ : PROT_READ | PROT_WRITE;
+    int flags = (mode == MapMode::ReadOnly ? MAP_SHARED : MAP_PRIVATE) | MAP_FIXED;
+    void* view = ::mmap(reinterpret_cast<char*>(cells) + start, bytes, prot, flags, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        throw std::runtime_error("Could not map file '" + path + "'");
+    }
+
+    MappedFile file{start / sizeof(Cell), size / sizeof(Cell), bytes, mode};
+    mapped_files.insert(next, file);
+    updateStoreLimit();
+    return file;
+#else
+    (void)path;
+    (void)mode;
+    throw std::runtime_error("Files cannot be mapped into memory on this platform");
+#endif
+}
+
+template <typename Cell>
+void CellMemory<Cell>::unmapFile(size_t base) {
+    auto file = std::find_if(mapped_files.begin(), mapped_files.end(),
+                             [base](const MappedFile& f) { return f.base == base; });
+    if (file == mapped_files.end()) {
+        throw std::runtime_error("No file is mapped at " + std::to_string(base));
+    }
+#if PELI_MMAP_AVAILABLE
+    void* pages = reinterpret_cast<char*>(cells) + file->base * sizeof(Cell);
+    if (::mmap(pages, file->bytes, PROT_READ | PROT_WRITE, anonymousFlags() | MAP_FIXED, -1, 0) == MAP_FAILED) {
+        throw std::runtime_error("Could not unmap the file at " + std::to_string(base));
+    }
+#endif
+    mapped_files.erase(file);
+    updateStoreLimit();
+}
+
+template <typename Cell>
+bool CellMemory<Cell>::writableSlow(size_t begin, size_t count) const {
+    for (const MappedFile& file : mapped_files) {
+        size_t start = file.base * sizeof(Cell);
+        if (file.mode == MapMode::ReadOnly && begin < start + file.bytes && start < begin + count) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename Cell>
+void CellMemory<Cell>::updateStoreLimit() {
+    store_limit = count;
+    for (const MappedFile& file : mapped_files) {
+        if (file.mode == MapMode::ReadOnly) {
+            store_limit = std::min(store_limit, file.base);
+        }
+    }
+}
+
+#define PELI_INSTANTIATE_MEMORY(Cell) template class CellMemory<Cell>;
+PELI_CELL_TYPES(PELI_INSTANTIATE_MEMORY)
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "Cell.hpp"
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define PELI_MMAP_AVAILABLE 1
+#else
+#define PELI_MMAP_AVAILABLE 0
+#endif
+
+// Cells of memory addressable with @ and ! unless configured otherwise.
+constexpr size_t kMemoryCells = 64 * 1024;
+
+// Memory of at least this many bytes is reserved from the OS rather than
+// allocated and zeroed up front.
+constexpr size_t kMappedMemoryBytes = 64 * 1024;
+
+// What a failed memory access reports.
+constexpr const char* kOutOfBounds = "Memory access out of bounds";
+constexpr const char* kReadOnlyStore = "Store into read-only memory";
+
+// How MAP-FILE maps a file: read-only, so that stores into it fail, or
+// copy-on-write, so that stores change what the program sees of it but never
+// the file itself.
+enum class MapMode { ReadOnly = 0, CopyOnWrite = 1 };
+
+// A file mapped into memory: `cells` cells of it from cell `base`, in a range
+// of `bytes` bytes (whole pages) that belongs to the file.
+struct MappedFile {
+    size_t base;
+    size_t cells;
+    size_t bytes;
+    MapMode mode;
+};
+
+// The data space of a program: a fixed number of zeroed cells. Where the
+// platform allows, anything but a small space is an anonymous mapping whose
+// pages the OS commits, already zeroed, the first time they are touched, so
+// a program only pays for the memory it uses and sizes of many gigabytes
+// cost nothing until then. `huge_pages` asks for transparent huge pages on
+// such a mapping, which the OS may or may not grant.
+template <typename Cell>
+class CellMemory {
+public:
+    // Throws std::runtime_error when the memory cannot be had.
+    explicit CellMemory(size_t cells = kMemoryCells, bool huge_pages = false);
+    ~CellMemory();
+    CellMemory(const CellMemory&) = delete;
+    CellMemory& operator=(const CellMemory&) = delete;
+
+    Cell* data() { return cells; }
+    const Cell* data() const { return cells; }
+    size_t size() const { return count; }
+    bool mapped() const { return mapping; }
+
+    Cell& operator[](size_t index) { return cells[index]; }
+    const Cell& operator[](size_t index) const { return cells[index]; }
+
+    // How many cells there are up to the last nonzero one. Pages the OS has
+    // never committed read as zero and are skipped without touching them,
+    // so this costs little more than the memory in use.
+    size_t used() const;
+
+    // Zeroes every cell and unmaps every file; a mapping hands its pages
+    // back to the OS instead of writing them.
+    void clear();
+
+    // Maps the file at `path` over the highest free page-aligned range of
+    // memory, so that its cells are read and written in place, and returns
+    // where it went. Whatever the range held is replaced. Throws
+    // std::runtime_error when memory is not a mapping, the file cannot be
+    // mapped or no free range is large enough.
+    MappedFile mapFile(const std::string& path, MapMode mode);
+    // Turns the range of the file mapped at cell `base` back into zeroed
+    // memory. Throws std::runtime_error when no file is mapped there.
+    void unmapFile(size_t base);
+    const std::vector<MappedFile>& files() const { return mapped_files; }
+
+    // Cells below this are never in a read-only file, so a store to them
+    // needs no check but its bounds.
+    size_t storeLimit() const { return store_limit; }
+    const size_t* storeLimitAddress() const { return &store_limit; }
+    // Whether the `count` bytes from byte `begin`, all in memory, may be
+    // stored to: false when any of them is in a read-only file.
+    bool writable(size_t begin, size_t count) const {
+        return begin + count <= store_limit * sizeof(Cell) || writableSlow(begin, count);
+    }
+
+private:
+    bool writableSlow(size_t begin, size_t count) const;
+    void updateStoreLimit();
+
+    Cell* cells = nullptr;
+    size_t count = 0;
+    bool mapping = false;
+    size_t store_limit = 0;
+    // By descending base.
+    std::vector<MappedFile> mapped_files;
+    // Holds the cells when they are not mapped.
+    std::unique_ptr<Cell[]> owned;
+};
+
+#define PELI_DECLARE_MEMORY(Cell) extern template class CellMemory<Cell>;
+PELI_CELL_TYPES(PELI_DECLARE_MEMORY)
+#undef PELI_DECLARE_MEMORY
@@ -0,0 +1,133 @@
+#include "Runtime.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+template <typename Cell>
+void printCells(const Cell* begin, const Cell* end) {
+    std::cout << "<stack bottom> ";
+    for (const Cell* cell = begin; cell < end; ++cell) {
+        std::cout << *cell << " ";
+    }
+    std::cout << "<top>" << std::endl;
+}
+
+template <typename Cell>
+Cell acceptLine(CellMemory<Cell>& memory, Cell addr, Cell max_len) {
+    size_t begin, count;
+    if (!cellToRange(addr, max_len, memory.size() * sizeof(Cell), begin, count)) {
+        throw std::runtime_error("ACCEPT memory out of bounds");
+    }
+    if (!memory.writable(begin, count)) {
+        throw std::runtime_error("ACCEPT into read-only memory");
+    }
+
+    std::string input_line;
+    std::getline(std::cin, input_line);
+
+    size_t actual_len = std::min(count, input_line.length());
+    std::memcpy(reinterpret_cast<char*>(memory.data()) + begin, input_line.data(), actual_len);
+    return static_cast<Cell>(actual_len);
+}
+
+template <typename Cell>
+Cell numberFromMemory(const CellMemory<Cell>& memory, Cell addr, Cell len) {
+    size_t begin, count;
+    if (!cellToRange(addr, len, memory.size() * sizeof(Cell), begin, count)) {
+        throw std::runtime_error(">NUMBER memory out of bounds");
+    }
+
+    std::string str_to_convert(reinterpret_cast<const char*>(memory.data()) + begin, count);
+
+    try {
+        return cellParse<Cell>(str_to_convert);
+    } catch (const std::exception&) {
+        throw std::runtime_error("Invalid number format for >NUMBER");
+    }
+}
+
+template <typename Cell>
+void typeBytes(const CellMemory<Cell>& memory, Cell addr, Cell len) {
+    size_t begin, count;
+    if (!cellToRange(addr, len, memory.size() * sizeof(Cell), begin, count)) {
+        throw std::runtime_error("TYPE memory out of bounds");
+    }
+    std::cout.write(reinterpret_cast<const char*>(memory.data()) + begin, static_cast<std::streamsize>(count));
+}
+
+template <typename Cell>
+void mapFileInto(CellMemory<Cell>& memory, Cell addr, Cell len, Cell mode, Cell& base, Cell& cells) {
+    size_t begin, count;
+    if (!cellToRange(addr, len, memory.size() * sizeof(Cell), begin, count)) {
+        throw std::runtime_error("MAP-FILE memory out of bounds");
+    }
+    if (mode != 0 && mode != 1) {
+        throw std::runtime_error("MAP-FILE mode must be 0 (read-only) or 1 (copy-on-write)");
+    }
+    std::string path(reinterpret_cast<const char*>(memory.data()) + begin, count);
+    MappedFile file = memory.mapFile(path, mode == 0 ? MapMode::ReadOnly : MapMode::CopyOnWrite);
+    base = static_cast<Cell>(file.base);
+    cells = static_cast<Cell>(file.cells);
+}
+
+template <typename Cell>
+void unmapFileAt(CellMemory<Cell>& memory, Cell base) {
+    size_t index;
+    if (!cellToIndex(base, memory.size(), index)) {
+        throw std::runtime_error("No file is mapped at that address");
+    }
+    memory.unmapFile(index);
+}
+
+template <typename Cell>
+BasicProgram<Cell>::BasicProgram(size_t data_stack_depth, size_t return_stack_depth, size_t call_depth,
+                                 size_t memory_cells, bool huge_pages)
+    : stack(data_stack_depth, "Stack"),
+      return_stack(return_stack_depth, "Return stack"),
+      memory(memory_cells, huge_pages),
+      call_depth(call_depth) {
+}
+
+template <typename Cell>
+int BasicProgram<Cell>::run(Word body) {
+    try {
+        stack.top = body(stack.top);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << "Program finished. Final stack state:" << std::endl;
+    printCells<Cell>(stack.begin(), stack.end());
+    return 0;
+}
+
+template <typename Cell>
+Cell BasicProgram<Cell>::loopIndex(size_t level) const {
+    if (loops.size() < level) {
+        fail(level == 1 ? "'I' can only be used inside a DO...LOOP"
+             : level == 2 ? "'J' can only be used inside nested DO...LOOPs"
+                          : "'K' can only be used inside triply-nested DO...LOOPs");
+    }
+    return static_cast<Cell>(*loops[loops.size() - level]);
+}
+
+template <typename Cell>
+void BasicProgram<Cell>::fail(const char* message) {
+    throw std::runtime_error(message);
+}
+
+template <typename Cell>
+void BasicProgram<Cell>::unknown(const char* name) {
+    throw std::runtime_error(std::string("Unknown word: ") + name);
+}
+
+#define PELI_INSTANTIATE_RUNTIME(Cell)                                                 \
+    template void printCells<Cell>(const Cell*, const Cell*);                          \
+    template Cell acceptLine<Cell>(CellMemory<Cell>&, Cell, Cell);                     \
+    template Cell numberFromMemory<Cell>(const CellMemory<Cell>&, Cell, Cell);         \
+    template void typeBytes<Cell>(const CellMemory<Cell>&, Cell, Cell);                \
+    template void mapFileInto<Cell>(CellMemory<Cell>&, Cell, Cell, Cell, Cell&, Cell&); \
+    template void unmapFileAt<Cell>(CellMemory<Cell>&, Cell);                          \
+    template class BasicProgram<Cell>;
+PELI_CELL_TYPES(PELI_INSTANTIATE_RUNTIME)
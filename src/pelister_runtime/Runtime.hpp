@@ -0,0 +1,222 @@
+#pragma once
+
+#include "Bulk.hpp"
+#include "Cell.hpp"
+#include "Memory.hpp"
+#include "Stack.hpp"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// The primitives shared by the interpreter and by programs compiled ahead of
+// time with --emit-cpp. This library has no dependency on the lexer, parser
+// or compiler, so compiled programs only link against it.
+
+// C@, C!, ACCEPT, >NUMBER and TYPE address the same memory by the byte:
+// byte n is byte n % sizeof(Cell) of cell n / sizeof(Cell), in the
+// machine's byte order. Returns null when `addr` is outside memory.
+template <typename Cell>
+inline unsigned char* byteAt(CellMemory<Cell>& memory, Cell addr) {
+    size_t index;
+    if (!cellToIndex(addr, memory.size() * sizeof(Cell), index)) {
+        return nullptr;
+    }
+    return reinterpret_cast<unsigned char*>(memory.data()) + index;
+}
+
+// !: the cell at `addr`, or null with `error` saying why when it is outside
+// memory or in a file mapped read-only. Only stores at or above the store
+// limit look any further than the bounds.
+template <typename Cell>
+inline Cell* cellForStore(CellMemory<Cell>& memory, Cell addr, const char*& error) {
+    size_t index;
+    if (cellToIndex(addr, memory.storeLimit(), index)) {
+        return memory.data() + index;
+    }
+    if (!cellToIndex(addr, memory.size(), index)) {
+        error = kOutOfBounds;
+        return nullptr;
+    }
+    if (!memory.writable(index * sizeof(Cell), sizeof(Cell))) {
+        error = kReadOnlyStore;
+        return nullptr;
+    }
+    return memory.data() + index;
+}
+
+// C!: the byte at `addr`, or null as for cellForStore.
+template <typename Cell>
+inline unsigned char* byteForStore(CellMemory<Cell>& memory, Cell addr, const char*& error) {
+    size_t index;
+    if (cellToIndex(addr, memory.storeLimit() * sizeof(Cell), index)) {
+        return reinterpret_cast<unsigned char*>(memory.data()) + index;
+    }
+    if (!cellToIndex(addr, memory.size() * sizeof(Cell), index)) {
+        error = kOutOfBounds;
+        return nullptr;
+    }
+    if (!memory.writable(index, 1)) {
+        error = kReadOnlyStore;
+        return nullptr;
+    }
+    return reinterpret_cast<unsigned char*>(memory.data()) + index;
+}
+
+// Advances a loop index by a +LOOP step; false once the index crosses the
+// boundary between limit - 1 and limit, in either direction.
+inline bool loopStep(long& index, long limit, long step) {
+    unsigned long before = static_cast<unsigned long>(index) - static_cast<unsigned long>(limit);
+    unsigned long after = before + static_cast<unsigned long>(step);
+    index = static_cast<long>(static_cast<unsigned long>(index) + static_cast<unsigned long>(step));
+    return static_cast<long>(before ^ after) >= 0;
+}
+
+// .S: prints the cells in [begin, end), bottom first.
+template <typename Cell>
+void printCells(const Cell* begin, const Cell* end);
+
+// ACCEPT: reads a line from standard input into the bytes at `addr`, keeping
+// at most `max_len` characters; returns how many were stored.
+template <typename Cell>
+Cell acceptLine(CellMemory<Cell>& memory, Cell addr, Cell max_len);
+
+// >NUMBER: parses the `len` characters stored in the bytes at `addr`.
+template <typename Cell>
+Cell numberFromMemory(const CellMemory<Cell>& memory, Cell addr, Cell len);
+
+// TYPE: writes the `len` bytes at `addr` to standard output.
+template <typename Cell>
+void typeBytes(const CellMemory<Cell>& memory, Cell addr, Cell len);
+
+// MAP-FILE: maps the file named by the `len` bytes at `addr` into memory,
+// read-only for `mode` 0 and copy-on-write for 1; sets `base` to its first
+// cell and `cells` to how many cells it holds.
+template <typename Cell>
+void mapFileInto(CellMemory<Cell>& memory, Cell addr, Cell len, Cell mode, Cell& base, Cell& cells);
+
+// UNMAP: unmaps the file MAP-FILE mapped at cell `base`.
+template <typename Cell>
+void unmapFileAt(CellMemory<Cell>& memory, Cell base);
+
+// The machine a program compiled by --emit-cpp runs on. Compiled words take
+// and return the data stack pointer, which points at the top cell; the
+// checks and helpers below raise the same errors as the interpreter.
+template <typename Cell>
+class BasicProgram {
+public:
+    using Word = Cell* (*)(Cell*);
+
+    BasicProgram(size_t data_stack_depth, size_t return_stack_depth, size_t call_depth,
+                 size_t memory_cells = kMemoryCells, bool huge_pages = false);
+
+    // Runs `body` on an empty stack and reports the outcome the way pelilang
+    // does. Returns the process exit status.
+    int run(Word body);
+
+    Cell* base() const { return stack.base; }
+
+    // Fails unless `need` cells are on the stack and `grow` more fit.
+    void check(const Cell* sp, int need, int grow) const {
+        ptrdiff_t depth = sp - stack.base + 1;
+        if (depth < need) fail("Stack underflow");
+        if (depth + grow > static_cast<ptrdiff_t>(stack.capacity())) fail("Stack overflow");
+    }
+
+    Cell at(Cell addr) const {
+        size_t index;
+        if (!cellToIndex(addr, memory.size(), index)) fail(kOutOfBounds);
+        return memory[index];
+    }
+    Cell& storeAt(Cell addr) {
+        const char* error = nullptr;
+        Cell* cell = cellForStore(memory, addr, error);
+        if (!cell) fail(error);
+        return *cell;
+    }
+    unsigned char byte(Cell addr) {
+        unsigned char* byte = byteAt(memory, addr);
+        if (!byte) fail(kOutOfBounds);
+        return *byte;
+    }
+    unsigned char& storeByte(Cell addr) {
+        const char* error = nullptr;
+        unsigned char* byte = byteForStore(memory, addr, error);
+        if (!byte) fail(error);
+        return *byte;
+    }
+
+    void toR(Cell value) { return_stack.push(value); }
+    Cell fromR() { return return_stack.pop(); }
+    Cell fetchR() const { return return_stack.peek(); }
+
+    // Calls a word through its binding; `name` is reported if it is unbound.
+    Cell* call(Word word, const char* name, Cell* sp) {
+        if (!word) unknown(name);
+        if (depth >= call_depth) fail("Call stack overflow");
+        ++depth;
+        sp = word(sp);
+        --depth;
+        return sp;
+    }
+    // A call in tail position takes no frame, so the C++ compiler can turn
+    // it into a jump.
+    Cell* tailCall(Word word, const char* name, Cell* sp) {
+        if (!word) unknown(name);
+        return word(sp);
+    }
+
+    void printStack(const Cell* sp) const { printCells<Cell>(stack.base, sp + 1); }
+    Cell accept(Cell addr, Cell max_len) { return acceptLine(memory, addr, max_len); }
+    Cell toNumber(Cell addr, Cell len) const { return numberFromMemory(memory, addr, len); }
+    void type(Cell addr, Cell len) const { typeBytes(memory, addr, len); }
+    void mapFile(Cell addr, Cell len, Cell mode, Cell& base, Cell& cells) {
+        mapFileInto(memory, addr, len, mode, base, cells);
+    }
+    void unmapFile(Cell base) { unmapFileAt(memory, base); }
+    void move(Cell from, Cell to, Cell count) { moveCells(memory, from, to, count); }
+    void fill(Cell addr, Cell count, Cell value) { fillCells(memory, addr, count, value); }
+    void erase(Cell addr, Cell count) { eraseCells(memory, addr, count); }
+    Cell compare(Cell addr1, Cell len1, Cell addr2, Cell len2) const {
+        return compareBytes(memory, addr1, len1, addr2, len2);
+    }
+    Cell search(Cell& addr, Cell& len, Cell addr2, Cell len2) const {
+        return searchBytes(memory, addr, len, addr2, len2) ? 1 : 0;
+    }
+    void scan(Cell& addr, Cell& count, Cell value) const { scanCells(memory, addr, count, value); }
+    void vectorAdd(Cell a, Cell b, Cell to, Cell count) { ::vectorAdd(memory, a, b, to, count); }
+    void vectorSub(Cell a, Cell b, Cell to, Cell count) { ::vectorSub(memory, a, b, to, count); }
+    void vectorMul(Cell a, Cell b, Cell to, Cell count) { ::vectorMul(memory, a, b, to, count); }
+    void vectorScale(Cell from, Cell to, Cell count, Cell k) { ::vectorScale(memory, from, to, count, k); }
+    Cell vectorSum(Cell addr, Cell count) const { return ::vectorSum(memory, addr, count); }
+    Cell vectorDot(Cell a, Cell b, Cell count) const { return ::vectorDot(memory, a, b, count); }
+    Cell vectorMin(Cell addr, Cell count) const { return ::vectorMin(memory, addr, count); }
+    Cell vectorMax(Cell addr, Cell count) const { return ::vectorMax(memory, addr, count); }
+
+    // Loops register their index only when some I, J or K reads it from
+    // outside the loop's own definition.
+    void enterLoop(const long* index) { loops.push_back(index); }
+    void leaveLoop() { loops.pop_back(); }
+    Cell loopIndex(size_t level) const;
+
+    [[noreturn]] static void fail(const char* message);
+    [[noreturn]] static void unknown(const char* name);
+
+private:
+    CellStack<Cell> stack;
+    CellStack<Cell> return_stack;
+    CellMemory<Cell> memory;
+    std::vector<const long*> loops;
+    size_t call_depth;
+    size_t depth = 0;
+};
+
+#define PELI_DECLARE_RUNTIME(Cell)                                                            \
+    extern template void printCells<Cell>(const Cell*, const Cell*);                          \
+    extern template Cell acceptLine<Cell>(CellMemory<Cell>&, Cell, Cell);                     \
+    extern template Cell numberFromMemory<Cell>(const CellMemory<Cell>&, Cell, Cell);         \
+    extern template void typeBytes<Cell>(const CellMemory<Cell>&, Cell, Cell);                \
+    extern template void mapFileInto<Cell>(CellMemory<Cell>&, Cell, Cell, Cell, Cell&, Cell&); \
+    extern template void unmapFileAt<Cell>(CellMemory<Cell>&, Cell);                          \
+    extern template class BasicProgram<Cell>;
+PELI_CELL_TYPES(PELI_DECLARE_RUNTIME)
+#undef PELI_DECLARE_RUNTIME
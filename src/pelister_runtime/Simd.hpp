@@ -0,0 +1,10 @@
+#pragma once
+
+// x86-64 SIMD code is compiled in where the compiler can target it: SSE2,
+// which every x86-64 CPU has, and AVX2 behind a run-time check of the CPU.
+// Elsewhere only the scalar code paths exist.
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define PELI_SIMD_X86 1
+#else
+#define PELI_SIMD_X86 0
+#endif
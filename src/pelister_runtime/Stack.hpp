@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// A preallocated stack of cells. `top` points at the topmost cell, or one
+// below `base` when the stack is empty. A guard region on either side lets
+// the VM keep the top cell in a register and touch the slot just outside the
+// live range without going out of bounds.
+template <typename Cell>
+class CellStack {
+public:
+    static constexpr size_t guard = 8;
+
+    CellStack(size_t capacity, const char* name)
+        : cells(new Cell[capacity + 2 * guard]()), capacity_(capacity), name(name) {
+        base = cells.get() + guard;
+        top = base - 1;
+    }
+
+    size_t capacity() const { return capacity_; }
+    size_t depth() const { return static_cast<size_t>(top + 1 - base); }
+    bool empty() const { return top < base; }
+    void clear() { top = base - 1; }
+
+    void push(Cell value) {
+        if (depth() >= capacity_) {
+            throw std::runtime_error(std::string(name) + " overflow");
+        }
+        *++top = value;
+    }
+
+    Cell pop() {
+        if (empty()) {
+            throw std::runtime_error(std::string(name) + " underflow");
+        }
+        return *top--;
+    }
+
+    Cell peek() const {
+        if (empty()) {
+            throw std::runtime_error(std::string(name) + " underflow");
+        }
+        return *top;
+    }
+
+    const Cell* begin() const { return base; }
+    const Cell* end() const { return top + 1; }
+    std::vector<Cell> snapshot() const { return std::vector<Cell>(begin(), end()); }
+
+    Cell* base;
+    Cell* top;
+
+private:
+    std::unique_ptr<Cell[]> cells;
+    size_t capacity_;
+    const char* name;
+};
@@ -0,0 +1,337 @@
+#include "Vector.hpp"
+#include <algorithm>
+
+#if PELI_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Cells per 32-byte block: one AVX2 register.
+template <typename Cell>
+constexpr size_t kLanes = 32 / sizeof(Cell);
+
+enum class Op { Add, Sub, Mul, Min, Max };
+
+// `x` folded into `acc`. Min and Max keep `acc` unless `x` is strictly
+// beyond it, the way the AVX2 min and max instructions treat NaN.
+template <Op op, typename Cell>
+inline Cell apply(Cell acc, Cell x) {
+    if constexpr (op == Op::Add) {
+        return cellAdd(acc, x);
+    } else if constexpr (op == Op::Sub) {
+        return cellSub(acc, x);
+    } else if constexpr (op == Op::Mul) {
+        return cellMul(acc, x);
+    } else if constexpr (op == Op::Min) {
+        return x < acc ? x : acc;
+    } else {
+        return x > acc ? x : acc;
+    }
+}
+
+// Folds the lanes of a reduction pairwise, halves first.
+template <Op op, typename Cell>
+Cell combine(Cell* lanes) {
+    for (size_t width = kLanes<Cell> / 2; width > 0; width /= 2) {
+        for (size_t k = 0; k < width; ++k) {
+            lanes[k] = apply<op>(lanes[k], lanes[k + width]);
+        }
+    }
+    return lanes[0];
+}
+
+template <Op op, typename Cell>
+void zipScalar(const Cell* a, const Cell* b, Cell* out, size_t n) {
+    constexpr size_t L = kLanes<Cell>;
+    size_t i = 0;
+    for (; i + L <= n; i += L) {
+        Cell block[L];
+        for (size_t k = 0; k < L; ++k) {
+            block[k] = apply<op>(a[i + k], b[i + k]);
+        }
+        std::copy(block, block + L, out + i);
+    }
+    for (; i < n; ++i) {
+        out[i] = apply<op>(a[i], b[i]);
+    }
+}
+
+template <typename Cell>
+void scaleScalar(const Cell* a, Cell* out, size_t n, Cell k) {
+    constexpr size_t L = kLanes<Cell>;
+    size_t i = 0;
+    for (; i + L <= n; i += L) {
+        Cell block[L];
+        for (size_t j = 0; j < L; ++j) {
+            block[j] = cellMul(a[i + j], k);
+        }
+        std::copy(block, block + L, out + i);
+    }
+    for (; i < n; ++i) {
+        out[i] = cellMul(a[i], k);
+    }
+}
+
+// Lane k of `lanes` takes the cells at k, k + L, k + 2L and so on.
+template <Op op, typename Cell>
+Cell foldScalar(Cell* lanes, const Cell* a, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        lanes[i % kLanes<Cell>] = apply<op>(lanes[i % kLanes<Cell>], a[i]);
+    }
+    return combine<op>(lanes);
+}
+
+template <typename Cell>
+Cell dotScalar(Cell* lanes, const Cell* a, const Cell* b, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        lanes[i % kLanes<Cell>] = cellAdd(lanes[i % kLanes<Cell>], cellMul(a[i], b[i]));
+    }
+    return combine<Op::Add>(lanes);
+}
+
+template <typename Cell>
+void addScalar(const Cell* a, const Cell* b, Cell* out, size_t n) {
+    zipScalar<Op::Add>(a, b, out, n);
+}
+
+template <typename Cell>
+void subScalar(const Cell* a, const Cell* b, Cell* out, size_t n) {
+    zipScalar<Op::Sub>(a, b, out, n);
+}
+
+template <typename Cell>
+void mulScalar(const Cell* a, const Cell* b, Cell* out, size_t n) {
+    zipScalar<Op::Mul>(a, b, out, n);
+}
+
+template <typename Cell>
+Cell sumScalar(const Cell* a, size_t n) {
+    Cell lanes[kLanes<Cell>] = {};
+    return foldScalar<Op::Add>(lanes, a, n);
+}
+
+template <typename Cell>
+Cell dotProductScalar(const Cell* a, const Cell* b, size_t n) {
+    Cell lanes[kLanes<Cell>] = {};
+    return dotScalar(lanes, a, b, n);
+}
+
+template <typename Cell>
+Cell minScalar(const Cell* a, size_t n) {
+    Cell lanes[kLanes<Cell>];
+    std::fill_n(lanes, kLanes<Cell>, a[0]);
+    return foldScalar<Op::Min>(lanes, a, n);
+}
+
+template <typename Cell>
+Cell maxScalar(const Cell* a, size_t n) {
+    Cell lanes[kLanes<Cell>];
+    std::fill_n(lanes, kLanes<Cell>, a[0]);
+    return foldScalar<Op::Max>(lanes, a, n);
+}
+
+template <typename Cell>
+constexpr VectorKernels<Cell> scalarKernels{"scalar",        addScalar<Cell>, subScalar<Cell>,
+                                            mulScalar<Cell>, scaleScalar<Cell>, sumScalar<Cell>,
+                                            dotProductScalar<Cell>, minScalar<Cell>, maxScalar<Cell>};
+
+#if PELI_SIMD_X86
+
+#define PELI_AVX2 __attribute__((target("avx2")))
+
+// One 32-byte register of cells and the operations on it.
+template <typename Cell>
+struct Avx2;
+
+template <>
+struct Avx2<double> {
+    using V = __m256d;
+    PELI_AVX2 static V load(const double* p) { return _mm256_loadu_pd(p); }
+    PELI_AVX2 static void store(double* p, V v) { _mm256_storeu_pd(p, v); }
+    PELI_AVX2 static V splat(double x) { return _mm256_set1_pd(x); }
+
+    template <Op op>
+    PELI_AVX2 static V apply(V acc, V x) {
+        if constexpr (op == Op::Add) {
+            return _mm256_add_pd(acc, x);
+        } else if constexpr (op == Op::Sub) {
+            return _mm256_sub_pd(acc, x);
+        } else if constexpr (op == Op::Mul) {
+            return _mm256_mul_pd(acc, x);
+        } else if constexpr (op == Op::Min) {
+            return _mm256_min_pd(x, acc);
+        } else {
+            return _mm256_max_pd(x, acc);
+        }
+    }
+};
+
+template <>
+struct Avx2<int64_t> {
+    using V = __m256i;
+    PELI_AVX2 static V load(const int64_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+    PELI_AVX2 static void store(int64_t* p, V v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+    PELI_AVX2 static V splat(int64_t x) { return _mm256_set1_epi64x(x); }
+
+    template <Op op>
+    PELI_AVX2 static V apply(V acc, V x) {
+        if constexpr (op == Op::Add) {
+            return _mm256_add_epi64(acc, x);
+        } else if constexpr (op == Op::Sub) {
+            return _mm256_sub_epi64(acc, x);
+        } else if constexpr (op == Op::Mul) {
+            // AVX2 has no 64-bit multiply; the low 64 bits of the product
+            // are lo * lo plus the two cross products shifted up.
+            V low = _mm256_mul_epu32(acc, x);
+            V cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(acc, 32), x),
+                                       _mm256_mul_epu32(acc, _mm256_srli_epi64(x, 32)));
+            return _mm256_add_epi64(low, _mm256_slli_epi64(cross, 32));
+        } else if constexpr (op == Op::Min) {
+            return _mm256_blendv_epi8(acc, x, _mm256_cmpgt_epi64(acc, x));
+        } else {
+            return _mm256_blendv_epi8(acc, x, _mm256_cmpgt_epi64(x, acc));
+        }
+    }
+};
+
+template <>
+struct Avx2<int32_t> {
+    using V = __m256i;
+    PELI_AVX2 static V load(const int32_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+    PELI_AVX2 static void store(int32_t* p, V v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+    PELI_AVX2 static V splat(int32_t x) { return _mm256_set1_epi32(x); }
+
+    template <Op op>
+    PELI_AVX2 static V apply(V acc, V x) {
+        if constexpr (op == Op::Add) {
+            return _mm256_add_epi32(acc, x);
+        } else if constexpr (op == Op::Sub) {
+            return _mm256_sub_epi32(acc, x);
+        } else if constexpr (op == Op::Mul) {
+            return _mm256_mullo_epi32(acc, x);
+        } else if constexpr (op == Op::Min) {
+            return _mm256_min_epi32(acc, x);
+        } else {
+            return _mm256_max_epi32(acc, x);
+        }
+    }
+};
+
+// Each kernel runs whole blocks in registers and leaves what is left over,
+// fewer than one block's worth, to its scalar twin.
+template <Op op, typename Cell>
+PELI_AVX2 void zipAvx2(const Cell* a, const Cell* b, Cell* out, size_t n) {
+    using S = Avx2<Cell>;
+    size_t i = 0;
+    for (; i + kLanes<Cell> <= n; i += kLanes<Cell>) {
+        S::store(out + i, S::template apply<op>(S::load(a + i), S::load(b + i)));
+    }
+    zipScalar<op>(a + i, b + i, out + i, n - i);
+}
+
+template <typename Cell>
+PELI_AVX2 void addAvx2(const Cell* a, const Cell* b, Cell* out, size_t n) {
+    zipAvx2<Op::Add>(a, b, out, n);
+}
+
+template <typename Cell>
+PELI_AVX2 void subAvx2(const Cell* a, const Cell* b, Cell* out, size_t n) {
+    zipAvx2<Op::Sub>(a, b, out, n);
+}
+
+template <typename Cell>
+PELI_AVX2 void mulAvx2(const Cell* a, const Cell* b, Cell* out, size_t n) {
+    zipAvx2<Op::Mul>(a, b, out, n);
+}
+
+template <typename Cell>
+PELI_AVX2 void scaleAvx2(const Cell* a, Cell* out, size_t n, Cell k) {
+    using S = Avx2<Cell>;
+    typename S::V factor = S::splat(k);
+    size_t i = 0;
+    for (; i + kLanes<Cell> <= n; i += kLanes<Cell>) {
+        S::store(out + i, S::template apply<Op::Mul>(S::load(a + i), factor));
+    }
+    scaleScalar(a + i, out + i, n - i, k);
+}
+
+template <Op op, typename Cell>
+PELI_AVX2 Cell foldAvx2(const Cell* a, size_t n, Cell init) {
+    using S = Avx2<Cell>;
+    typename S::V acc = S::splat(init);
+    size_t i = 0;
+    for (; i + kLanes<Cell> <= n; i += kLanes<Cell>) {
+        acc = S::template apply<op>(acc, S::load(a + i));
+    }
+    Cell lanes[kLanes<Cell>];
+    S::store(lanes, acc);
+    return foldScalar<op>(lanes, a + i, n - i);
+}
+
+template <typename Cell>
+PELI_AVX2 Cell sumAvx2(const Cell* a, size_t n) {
+    return foldAvx2<Op::Add>(a, n, Cell(0));
+}
+
+template <typename Cell>
+PELI_AVX2 Cell minAvx2(const Cell* a, size_t n) {
+    return foldAvx2<Op::Min>(a, n, a[0]);
+}
+
+template <typename Cell>
+PELI_AVX2 Cell maxAvx2(const Cell* a, size_t n) {
+    return foldAvx2<Op::Max>(a, n, a[0]);
+}
+
+template <typename Cell>
+PELI_AVX2 Cell dotAvx2(const Cell* a, const Cell* b, size_t n) {
+    using S = Avx2<Cell>;
+    typename S::V acc = S::splat(0);
+    size_t i = 0;
+    for (; i + kLanes<Cell> <= n; i += kLanes<Cell>) {
+        acc = S::template apply<Op::Add>(acc, S::template apply<Op::Mul>(S::load(a + i), S::load(b + i)));
+    }
+    Cell lanes[kLanes<Cell>];
+    S::store(lanes, acc);
+    return dotScalar(lanes, a + i, b + i, n - i);
+}
+
+#undef PELI_AVX2
+
+template <typename Cell>
+constexpr VectorKernels<Cell> avx2Kernels{"avx2",        addAvx2<Cell>,   subAvx2<Cell>,
+                                          mulAvx2<Cell>, scaleAvx2<Cell>, sumAvx2<Cell>,
+                                          dotAvx2<Cell>, minAvx2<Cell>,   maxAvx2<Cell>};
+
+bool hasAvx2() {
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif
+
+} // namespace
+
+template <typename Cell>
+const VectorKernels<Cell>& VectorKernels<Cell>::best() {
+#if PELI_SIMD_X86
+    static const VectorKernels& chosen = hasAvx2() ? avx2Kernels<Cell> : scalarKernels<Cell>;
+    return chosen;
+#else
+    return scalarKernels<Cell>;
+#endif
+}
+
+template <typename Cell>
+std::vector<const VectorKernels<Cell>*> VectorKernels<Cell>::available() {
+    std::vector<const VectorKernels*> kernels = {&scalarKernels<Cell>};
+#if PELI_SIMD_X86
+    if (hasAvx2()) {
+        kernels.push_back(&avx2Kernels<Cell>);
+    }
+#endif
+    return kernels;
+}
+
+#define PELI_INSTANTIATE_VECTOR(Cell) template struct VectorKernels<Cell>;
+PELI_CELL_TYPES(PELI_INSTANTIATE_VECTOR)
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "Cell.hpp"
+#include "Simd.hpp"
+#include <cstddef>
+#include <vector>
+
+// The loops behind V+, V-, V*, VSCALE, VSUM, VDOT, VMIN and VMAX, over
+// arrays of `n` cells the caller has already bounds-checked. Integer cells
+// wrap like + and *. Every kernel set gives bit-identical results: element-
+// wise kernels read a block of 32 bytes before writing it, and reductions
+// keep 32 bytes' worth of lanes that are combined in the same order, so a
+// floating-point VSUM does not depend on the CPU it runs on. An AVX2 set
+// is chosen at run time where the CPU has AVX2 (see Simd.hpp).
+template <typename Cell>
+struct VectorKernels {
+    const char* name;
+    // out[i] = a[i] op b[i]; `out` may be `a` or `b`.
+    void (*add)(const Cell* a, const Cell* b, Cell* out, size_t n);
+    void (*sub)(const Cell* a, const Cell* b, Cell* out, size_t n);
+    void (*mul)(const Cell* a, const Cell* b, Cell* out, size_t n);
+    // out[i] = a[i] * k.
+    void (*scale)(const Cell* a, Cell* out, size_t n, Cell k);
+    Cell (*sum)(const Cell* a, size_t n);
+    Cell (*dot)(const Cell* a, const Cell* b, size_t n);
+    // Need n >= 1.
+    Cell (*min)(const Cell* a, size_t n);
+    Cell (*max)(const Cell* a, size_t n);
+
+    // The fastest kernels this CPU supports.
+    static const VectorKernels& best();
+    // Every kernel set this CPU supports, scalar first, for tests and
+    // benchmarks to compare.
+    static std::vector<const VectorKernels*> available();
+};
+
+#define PELI_DECLARE_VECTOR(Cell) extern template struct VectorKernels<Cell>;
+PELI_CELL_TYPES(PELI_DECLARE_VECTOR)
+#undef PELI_DECLARE_VECTOR
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <gtest/gtest.h>
+#include "Interpreter.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include <ostream>
+#include <string>
+
+template <typename Cell>
+void evaluate(BasicInterpreter<Cell>& interpreter, const std::string& code) {
+    Lexer lexer(code);
+    Parser parser(lexer);
+    interpreter.evaluate(parser.parse());
+}
+
+// Code that stores `text` in the bytes from `addr`.
+inline std::string bytesAt(size_t addr, const std::string& text) {
+    std::string code;
+    for (size_t i = 0; i < text.size(); ++i) {
+        code += std::to_string(static_cast<unsigned char>(text[i])) + " " + std::to_string(addr + i) + " C! ";
+    }
+    return code;
+}
+
+// How a parameterized test runs its code: on the bytecode VM, with or
+// without the JIT, or on the tree-walker.
+struct Mode {
+    ExecutionMode mode;
+    bool jit;
+};
+
+inline const Mode kModes[] = {{ExecutionMode::Bytecode, false},
+                              {ExecutionMode::Bytecode, true},
+                              {ExecutionMode::TreeWalk, false}};
+
+// Bytecode, BytecodeJit or TreeWalk: the instance names and how gtest
+// prints the parameter.
+inline std::string modeLabel(const Mode& mode) {
+    std::string name = mode.mode == ExecutionMode::TreeWalk ? "TreeWalk" : "Bytecode";
+    return mode.jit ? name + "Jit" : name;
+}
+
+inline std::string modeName(const ::testing::TestParamInfo<Mode>& info) {
+    return modeLabel(info.param);
+}
+
+inline void PrintTo(const Mode& mode, std::ostream* out) {
+    *out << modeLabel(mode);
+}
+
+// A test that runs in every mode; instantiate it with
+// INSTANTIATE_TEST_SUITE_P(Modes, Suite, ::testing::ValuesIn(kModes), modeName).
+class ModeTest : public ::testing::TestWithParam<Mode> {
+protected:
+    InterpreterOptions options() const {
+        InterpreterOptions options;
+        options.mode = GetParam().mode;
+        options.jit = GetParam().jit;
+        return options;
+    }
+
+    // The message of the error `code` raises, or "" when it raises none.
+    template <typename Cell>
+    std::string errorOf(BasicInterpreter<Cell>& interpreter, const std::string& code) const {
+        try {
+            evaluate(interpreter, code);
+        } catch (const std::exception& e) {
+            return e.what();
+        }
+        return "";
+    }
+};
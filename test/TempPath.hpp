@@ -0,0 +1,19 @@
+#pragma once
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <filesystem>
+#include <string>
+#include <unistd.h>
+
+// A path in the temporary directory that belongs to the running test alone:
+// it names the test and the process, so tests that ctest runs in parallel
+// never share a file. `suffix` is appended as is, e.g. ".img".
+inline std::string tempPath(const std::string& suffix = "") {
+    const ::testing::TestInfo* test = ::testing::UnitTest::GetInstance()->current_test_info();
+    std::string name = std::string("peli_") + test->test_suite_name() + "_" + test->name() + "_" +
+                       std::to_string(getpid());
+    // Parameterized tests are named like Modes/Suite.Test/0.
+    std::replace(name.begin(), name.end(), '/', '_');
+    return (std::filesystem::temp_directory_path() / (name + suffix)).string();
+}
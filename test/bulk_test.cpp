@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+#include "ModeTest.hpp"
+#include "TempPath.hpp"
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+class BulkTest : public ModeTest {};
+
+TEST_P(BulkTest, MoveHandlesOverlap) {
+    BasicInterpreter<int64_t> interpreter(options());
+    evaluate(interpreter, ": PUT 0 DO I 1 + 10 I + ! LOOP ; 5 PUT "
+                          "10 11 5 MOVE 10 @ 11 @ 15 @ "
+                          "12 10 4 MOVE 10 @ 13 @ 14 @ 15 @");
+    EXPECT_EQ(interpreter.getStack(), (std::vector<int64_t>{1, 1, 5, 2, 5, 4, 5}));
+}
+
+TEST_P(BulkTest, FillAndEraseStoreEveryCell) {
+    Interpreter interpreter(options());
+    evaluate(interpreter, "100 40 2.5 FILL 100 @ 139 @ 140 @ "
+                          "200 3 -1 FILL 200 @ 202 @ "
+                          "110 20 ERASE 109 @ 110 @ 129 @ 130 @");
+    EXPECT_EQ(interpreter.getStack(), (std::vector<double>{2.5, 2.5, 0, -1, -1, 2.5, 0, 0, 2.5}));
+}
+
+TEST_P(BulkTest, CompareOrdersBytes) {
+    BasicInterpreter<int64_t> interpreter(options());
+    evaluate(interpreter, bytesAt(0, "apple") + bytesAt(16, "apricot") + bytesAt(32, "apple") +
+                              "0 5 16 7 COMPARE 16 7 0 5 COMPARE 0 5 32 5 COMPARE 0 3 32 5 COMPARE 0 0 32 0 COMPARE");
+    EXPECT_EQ(interpreter.getStack(), (std::vector<int64_t>{-1, 1, 0, -1, 0}));
+}
+
+TEST_P(BulkTest, SearchFindsTheFirstMatch) {
+    BasicInterpreter<int64_t> interpreter(options());
+    evaluate(interpreter, bytesAt(0, "abcabcabd") + bytesAt(64, "abd") + bytesAt(80, "xyz") +
+                              "0 9 64 3 SEARCH 0 9 80 3 SEARCH 0 9 64 0 SEARCH");
+    EXPECT_EQ(interpreter.getStack(), (std::vector<int64_t>{6, 3, 1, 0, 9, 0, 0, 9, 1}));
+}
+
+TEST_P(BulkTest, ScanFindsACellValue) {
+    BasicInterpreter<int32_t> interpreter(options());
+    // Long enough to cross whole blocks before the match.
+    evaluate(interpreter, ": PUT 0 DO I 1000 I + ! LOOP ; 100 PUT "
+                          "1000 100 77 SCAN 1000 100 500 SCAN 1000 0 0 SCAN");
+    EXPECT_EQ(interpreter.getStack(), (std::vector<int32_t>{1077, 23, 1100, 0, 1000, 0}));
+}
+
+TEST_P(BulkTest, RangesAreCheckedBeforeAnythingIsTouched) {
+    InterpreterOptions small = options();
+    small.memory_cells = 1024;
+    BasicInterpreter<int64_t> interpreter(small);
+    evaluate(interpreter, "7 1023 !");
+    EXPECT_EQ(errorOf(interpreter, "1000 30 9 FILL"), "FILL memory out of bounds");
+    EXPECT_EQ(errorOf(interpreter, "1000 0 30 MOVE"), "MOVE memory out of bounds");
+    EXPECT_EQ(errorOf(interpreter, "-1 2 ERASE"), "ERASE memory out of bounds");
+    EXPECT_EQ(errorOf(interpreter, "8000 200 0 1 COMPARE"), "COMPARE memory out of bounds");
+    EXPECT_EQ(errorOf(interpreter, "0 1 8190 8 SEARCH"), "SEARCH memory out of bounds");
+    EXPECT_EQ(errorOf(interpreter, "1000 25 7 SCAN"), "SCAN memory out of bounds");
+    evaluate(interpreter, "999 @ 1023 @");
+    EXPECT_EQ(interpreter.getStack(), (std::vector<int64_t>{0, 7}));
+}
+
+TEST_P(BulkTest, ReadOnlyFilesRejectBulkStores) {
+    std::string path = tempPath(".bin");
+    std::vector<int64_t> cells{1, 2, 3, 4};
+    std::ofstream(path, std::ios::binary | std::ios::trunc)
+        .write(reinterpret_cast<const char*>(cells.data()), static_cast<std::streamsize>(sizeof(cells[0]) * 4));
+
+    BasicInterpreter<int64_t> interpreter(options());
+    evaluate(interpreter, bytesAt(0, path) + "0 " + std::to_string(path.size()) + " 0 MAP-FILE DROP");
+    std::string base = std::to_string(interpreter.getStack()[0]);
+    EXPECT_EQ(errorOf(interpreter, base + " 2 9 FILL"), "FILL into read-only memory");
+    EXPECT_EQ(errorOf(interpreter, base + " 2 ERASE"), "ERASE into read-only memory");
+    EXPECT_EQ(errorOf(interpreter, "0 " + base + " 2 MOVE"), "MOVE into read-only memory");
+
+    // Reading from the file is fine.
+    evaluate(interpreter, base + " 500 4 MOVE 503 @ " + base + " 4 3 SCAN DROP " + base + " -");
+    std::vector<int64_t> stack = interpreter.getStack();
+    ASSERT_GE(stack.size(), 2u);
+    EXPECT_EQ(stack[stack.size() - 2], 4);
+    EXPECT_EQ(stack.back(), 2);
+    std::filesystem::remove(path);
+}
+
+INSTANTIATE_TEST_SUITE_P(Modes, BulkTest, ::testing::ValuesIn(kModes), modeName);
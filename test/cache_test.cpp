@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+#include "TempPath.hpp"
+#include "AstCache.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+
+Ast parseText(std::string_view source) {
+    Lexer lexer(source);
+    Parser parser(lexer);
+    return parser.parse();
+}
+
+// The whole tree in pre-order, one node per line.
+std::string describe(const Ast& ast) {
+    std::string out;
+    const AstNode* node = &ast.root();
+    for (size_t i = 0; i < ast.nodeCount(); ++i, ++node) {
+        out += std::to_string(static_cast<int>(node->kind())) + " " + std::to_string(node->subtreeSize()) + " " +
+               node->toString();
+        if (node->kind() == AstKind::Word) {
+            out += " " + std::to_string(static_cast<int>(node->getToken().type));
+        }
+        if (node->kind() == AstKind::Number && node->isIntegral()) {
+            out += " =" + std::to_string(node->getInteger());
+        }
+        out += "\n";
+    }
+    return out;
+}
+
+const AstNode& nthChild(const AstNode& node, size_t n) {
+    auto child = node.children().begin();
+    while (n-- > 0) {
+        ++child;
+    }
+    return *child;
+}
+
+const char* const kProgram =
+    ": SQUARE ( n -- n*n ) DUP * ;\n"
+    "10 0 DO I SQUARE 100 I + ! LOOP\n"
+    "-0 9223372036854775807 2.5e3 -42 0x1F .\" hi there\" CR\n"
+    ": CLAMP OVER OVER < IF SWAP ELSE DROP THEN ; 5 1 ?DO I -1 +LOOP\n";
+
+class AstCacheTest : public ::testing::Test {
+protected:
+    void TearDown() override { std::filesystem::remove_all(dir); }
+
+    const std::string dir = tempPath();
+};
+
+} // namespace
+
+TEST(AstSerializationTest, RoundTripsEveryNode) {
+    Ast ast = parseText(kProgram);
+    Ast copy = Ast::deserialize(ast.serialize());
+    EXPECT_EQ(describe(copy), describe(ast));
+    EXPECT_EQ(copy.serialize(), ast.serialize());
+
+    // -0 is integral, but its double keeps the sign.
+    const AstNode& zero = nthChild(ast.root(), 4);
+    ASSERT_EQ(zero.toString(), "-0.000000");
+    const AstNode& copied = nthChild(copy.root(), 4);
+    EXPECT_TRUE(std::signbit(copied.getValue()) == std::signbit(zero.getValue()));
+}
+
+TEST(AstSerializationTest, RejectsMalformedBytes) {
+    std::string bytes = parseText(kProgram).serialize();
+    for (size_t size = 0; size < bytes.size(); ++size) {
+        EXPECT_THROW(Ast::deserialize(std::string_view(bytes).substr(0, size)), std::runtime_error) << size;
+    }
+
+    // Shapes the parser never builds: a DO loop whose body is a Word
+    // rather than a Block, and an IF with one branch.
+    Ast loop;
+    size_t root = loop.open(AstNode::block());
+    size_t body = loop.open(AstNode::doLoop(false));
+    loop.add(AstNode::word(TokenType::LoopIndexI, "I"));
+    loop.close(body);
+    loop.close(root);
+    EXPECT_THROW(Ast::deserialize(loop.serialize()), std::runtime_error);
+
+    Ast branch;
+    root = branch.open(AstNode::block());
+    size_t ifThen = branch.open(AstNode::ifThen());
+    branch.close(branch.open(AstNode::block()));
+    branch.close(ifThen);
+    branch.close(root);
+    EXPECT_THROW(Ast::deserialize(branch.serialize()), std::runtime_error);
+}
+
+TEST_F(AstCacheTest, MissesThenHits) {
+    AstCache cache(dir);
+    EXPECT_FALSE(cache.find(kProgram));
+    cache.store(kProgram, parseText(kProgram));
+
+    std::optional<Ast> cached = cache.find(kProgram);
+    ASSERT_TRUE(cached);
+    EXPECT_EQ(describe(*cached), describe(parseText(kProgram)));
+    EXPECT_FALSE(cache.find(": OTHER ;"));
+
+    EXPECT_EQ(cache.stats().hits, 1u);
+    EXPECT_EQ(cache.stats().misses, 2u);
+    EXPECT_EQ(cache.stats().writes, 1u);
+    EXPECT_EQ(cache.stats().failures, 0u);
+    // Nothing is left behind but the entry.
+    EXPECT_EQ(std::distance(std::filesystem::directory_iterator(dir), {}), 1);
+}
+
+TEST_F(AstCacheTest, DamagedEntriesAreMissesAndReplaced) {
+    AstCache cache(dir);
+    cache.store(kProgram, parseText(kProgram));
+    std::string path = cache.entryPath(kProgram);
+    {
+        std::fstream entry(path, std::ios::in | std::ios::out | std::ios::binary);
+        entry.seekp(60);
+        entry.put('\x7F');
+    }
+    EXPECT_FALSE(cache.find(kProgram));
+    EXPECT_EQ(cache.stats().failures, 1u);
+
+    cache.store(kProgram, parseText(kProgram));
+    EXPECT_TRUE(cache.find(kProgram));
+
+    std::filesystem::resize_file(path, 20);
+    EXPECT_FALSE(cache.find(kProgram));
+}
+
+TEST_F(AstCacheTest, UnwritableDirectoryOnlyCountsAFailure) {
+    std::ofstream(dir) << "a file where the directory should be";
+    AstCache cache(dir);
+    EXPECT_NO_THROW(cache.store(kProgram, parseText(kProgram)));
+    EXPECT_EQ(cache.stats().failures, 1u);
+    EXPECT_FALSE(cache.find(kProgram));
+}
@@ -0,0 +1,21 @@
+# Runs PROGRAM on INTERPRETER and its ahead-of-time build COMPILED, both with
+# INPUT on standard input, and fails unless they print the same.
+get_filename_component(name "${COMPILED}" NAME)
+set(input_file "${CMAKE_CURRENT_BINARY_DIR}/${name}.input")
+file(WRITE "${input_file}" "${INPUT}\n")
+
+execute_process(COMMAND "${INTERPRETER}" --no-cache "${PROGRAM}"
+    INPUT_FILE "${input_file}"
+    OUTPUT_VARIABLE expected_output
+    ERROR_VARIABLE expected_error)
+execute_process(COMMAND "${COMPILED}"
+    INPUT_FILE "${input_file}"
+    OUTPUT_VARIABLE actual_output
+    ERROR_VARIABLE actual_error)
+
+if(NOT actual_output STREQUAL expected_output)
+    message(FATAL_ERROR "Output differs.\nInterpreter:\n${expected_output}\nCompiled:\n${actual_output}")
+endif()
+if(NOT actual_error STREQUAL expected_error)
+    message(FATAL_ERROR "Errors differ.\nInterpreter:\n${expected_error}\nCompiled:\n${actual_error}")
+endif()
@@ -0,0 +1,316 @@
+#include <gtest/gtest.h>
+#include "Compiler.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+static std::vector<const AstNode*> topLevel(const Ast& ast) {
+    std::vector<const AstNode*> nodes;
+    for (const AstNode& node : ast.root().children()) {
+        nodes.push_back(&node);
+    }
+    return nodes;
+}
+
+TEST(CompilerTest, EmitsLiteralsAndPrimitives) {
+    Lexer lexer("10 5 + DUP");
+    Parser parser(lexer);
+    auto ast = parser.parse();
+
+    CodeSpace space;
+    Compiler compiler(space);
+    size_t entry = compiler.compileSegment(topLevel(ast));
+
+    ASSERT_EQ(entry, 0);
+    ASSERT_EQ(space.code.size(), 6);
+    EXPECT_EQ(space.code[0].op, OpCode::Check);
+    EXPECT_EQ(space.code[1].op, OpCode::Lit);
+    EXPECT_EQ(space.constants[space.code[1].arg], 10.0);
+    EXPECT_EQ(space.code[2].op, OpCode::Lit);
+    EXPECT_EQ(space.code[3].op, OpCode::Add);
+    EXPECT_EQ(space.code[4].op, OpCode::Dup);
+    EXPECT_EQ(space.code[5].op, OpCode::Halt);
+}
+
+TEST(CompilerTest, IfElseUsesRelativeJumps) {
+    Lexer lexer("IF 1 ELSE 2 THEN");
+    Parser parser(lexer);
+    auto ast = parser.parse();
+
+    CodeSpace space;
+    Compiler compiler(space);
+    compiler.compileSegment(topLevel(ast));
+
+    // 0: Check, 1: JumpIfZero -> 4, 2: Lit 1, 3: Jump -> 5, 4: Lit 2, 5: Halt
+    ASSERT_EQ(space.code.size(), 6);
+    EXPECT_EQ(space.code[1].op, OpCode::JumpIfZero);
+    EXPECT_EQ(space.code[1].arg, 3);
+    EXPECT_EQ(space.code[3].op, OpCode::Jump);
+    EXPECT_EQ(space.code[3].arg, 2);
+}
+
+TEST(CompilerTest, DoLoopJumpsBackToBody) {
+    Lexer lexer("DO I LOOP");
+    Parser parser(lexer);
+    auto ast = parser.parse();
+
+    CodeSpace space;
+    Compiler compiler(space);
+    compiler.compileSegment(topLevel(ast));
+
+    // 0: Check, 1: Do -> 5, 2: Check, 3: LoopI, 4: Loop -> 2, 5: Halt
+    ASSERT_EQ(space.code.size(), 6);
+    EXPECT_EQ(space.code[1].op, OpCode::Do);
+    EXPECT_EQ(space.code[1].arg, 4);
+    EXPECT_EQ(space.code[4].op, OpCode::Loop);
+    EXPECT_EQ(space.code[4].arg, -2);
+}
+
+TEST(CompilerTest, UserWordsShadowPrimitives) {
+    Lexer lexer("DUP");
+    Parser parser(lexer);
+    auto ast = parser.parse();
+
+    CodeSpace space;
+    space.dictionary.bind(space.dictionary.intern("DUP"), 0);
+    Compiler compiler(space);
+    compiler.compileSegment(topLevel(ast));
+
+    EXPECT_EQ(space.code[0].op, OpCode::Call);
+    EXPECT_EQ(space.code[0].arg, space.dictionary.find("DUP"));
+}
+
+TEST(CompilerTest, UndefinedWordsGetASlotOnFirstReference) {
+    Lexer lexer("LATER LATER");
+    Parser parser(lexer);
+    auto ast = parser.parse();
+
+    CodeSpace space;
+    Compiler compiler(space);
+    compiler.compileSegment(topLevel(ast));
+
+    int32_t slot = space.dictionary.find("LATER");
+    ASSERT_GE(slot, 0);
+    EXPECT_EQ(space.dictionary.entry(slot), Dictionary::unbound);
+    EXPECT_EQ(space.code[0].arg, slot);
+    EXPECT_EQ(space.code[1].arg, slot);
+}
+
+TEST(CompilerTest, ChecksEachBasicBlockOnceWhenEffectIsUnknown) {
+    Lexer lexer("OVER OVER > IF SWAP THEN ROT UNDEFINED");
+    Parser parser(lexer);
+    auto ast = parser.parse();
+
+    CodeSpace space;
+    Compiler compiler(space);
+    compiler.compileSegment(topLevel(ast));
+
+    // OVER OVER > JumpIfZero needs two cells and peaks two above entry.
+    ASSERT_EQ(space.code[0].op, OpCode::Check);
+    EXPECT_EQ(checkNeed(space.code[0].arg), 2);
+    EXPECT_EQ(checkGrow(space.code[0].arg), 2);
+    int checks = 0;
+    for (const Instruction& instr : space.code) {
+        checks += instr.op == OpCode::Check;
+    }
+    EXPECT_EQ(checks, 3);
+}
+
+TEST(CompilerTest, ProvenDefinitionIsCheckedOnlyOnEntry) {
+    Lexer lexer(R"(
+        : COMPARE-AND-SWAP DUP @ OVER 1 + @ OVER OVER > IF
+            >R OVER 1 + ! R> SWAP !
+        ELSE DROP DROP DROP THEN ;
+    )");
+    Parser parser(lexer);
+    auto ast = parser.parse();
+    const AstNode& def = *ast.root().children().begin();
+    ASSERT_EQ(def.kind(), AstKind::Definition);
+
+    CodeSpace space;
+    Compiler compiler(space);
+    size_t entry = compiler.compileDefinition(std::string(def.getName()), def.getBody());
+
+    const WordEffect& effect = space.dictionary.effect(space.dictionary.find("COMPARE-AND-SWAP"));
+    EXPECT_TRUE(effect.known);
+    EXPECT_EQ(effect.need, 1);
+    EXPECT_EQ(effect.net, -1);
+    EXPECT_EQ(effect.grow, 4);
+
+    int checks = 0;
+    for (const Instruction& instr : space.code) {
+        checks += instr.op == OpCode::Check;
+    }
+    EXPECT_EQ(checks, 1);
+    EXPECT_EQ(space.code[entry].op, OpCode::Check);
+}
+
+TEST(CompilerTest, RejectsMismatchedBranchesInDefinitions) {
+    Lexer lexer(": BAD IF 1 2 ELSE 3 THEN ;");
+    Parser parser(lexer);
+    auto ast = parser.parse();
+    const AstNode& def = *ast.root().children().begin();
+    ASSERT_EQ(def.kind(), AstKind::Definition);
+
+    CodeSpace space;
+    Compiler compiler(space);
+    EXPECT_THROW(compiler.compileDefinition(std::string(def.getName()), def.getBody()), std::runtime_error);
+    EXPECT_FALSE(space.dictionary.isDefined("BAD"));
+}
+
+static std::vector<OpCode> opcodes(const CodeSpace& space) {
+    std::vector<OpCode> ops;
+    for (const Instruction& instr : space.code) {
+        if (instr.op != OpCode::Check) {
+            ops.push_back(instr.op);
+        }
+    }
+    return ops;
+}
+
+TEST(OptimizerTest, FoldsConstantSubexpressions) {
+    Lexer lexer("10 DUP * 3.14159 *");
+    Parser parser(lexer);
+    auto ast = parser.parse();
+
+    CodeSpace space;
+    Compiler compiler(space, OptimizerOptions{1});
+    compiler.compileSegment(topLevel(ast));
+
+    ASSERT_EQ(opcodes(space), (std::vector<OpCode>{OpCode::Lit, OpCode::Halt}));
+    EXPECT_EQ(space.constants[space.code[1].arg], 10.0 * 10.0 * 3.14159);
+}
+
+TEST(OptimizerTest, LeavesDivisionByZeroForRunTime) {
+    Lexer lexer("1 0 /");
+    Parser parser(lexer);
+    auto ast = parser.parse();
+
+    CodeSpace space;
+    Compiler compiler(space, OptimizerOptions{kMaxOptLevel});
+    compiler.compileSegment(topLevel(ast));
+
+    EXPECT_EQ(opcodes(space), (std::vector<OpCode>{OpCode::Lit, OpCode::Lit, OpCode::Div, OpCode::Halt}));
+}
+
+TEST(OptimizerTest, SubtractingZeroKeepsNegativeZero) {
+    Lexer lexer("0 -");
+    Parser parser(lexer);
+    auto ast = parser.parse();
+
+    CodeSpace space;
+    Compiler compiler(space, OptimizerOptions{2});
+    compiler.compileSegment(topLevel(ast));
+
+    ASSERT_EQ(opcodes(space), (std::vector<OpCode>{OpCode::AddI, OpCode::Halt}));
+    double c = space.constants[space.code[1].arg];
+    // -0.0 + c must be -0.0, as -0.0 - 0 is.
+    EXPECT_EQ(c, 0.0);
+    EXPECT_TRUE(std::signbit(-0.0 + c));
+}
+
+TEST(OptimizerTest, FusesSuperinstructions) {
+    Lexer lexer("OVER OVER > DUP * 1 + 2 * DO I 100 + @ 100 I + @ LOOP");
+    Parser parser(lexer);
+    auto ast = parser.parse();
+
+    CodeSpace space;
+    std::ostringstream log;
+    Compiler compiler(space, OptimizerOptions{kMaxOptLevel, &log});
+    compiler.compileSegment(topLevel(ast));
+
+    EXPECT_EQ(opcodes(space), (std::vector<OpCode>{OpCode::TwoDup, OpCode::GreaterThan, OpCode::Square,
+                                                   OpCode::AddI, OpCode::MulI, OpCode::Do,
+                                                   OpCode::FetchIOffset, OpCode::FetchIOffset,
+                                                   OpCode::Loop, OpCode::Halt}));
+    EXPECT_NE(log.str().find("top level: OVER OVER => TwoDup"), std::string::npos);
+    EXPECT_NE(log.str().find("I lit + @ => FetchIOffset"), std::string::npos);
+}
+
+TEST(OptimizerTest, DoesNotFuseAcrossJumpTargets) {
+    Lexer lexer("IF 3 THEN +");
+    Parser parser(lexer);
+    auto ast = parser.parse();
+
+    CodeSpace space;
+    Compiler compiler(space, OptimizerOptions{kMaxOptLevel});
+    compiler.compileSegment(topLevel(ast));
+
+    EXPECT_EQ(opcodes(space), (std::vector<OpCode>{OpCode::JumpIfZero, OpCode::Lit, OpCode::Add, OpCode::Halt}));
+}
+
+static void compileDefinitions(Compiler& compiler, const std::string& source) {
+    Lexer lexer(source);
+    Parser parser(lexer);
+    auto ast = parser.parse();
+    for (const AstNode& def : ast.root().children()) {
+        ASSERT_EQ(def.kind(), AstKind::Definition);
+        compiler.compileDefinition(std::string(def.getName()), def.getBody());
+    }
+}
+
+TEST(OptimizerTest, InlinesSmallWordsAndPatchesThemOnRedefinition) {
+    CodeSpace space;
+    Compiler compiler(space, OptimizerOptions{3});
+    compileDefinitions(compiler, ": SQUARE DUP * ; : CUBE DUP SQUARE * ;");
+
+    size_t cube = space.dictionary.entry(space.dictionary.find("CUBE"));
+    for (size_t i = cube; i < space.code.size(); ++i) {
+        EXPECT_NE(space.code[i].op, OpCode::Call);
+    }
+    ASSERT_EQ(space.inline_sites.size(), 1);
+    InlineSite site = space.inline_sites[0];
+
+    compileDefinitions(compiler, ": SQUARE DUP DUP * * ;");
+    EXPECT_TRUE(space.inline_sites.empty());
+    EXPECT_EQ(space.code[site.begin].op, OpCode::Call);
+    EXPECT_EQ(space.code[site.begin + 1].op, OpCode::Jump);
+    EXPECT_EQ(site.begin + 1 + space.code[site.begin + 1].arg, site.end);
+}
+
+TEST(OptimizerTest, LastCallBecomesTailCall) {
+    CodeSpace space;
+    Compiler compiler(space, OptimizerOptions{3});
+    compileDefinitions(compiler, ": DOWN DUP 0 > IF 1 - DOWN ELSE DROP 0 THEN ;");
+
+    int tail = 0, calls = 0;
+    for (const Instruction& instr : space.code) {
+        tail += instr.op == OpCode::TailCall;
+        calls += instr.op == OpCode::Call;
+    }
+    EXPECT_EQ(tail, 1);
+    EXPECT_EQ(calls, 0);
+}
+
+TEST(CompilerTest, LeaveJumpsPastTheLoop) {
+    Lexer lexer("DO I IF LEAVE THEN 2 +LOOP");
+    Parser parser(lexer);
+    auto ast = parser.parse();
+
+    CodeSpace space;
+    Compiler compiler(space);
+    compiler.compileSegment(topLevel(ast));
+
+    auto find = [&](OpCode op) {
+        return std::find_if(space.code.begin(), space.code.end(),
+                            [&](const Instruction& instr) { return instr.op == op; }) - space.code.begin();
+    };
+    auto leave = find(OpCode::Leave);
+    auto end = find(OpCode::PlusLoop);
+    ASSERT_LT(leave, end);
+    EXPECT_EQ(leave + space.code[leave].arg, end + 1);
+    EXPECT_EQ(space.code[end + 1].op, OpCode::Halt);
+}
+
+TEST(CompilerTest, LoopIndicesOutsideTheirLoopAreChecked) {
+    CodeSpace space;
+    Compiler compiler(space);
+    compileDefinitions(compiler, ": INNER I ; : OUTER 3 0 DO I J LOOP ;");
+
+    std::vector<OpCode> ops = opcodes(space);
+    // INNER's I and OUTER's J have no loop of their own to read.
+    EXPECT_EQ(std::count(ops.begin(), ops.end(), OpCode::LoopIndex), 2);
+    EXPECT_EQ(std::count(ops.begin(), ops.end(), OpCode::LoopI), 1);
+}
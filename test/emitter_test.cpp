@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+#include "CppEmitter.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include <sstream>
+
+template <typename Cell = double>
+static std::string emitCpp(const std::string& code) {
+    Lexer lexer(code);
+    Parser parser(lexer);
+    auto ast = parser.parse();
+
+    std::ostringstream out;
+    BasicCppEmitter<Cell> emitter(InterpreterOptions{}, "test.peli");
+    emitter.emit(ast, out);
+    return out.str();
+}
+
+static bool contains(const std::string& text, const std::string& part) {
+    return text.find(part) != std::string::npos;
+}
+
+TEST(EmitterTest, DefinitionsBecomeFunctions) {
+    std::string cpp = emitCpp(": SQ DUP * ; 3 SQ");
+    EXPECT_TRUE(contains(cpp, "using Cell = double;"));
+    EXPECT_TRUE(contains(cpp, "Cell* def_0(Cell* sp) { // : SQ")) << cpp;
+    EXPECT_TRUE(contains(cpp, "slot_0 = def_0; // : SQ")) << cpp;
+    EXPECT_TRUE(contains(cpp, "int main() {")) << cpp;
+    // SQ has a single definition, so calls after it are direct, and its
+    // proven effect is checked once on entry.
+    EXPECT_TRUE(contains(cpp, "sp = program.call(def_0, \"SQ\", sp);")) << cpp;
+    EXPECT_TRUE(contains(cpp, "program.check(sp, 1, 1);")) << cpp;
+}
+
+TEST(EmitterTest, RedefinedWordsAreCalledThroughTheirSlot) {
+    std::string cpp = emitCpp(": SQ DUP * ; : SUM 0 SWAP 0 DO I SQ + LOOP ; 4 SUM : SQ DUP DUP * * ; 4 SUM");
+    EXPECT_TRUE(contains(cpp, "sp = program.call(slot_0, \"SQ\", sp);")) << cpp;
+    EXPECT_TRUE(contains(cpp, "slot_0 = def_2; // : SQ")) << cpp;
+    EXPECT_TRUE(contains(cpp, "*++sp = static_cast<Cell>(i1);")) << cpp;
+}
+
+TEST(EmitterTest, TailCallsReturnTheirResult) {
+    std::string cpp = emitCpp(": COUNT DUP 0 > IF 1 - COUNT THEN ;");
+    EXPECT_TRUE(contains(cpp, "return program.tailCall(def_0, \"COUNT\", sp);")) << cpp;
+}
+
+TEST(EmitterTest, LoopIndicesOutsideTheirLoopAreRegistered) {
+    std::string cpp = emitCpp(": SHOW I . ; 3 0 DO SHOW LOOP");
+    EXPECT_TRUE(contains(cpp, "*++sp = program.loopIndex(1);")) << cpp;
+    EXPECT_TRUE(contains(cpp, "program.enterLoop(&i1);")) << cpp;
+    EXPECT_TRUE(contains(cpp, "program.leaveLoop();")) << cpp;
+
+    EXPECT_FALSE(contains(emitCpp("3 0 DO I . LOOP"), "enterLoop"));
+}
+
+TEST(EmitterTest, CompileErrorsFailAtRunTime) {
+    // The VM runs the first segment before it rejects the literal.
+    std::string cpp = emitCpp<int64_t>("1 . : HALF 1.5 ; HALF");
+    EXPECT_TRUE(contains(cpp, "using Cell = int64_t;"));
+    EXPECT_TRUE(contains(cpp, "std::cout << *sp-- << \" \";")) << cpp;
+    EXPECT_TRUE(contains(cpp, "program.fail(\"Literal 1.500000 is not representable in i64 cells\");")) << cpp;
+    EXPECT_FALSE(contains(cpp, "HALF\", sp)")) << cpp;
+}
+
+TEST(EmitterTest, LiteralsAndStringsAreExact) {
+    std::string cpp = emitCpp(R"(0.1 ." say "hi"" )");
+    EXPECT_TRUE(contains(cpp, "*++sp = 0x1.999999999999ap-4;")) << cpp;
+    EXPECT_TRUE(contains(emitCpp<int64_t>("-9223372036854775808"), "std::numeric_limits<Cell>::min()"));
+}
@@ -0,0 +1,206 @@
+#include <gtest/gtest.h>
+#include "Image.hpp"
+#include "ModeTest.hpp"
+#include "TempPath.hpp"
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+namespace {
+
+class ImageTest : public ::testing::Test {
+protected:
+    void TearDown() override { std::filesystem::remove(path); }
+
+    std::string readFile() const {
+        std::ifstream in(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), {});
+    }
+    void writeFile(const std::string& bytes) const {
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << bytes;
+    }
+
+    const std::string path = tempPath(".img");
+};
+
+const char* const kLibrary =
+    ": SQUARE DUP * ;\n"
+    ": CUBE DUP SQUARE * ;\n"
+    "3 100 !\n"
+    ": MAIN 100 @ CUBE ;\n";
+
+} // namespace
+
+TEST_F(ImageTest, LoadingRunsTheEntryWordWithSavedWordsAndMemory) {
+    Interpreter saved;
+    evaluate(saved, kLibrary);
+    saved.saveImage(path, "MAIN");
+
+    Interpreter loaded;
+    loaded.loadImage(path);
+    EXPECT_EQ(loaded.getStack(), std::vector<double>{27});
+    evaluate(loaded, "4 SQUARE 100 @");
+    EXPECT_EQ(loaded.getStack(), (std::vector<double>{27, 16, 3}));
+}
+
+TEST_F(ImageTest, WordsStayRedefinableAfterLoading) {
+    // CUBE inlined SQUARE; rebinding SQUARE has to reach it all the same.
+    Interpreter saved;
+    evaluate(saved, kLibrary);
+    saved.saveImage(path, "");
+
+    Interpreter loaded;
+    loaded.loadImage(path);
+    EXPECT_TRUE(loaded.getStack().empty());
+    evaluate(loaded, ": SQUARE DROP 10 ; 2 CUBE");
+    EXPECT_EQ(loaded.getStack(), std::vector<double>{20});
+}
+
+TEST_F(ImageTest, JitCompiledCodeIsSavedAsBytecode) {
+    InterpreterOptions options;
+    options.jit = true;
+    BasicInterpreter<int64_t> saved(options);
+    evaluate(saved, ": SUM 0 SWAP 0 DO I + LOOP ; : MAIN 1000 SUM ;");
+    saved.saveImage(path, "MAIN");
+
+    BasicInterpreter<int64_t> plain;
+    plain.loadImage(path);
+    EXPECT_EQ(plain.getStack(), std::vector<int64_t>{499500});
+    BasicInterpreter<int64_t> jitted(options);
+    jitted.loadImage(path);
+    EXPECT_EQ(jitted.getStack(), std::vector<int64_t>{499500});
+}
+
+TEST_F(ImageTest, RejectsImagesItCannotRun) {
+    Interpreter saved;
+    evaluate(saved, kLibrary);
+    saved.saveImage(path, "MAIN");
+    const std::string good = readFile();
+    EXPECT_EQ(imageCellType(path), "f64");
+
+    BasicInterpreter<int64_t> wrong_cell;
+    EXPECT_THROW(wrong_cell.loadImage(path), std::runtime_error);
+
+    std::string damaged = good;
+    damaged[damaged.size() - 20] ^= 1;
+    writeFile(damaged);
+    Interpreter damaged_load;
+    EXPECT_THROW(damaged_load.loadImage(path), std::runtime_error);
+
+    writeFile(good.substr(0, good.size() - 1));
+    Interpreter truncated_load;
+    EXPECT_THROW(truncated_load.loadImage(path), std::runtime_error);
+
+    std::string newer = good;
+    newer[8] = static_cast<char>(kImageVersion + 1);
+    writeFile(newer);
+    Interpreter newer_load;
+    EXPECT_THROW(newer_load.loadImage(path), std::runtime_error);
+
+    // Older images number their opcodes differently.
+    std::string older = good;
+    older[8] = static_cast<char>(kImageVersion - 1);
+    writeFile(older);
+    Interpreter older_load;
+    EXPECT_THROW(older_load.loadImage(path), std::runtime_error);
+
+    writeFile(": SQUARE DUP * ;");
+    EXPECT_THROW(imageCellType(path), std::runtime_error);
+
+    Interpreter used;
+    evaluate(used, ": X 1 ;");
+    writeFile(good);
+    EXPECT_THROW(used.loadImage(path), std::runtime_error);
+}
+
+TEST_F(ImageTest, RejectsOperandsOutsideTheImage) {
+    // A well-formed file whose call names a word that is not in it.
+    CodeSpace space;
+    space.code = {{OpCode::Call, 5}, {OpCode::Halt, 0}};
+    CellMemory<double> memory(16);
+    saveImage(path, space, memory, -1);
+
+    Interpreter loaded;
+    EXPECT_THROW(loaded.loadImage(path), std::runtime_error);
+}
+
+TEST_F(ImageTest, RejectsTamperedStackChecks) {
+    // MAIN pushes two cells behind a Check that only makes room for `grow`.
+    auto save = [&](int grow, OpCode body) {
+        CodeSpace space;
+        space.code = {{OpCode::Check, packCheck(0, grow)}, {OpCode::Lit, 0}, {body, 0}, {OpCode::Exit, 0}};
+        space.constants = {1};
+        space.bind(space.dictionary.intern("MAIN"), 0);
+        CellMemory<double> memory(16);
+        saveImage(path, space, memory, 0);
+    };
+
+    save(2, OpCode::Dup);
+    Interpreter intact;
+    intact.loadImage(path);
+    EXPECT_EQ(intact.getStack(), std::vector<double>({1, 1}));
+
+    save(1, OpCode::Dup);
+    Interpreter tampered;
+    EXPECT_THROW(tampered.loadImage(path), std::runtime_error);
+
+    // UNLOOP with no DO around it would pop a frame that is not there.
+    save(1, OpCode::Unloop);
+    Interpreter unlooped;
+    EXPECT_THROW(unlooped.loadImage(path), std::runtime_error);
+}
+
+TEST_F(ImageTest, MemoryMustFitTheLoadingInterpreter) {
+    InterpreterOptions large;
+    large.memory_cells = 1 << 20;
+    Interpreter saved(large);
+    evaluate(saved, "7 1000000 !");
+    saved.saveImage(path, "");
+
+    Interpreter loaded(large);
+    loaded.loadImage(path);
+    evaluate(loaded, "1000000 @");
+    EXPECT_EQ(loaded.getStack(), std::vector<double>{7});
+
+    Interpreter small;
+    EXPECT_THROW(small.loadImage(path), std::runtime_error);
+}
+
+TEST_F(ImageTest, SavingOnlyReadsCommittedMemory) {
+    // 2 GiB of memory, of which a page or two is ever touched.
+    InterpreterOptions huge;
+    huge.memory_cells = size_t(1) << 28;
+    Interpreter saved(huge);
+    evaluate(saved, "7 1000000 ! 5 10 !");
+    saved.saveImage(path, "");
+    EXPECT_LT(std::filesystem::file_size(path), 1000000 * sizeof(double) + 4096);
+
+    Interpreter loaded(huge);
+    loaded.loadImage(path);
+    evaluate(loaded, "10 @ 1000000 @ 1000001 @");
+    EXPECT_EQ(loaded.getStack(), (std::vector<double>{5, 7, 0}));
+
+    CellMemory<double> memory(size_t(1) << 28);
+    EXPECT_EQ(memory.used(), 0u);
+    memory[123] = 1;
+    EXPECT_EQ(memory.used(), 124u);
+}
+
+TEST_F(ImageTest, MappedFilesAreNotSaved) {
+    std::string file = tempPath(".bin");
+    double cells[2] = {1, 2};
+    std::ofstream(file, std::ios::binary).write(reinterpret_cast<const char*>(cells), sizeof(cells));
+
+    Interpreter saved;
+    evaluate(saved, bytesAt(0, file) + "0 " + std::to_string(file.size()) + " 0 MAP-FILE DROP");
+    EXPECT_THROW(saved.saveImage(path, ""), std::runtime_error);
+    evaluate(saved, "UNMAP");
+    saved.saveImage(path, "");
+    std::filesystem::remove(file);
+}
+
+TEST_F(ImageTest, TreeWalkerHasNoImages) {
+    Interpreter walker(ExecutionMode::TreeWalk);
+    EXPECT_THROW(walker.saveImage(path, ""), std::runtime_error);
+    EXPECT_THROW(walker.loadImage(path), std::runtime_error);
+}
@@ -2,12 +2,14 @@
 #include "Interpreter.hpp"
 #include "lexer.hpp"
 #include "parser.hpp"
+#include <iostream>
+#include <sstream>
 
 void run(Interpreter& interpreter, const std::string& code) {
     Lexer lexer(code);
     Parser parser(lexer);
     auto ast = parser.parse();
-    interpreter.evaluate(*ast);
+    interpreter.evaluate(ast);
 }
 
 class InterpreterTest : public ::testing::Test {
@@ -452,3 +454,289 @@ TEST_F(InterpreterTest, BubbleSortWithJ) {
     EXPECT_EQ(stack[3], 50.0);
     EXPECT_EQ(stack[4], 80.0);
 }
+
+TEST(TreeWalkInterpreterTest, MatchesBytecodeVm) {
+    const std::string code = R"(
+        : SUM-EVENS 0 SWAP 0 DO I DUP 2 MOD 0 = IF + ELSE DROP THEN LOOP ;
+        10 SUM-EVENS 3 4 OVER OVER > IF SWAP THEN
+    )";
+    Interpreter vm;
+    Interpreter walker(ExecutionMode::TreeWalk);
+    run(vm, code);
+    run(walker, code);
+    EXPECT_EQ(vm.getStack(), walker.getStack());
+}
+
+TEST_F(InterpreterTest, RedefinitionOnlyAffectsLaterStatements) {
+    run(interpreter, ": A 1 ; A : A 2 ; A");
+    const auto& stack = interpreter.getStack();
+    ASSERT_EQ(stack.size(), 2);
+    EXPECT_EQ(stack[0], 1.0);
+    EXPECT_EQ(stack[1], 2.0);
+}
+
+TEST_F(InterpreterTest, RecursiveWord) {
+    run(interpreter, ": COUNTDOWN DUP 0 > IF DUP 1 - COUNTDOWN THEN ; 3 COUNTDOWN");
+    const auto& stack = interpreter.getStack();
+    ASSERT_EQ(stack.size(), 4);
+    EXPECT_EQ(stack[0], 3.0);
+    EXPECT_EQ(stack[3], 0.0);
+}
+
+TEST_F(InterpreterTest, RedefinitionRepointsExistingCallers) {
+    run(interpreter, ": BASE 1 ; : USE BASE 10 * ;");
+    run(interpreter, "USE");
+    run(interpreter, ": BASE 2 ;");
+    run(interpreter, "USE");
+    const auto& stack = interpreter.getStack();
+    ASSERT_EQ(stack.size(), 2);
+    EXPECT_EQ(stack[0], 10.0);
+    EXPECT_EQ(stack[1], 20.0);
+}
+
+template <typename Cell>
+void runCells(BasicInterpreter<Cell>& interpreter, const std::string& code) {
+    Lexer lexer(code);
+    Parser parser(lexer);
+    auto ast = parser.parse();
+    interpreter.evaluate(ast);
+}
+
+TEST(IntegerCellInterpreterTest, IntegerDivisionAndBitwiseOps) {
+    BasicInterpreter<int64_t> interpreter;
+    runCells(interpreter, "7 2 / 7 2 MOD 12 10 AND 12 3 OR");
+    const auto& stack = interpreter.getStack();
+    ASSERT_EQ(stack.size(), 4);
+    EXPECT_EQ(stack[0], 3);
+    EXPECT_EQ(stack[1], 1);
+    EXPECT_EQ(stack[2], 8);
+    EXPECT_EQ(stack[3], 15);
+    EXPECT_THROW(runCells(interpreter, "1 0 MOD"), std::runtime_error);
+}
+
+TEST(IntegerCellInterpreterTest, RejectsFractionalLiterals) {
+    BasicInterpreter<int32_t> interpreter;
+    EXPECT_THROW(runCells(interpreter, "3.5"), std::runtime_error);
+    EXPECT_THROW(runCells(interpreter, "5000000000"), std::runtime_error);
+    runCells(interpreter, "-420.0");
+    EXPECT_EQ(interpreter.getStack().back(), -420);
+}
+
+TEST(IntegerCellInterpreterTest, IntegerLiteralsAreExact) {
+    // Neither value survives a round trip through a double.
+    BasicInterpreter<int64_t> interpreter;
+    runCells(interpreter, "9223372036854775807 9007199254740993");
+    const auto& stack = interpreter.getStack();
+    ASSERT_EQ(stack.size(), 2);
+    EXPECT_EQ(stack[0], INT64_MAX);
+    EXPECT_EQ(stack[1], 9007199254740993);
+    EXPECT_THROW(runCells(interpreter, "9223372036854775808"), std::runtime_error);
+}
+
+TEST(IntegerCellInterpreterTest, WrapsOnOverflow) {
+    BasicInterpreter<int32_t> interpreter;
+    runCells(interpreter, "2147483647 1 +");
+    EXPECT_EQ(interpreter.getStack().back(), INT32_MIN);
+}
+
+TEST(IntegerCellInterpreterTest, MemoryAndLoops) {
+    BasicInterpreter<int64_t> interpreter;
+    runCells(interpreter, "5 0 DO I I * 300 I + ! LOOP 0 5 0 DO 300 I + @ + LOOP");
+    EXPECT_EQ(interpreter.getStack().back(), 30);
+    EXPECT_THROW(runCells(interpreter, "1 -1 !"), std::runtime_error);
+}
+
+TEST(StackCapacityTest, OverflowIsReported) {
+    InterpreterOptions options;
+    options.data_stack_depth = 4;
+    Interpreter interpreter(options);
+    run(interpreter, "1 2 3 4");
+    EXPECT_THROW(run(interpreter, "5"), std::runtime_error);
+    EXPECT_EQ(interpreter.getStack().size(), 4);
+    EXPECT_THROW(run(interpreter, "DROP 10 0 DO I LOOP"), std::runtime_error);
+}
+
+TEST(StackCapacityTest, ReturnStackOverflowIsReported) {
+    InterpreterOptions options;
+    options.return_stack_depth = 2;
+    Interpreter interpreter(options);
+    EXPECT_THROW(run(interpreter, "1 2 3 >R >R >R"), std::runtime_error);
+}
+
+TEST_F(InterpreterTest, StackIsConsistentAfterRuntimeError) {
+    run(interpreter, "1 2 3 0");
+    EXPECT_THROW(run(interpreter, "/"), std::runtime_error);
+    const auto& stack = interpreter.getStack();
+    ASSERT_EQ(stack.size(), 2);
+    EXPECT_EQ(stack[0], 1.0);
+    EXPECT_EQ(stack[1], 2.0);
+}
+
+TEST_F(InterpreterTest, MismatchedBranchesAreAllowedAtTopLevel) {
+    run(interpreter, "1 IF 1 2 ELSE 3 THEN");
+    EXPECT_EQ(interpreter.getStack().size(), 2);
+    EXPECT_THROW(run(interpreter, ": BAD IF 1 2 ELSE 3 THEN ;"), std::runtime_error);
+}
+
+TEST_F(InterpreterTest, RedefinitionMustKeepEffectCallersRelyOn) {
+    run(interpreter, ": SQUARE DUP * ; : CUBE DUP SQUARE * ;");
+    run(interpreter, ": SQUARE DUP DUP * * ;"); // same net effect: fine
+    run(interpreter, "2 CUBE");
+    EXPECT_EQ(interpreter.getStack().back(), 16.0);
+    EXPECT_THROW(run(interpreter, ": SQUARE DUP * DUP ;"), std::runtime_error);
+}
+
+TEST_F(InterpreterTest, ProvenWordStillReportsUnderflowOnEntry) {
+    run(interpreter, ": ADD3 + + ;");
+    run(interpreter, "1 2");
+    EXPECT_THROW(run(interpreter, "ADD3"), std::runtime_error);
+    EXPECT_EQ(interpreter.getStack().size(), 2);
+}
+
+template <typename Cell>
+std::vector<Cell> stackAtOptLevel(int level, const std::string& code) {
+    InterpreterOptions options;
+    options.optimizer.level = level;
+    BasicInterpreter<Cell> interpreter(options);
+    runCells(interpreter, code);
+    return interpreter.getStack();
+}
+
+TEST(OptimizerInterpreterTest, OptimizationLevelsAgree) {
+    const std::string program = R"(
+        : MAX OVER OVER > IF DROP ELSE SWAP DROP THEN ;
+        0 100 ! 1 101 !
+        12 2 DO I 1 - 100 + @ I 2 - 100 + @ + I 100 + ! LOOP
+        111 @ 5 MAX 10 DUP * 3 * 7 - 2 MOD NOT 2147483647 1 + 1 +
+    )";
+    for (int level = 1; level <= kMaxOptLevel; ++level) {
+        EXPECT_EQ(stackAtOptLevel<double>(level, program), stackAtOptLevel<double>(0, program));
+        EXPECT_EQ(stackAtOptLevel<int32_t>(level, program), stackAtOptLevel<int32_t>(0, program));
+    }
+}
+
+TEST(OptimizerInterpreterTest, FusedFetchReportsOutOfBounds) {
+    Interpreter interpreter;
+    run(interpreter, "7");
+    EXPECT_THROW(run(interpreter, "70000 69999 DO I 5 + @ LOOP"), std::runtime_error);
+    ASSERT_EQ(interpreter.getStack().size(), 1);
+    EXPECT_EQ(interpreter.getStack()[0], 7.0);
+}
+
+TEST_F(InterpreterTest, TailRecursionRunsInConstantFrames) {
+    InterpreterOptions options;
+    options.call_depth = 64;
+    Interpreter shallow(options);
+    run(shallow, ": DOWN DUP 0 > IF 1 - DOWN THEN ; 100000 DOWN");
+    ASSERT_EQ(shallow.getStack().size(), 1);
+    EXPECT_EQ(shallow.getStack()[0], 0.0);
+
+    // The same recursion with work left after the call needs a frame per level.
+    EXPECT_THROW(run(shallow, ": UP DUP 0 > IF 1 - UP 1 + THEN ; 100 UP"), std::runtime_error);
+}
+
+TEST_F(InterpreterTest, RedefinitionReachesInlinedCallers) {
+    // BASE's zero-trip loop keeps its effect unproven, so it may be rebound
+    // by a nested definition at run time.
+    run(interpreter, ": BASE 1 0 0 DO DUP LOOP ; : USE BASE 10 * ; : TWICE USE USE + ;");
+    run(interpreter, "TWICE");
+    run(interpreter, "1 IF : BASE 2 ; THEN TWICE");
+    run(interpreter, ": BASE 3 ; TWICE");
+    const auto& stack = interpreter.getStack();
+    ASSERT_EQ(stack.size(), 3);
+    EXPECT_EQ(stack[0], 20.0);
+    EXPECT_EQ(stack[1], 40.0);
+    EXPECT_EQ(stack[2], 60.0);
+}
+
+TEST(LoopControlTest, BothModesAgree) {
+    const std::string code = R"(
+        : UP 10 0 DO I 3 +LOOP ;
+        : DOWN 0 10 ?DO I -1 +LOOP ;
+        : SKIPPED 0 10 DO I -1 +LOOP 5 5 ?DO I LOOP ;
+        : FIND 100 0 DO I 7 * 50 > IF I LEAVE THEN LOOP ;
+        : PAIR 10 0 DO 5 0 DO I J * 6 = IF I J UNLOOP UNLOOP EXIT THEN LOOP LOOP 99 ;
+        : EARLY DUP 0 = IF DROP 42 EXIT THEN 1 + ;
+        : INDEX I ;
+        : CALLED 3 0 DO INDEX LOOP ;
+        UP DOWN SKIPPED FIND PAIR 0 EARLY 5 EARLY CALLED
+        10 0 DO I 5 = IF LEAVE THEN I LOOP
+    )";
+    Interpreter vm;
+    Interpreter walker(ExecutionMode::TreeWalk);
+    run(vm, code);
+    run(walker, code);
+    EXPECT_EQ(vm.getStack(), walker.getStack());
+
+    std::vector<double> expected = {0, 3, 6, 9, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0, 8, 3, 2, 42, 6, 0, 1, 2,
+                                    0, 1, 2, 3, 4};
+    EXPECT_EQ(vm.getStack(), expected);
+}
+
+TEST(LoopControlTest, FramesAreReleasedByLeaveAndExit) {
+    for (ExecutionMode mode : {ExecutionMode::Bytecode, ExecutionMode::TreeWalk}) {
+        Interpreter interpreter(mode);
+        // Any frame left behind would be what INDEX reads instead of failing.
+        run(interpreter, ": INDEX I ; : GONE 5 0 DO UNLOOP EXIT LOOP ; 3 0 DO LEAVE LOOP GONE");
+        EXPECT_THROW(run(interpreter, "INDEX"), std::runtime_error);
+        EXPECT_TRUE(interpreter.getStack().empty());
+    }
+}
+
+TEST(ByteMemoryTest, BothModesAgree) {
+    const std::string code = R"(
+        65 1000 C! 66 1001 C! 1000 C@ 1001 C@ 1000 2 TYPE
+        300 1002 C! 1002 C@
+        0 125 ! 1000 C@ 125 @
+        1000 5 ACCEPT 1000 SWAP >NUMBER
+    )";
+    for (ExecutionMode mode : {ExecutionMode::Bytecode, ExecutionMode::TreeWalk}) {
+        Interpreter interpreter(mode);
+        std::ostringstream output;
+        std::istringstream input("42\n");
+        std::streambuf* saved_out = std::cout.rdbuf(output.rdbuf());
+        std::streambuf* saved_in = std::cin.rdbuf(input.rdbuf());
+        run(interpreter, code);
+        std::cout.rdbuf(saved_out);
+        std::cin.rdbuf(saved_in);
+
+        // Byte 1000 lives in cell 125, which the ! clears again.
+        std::vector<double> expected = {65, 66, 44, 0, 0, 42};
+        EXPECT_EQ(interpreter.getStack(), expected);
+        EXPECT_EQ(output.str(), "AB");
+    }
+}
+
+TEST(ByteMemoryTest, BytesAreBoundedByTheSizeOfMemory) {
+    Interpreter interpreter;
+    size_t bytes = kMemoryCells * sizeof(double);
+    run(interpreter, std::to_string(bytes - 1) + " C@");
+    EXPECT_THROW(run(interpreter, std::to_string(bytes) + " C@"), std::runtime_error);
+    EXPECT_THROW(run(interpreter, "1 -1 C!"), std::runtime_error);
+    EXPECT_THROW(run(interpreter, std::to_string(bytes - 1) + " 2 TYPE"), std::runtime_error);
+    ASSERT_EQ(interpreter.getStack().size(), 1);
+    EXPECT_EQ(interpreter.getStack()[0], 0.0);
+}
+
+TEST(MemorySizeTest, MemoryHasTheConfiguredSize) {
+    for (ExecutionMode mode : {ExecutionMode::Bytecode, ExecutionMode::TreeWalk}) {
+        InterpreterOptions small;
+        small.mode = mode;
+        small.memory_cells = 16;
+        Interpreter tiny(small);
+        run(tiny, "5 15 ! 15 @ 127 C@");
+        EXPECT_THROW(run(tiny, "16 @"), std::runtime_error);
+        EXPECT_THROW(run(tiny, "128 C@"), std::runtime_error);
+
+        // Far more than the default, and only the touched pages are committed.
+        InterpreterOptions large;
+        large.mode = mode;
+        large.memory_cells = size_t(1) << 30;
+        large.huge_pages = true;
+        Interpreter huge(large);
+        run(huge, "9 1073741823 ! 1073741823 @ 0 @ 8589934583 C@");
+        std::vector<double> expected = {9, 0, 0};
+        EXPECT_EQ(huge.getStack(), expected);
+        EXPECT_THROW(run(huge, "1073741824 @"), std::runtime_error);
+    }
+}
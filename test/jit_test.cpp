@@ -0,0 +1,180 @@
+#include <gtest/gtest.h>
+#include "Interpreter.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+// What a program did: everything it printed, the stack it left and the
+// error it stopped with, if any.
+template <typename Cell>
+struct Outcome {
+    std::string output;
+    std::vector<Cell> stack;
+    std::string error;
+
+    bool operator==(const Outcome& other) const {
+        return output == other.output && stack == other.stack && error == other.error;
+    }
+};
+
+template <typename Cell>
+void evaluate(BasicInterpreter<Cell>& interpreter, const std::string& code) {
+    Lexer lexer(code);
+    Parser parser(lexer);
+    auto ast = parser.parse();
+    interpreter.evaluate(ast);
+}
+
+template <typename Cell>
+Outcome<Cell> runProgram(const std::string& code, bool jit, const std::string& input = "") {
+    InterpreterOptions options;
+    options.jit = jit;
+    BasicInterpreter<Cell> interpreter(options);
+
+    std::ostringstream output;
+    std::istringstream in(input);
+    std::streambuf* saved_out = std::cout.rdbuf(output.rdbuf());
+    std::streambuf* saved_in = std::cin.rdbuf(in.rdbuf());
+    Outcome<Cell> outcome;
+    try {
+        evaluate(interpreter, code);
+    } catch (const std::exception& e) {
+        outcome.error = e.what();
+    }
+    std::cout.rdbuf(saved_out);
+    std::cin.rdbuf(saved_in);
+
+    outcome.output = output.str();
+    outcome.stack = interpreter.getStack();
+    return outcome;
+}
+
+std::string readFile(const std::filesystem::path& path) {
+    std::ifstream file(path);
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    return buffer.str();
+}
+
+template <typename Cell>
+void expectSameAsVm(const std::string& code) {
+    Outcome<Cell> vm = runProgram<Cell>(code, false);
+    Outcome<Cell> jit = runProgram<Cell>(code, true);
+    EXPECT_EQ(jit.output, vm.output) << code;
+    EXPECT_EQ(jit.stack, vm.stack) << code;
+    EXPECT_EQ(jit.error, vm.error) << code;
+}
+
+} // namespace
+
+TEST(JitTest, ProgramsBehaveAsOnTheVm) {
+    size_t programs = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(PELI_PROGRAMS_DIR)) {
+        if (entry.path().extension() != ".peli") {
+            continue;
+        }
+        SCOPED_TRACE(entry.path().filename().string());
+        std::string code = readFile(entry.path());
+        EXPECT_TRUE(runProgram<double>(code, true, "212\n") == runProgram<double>(code, false, "212\n"));
+        EXPECT_TRUE(runProgram<int64_t>(code, true, "212\n") == runProgram<int64_t>(code, false, "212\n"));
+        ++programs;
+    }
+    EXPECT_GT(programs, 0u);
+}
+
+TEST(JitTest, CompilesLoopsToNativeRuns) {
+    if (!BasicJit<double>::supported) {
+        GTEST_SKIP() << "no JIT on this platform";
+    }
+    InterpreterOptions options;
+    options.jit = true;
+    Interpreter interpreter(options);
+    evaluate(interpreter, ": SUMSQ 0 SWAP 0 DO I DUP * + LOOP ;");
+    const CodeSpace& space = interpreter.getCodeSpace();
+    EXPECT_NE(disassemble(space, 0, space.code.size()).find("Native"), std::string::npos);
+
+    evaluate(interpreter, "10 SUMSQ");
+    ASSERT_EQ(interpreter.getStack().size(), 1);
+    EXPECT_EQ(interpreter.getStack()[0], 285.0);
+}
+
+TEST(JitTest, ArithmeticAndBranchesMatchTheVm) {
+    const std::string program = R"(
+        : ABS DUP 0 < IF 0 SWAP - THEN ;
+        : CLAMP OVER OVER > IF SWAP DROP ELSE DROP THEN ;
+        -7 ABS 7 ABS 12 5 CLAMP 3 9 CLAMP
+        5 3 < 5 3 > 5 5 = 3 NOT 0 NOT 1 2 3 ROT 12 10 AND 12 10 OR
+        2147483647 DUP * 1 +
+    )";
+    expectSameAsVm<double>(program);
+    expectSameAsVm<int64_t>(program);
+    expectSameAsVm<double>("2.5 0.5 - 1.5 * 0.1 0.2 + 0.3 = 0 -1 * NOT");
+}
+
+TEST(JitTest, NestedLoopsSeeTheirIndices) {
+    const std::string program = R"(
+        : NEST 0 3 0 DO 4 0 DO 5 1 DO I J K + + + I J * - LOOP LOOP LOOP ;
+        : EMPTY 5 5 DO I LOOP 2 7 DO I LOOP ;
+        : STEPS 3.7 0.2 DO I LOOP ;
+        : TABLE 100 0 DO I I 7 * SWAP ! LOOP 0 100 0 DO I 10 + @ + LOOP ;
+        NEST EMPTY STEPS TABLE
+    )";
+    expectSameAsVm<double>(program);
+    expectSameAsVm<int64_t>(program);
+}
+
+TEST(JitTest, NativeErrorsLeaveTheVmStack) {
+    for (const char* program : {
+             ": UNDER DROP DROP DROP 1 2 + ; 1 UNDER",
+             ": LOW 1 2 -1 @ ; 9 LOW",
+             ": HIGH 1 2 99999 @ ; 9 HIGH",
+             ": PUT 5 99999 ! ; 7 PUT",
+             ": SCAN 10 0 DO I 65530 + @ DROP LOOP ; 1 2 SCAN",
+             ": DEEP 0 DO 1 2 3 LOOP ; 2000 DEEP",
+         }) {
+        expectSameAsVm<double>(program);
+        expectSameAsVm<int64_t>(program);
+    }
+}
+
+TEST(JitTest, RedefinitionReachesNativeCallers) {
+    const std::string program = R"(
+        : SQ DUP * ;
+        : SUMSQ 0 SWAP 0 DO I SQ + LOOP 1 2 + ;
+        4 SUMSQ
+        : SQ DUP DUP * * ;
+        4 SUMSQ
+    )";
+    expectSameAsVm<double>(program);
+    expectSameAsVm<int64_t>(program);
+}
+
+TEST(JitTest, LoopControlMatchesTheVm) {
+    const std::string program = R"(
+        : UP 0 1000 0 DO I + 3 +LOOP ;
+        : DOWN 0 0 1000 ?DO I + -7 +LOOP ;
+        : FIND 100 0 DO 10 0 DO I J * 42 = IF I LEAVE THEN LOOP LOOP ;
+        : PAIR 10 0 DO 5 0 DO I J * 6 = IF I J UNLOOP UNLOOP EXIT THEN LOOP LOOP 99 ;
+        UP DOWN FIND PAIR 5 5 ?DO 1 LOOP
+    )";
+    expectSameAsVm<double>(program);
+    expectSameAsVm<int64_t>(program);
+}
+
+TEST(JitTest, ByteAccessMatchesTheVm) {
+    const std::string program = R"(
+        : FILL 1100 1000 DO I 7 * I C! LOOP ;
+        : SUM 0 1100 1000 DO I C@ + LOOP ;
+        FILL SUM 125 @ 0 = 1000 C@
+        : HIGH 1 2 524288 C@ ; 9 HIGH
+    )";
+    expectSameAsVm<double>(program);
+    expectSameAsVm<int64_t>(program);
+    expectSameAsVm<double>(": LOW 1 2 3 -1 C! ; 9 LOW");
+    expectSameAsVm<int64_t>(": LAST 5 524287 C! 524287 C@ ; LAST");
+}
@@ -1,5 +1,15 @@
 #include <gtest/gtest.h>
 #include "lexer.hpp"
+#include "ByteScanner.hpp"
+#include "SourceFile.hpp"
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <utility>
+#include <vector>
 
 void verify_token(Lexer& lexer, TokenType expected_type, const std::string& expected_text) {
     Token token = lexer.getNextToken();
@@ -47,3 +57,216 @@ TEST(LexerTest, HandlesFloatingPointNumbers) {
     verify_token(lexer, TokenType::Multiply, "*");
     verify_token(lexer, TokenType::EndOfFile, "");
 }
+
+TEST(LexerTest, HandlesLoopControlWords) {
+    std::string input = "?DO +LOOP LEAVE UNLOOP EXIT +1";
+    Lexer lexer(input);
+    verify_token(lexer, TokenType::QDo, "?DO");
+    verify_token(lexer, TokenType::PlusLoop, "+LOOP");
+    verify_token(lexer, TokenType::Leave, "LEAVE");
+    verify_token(lexer, TokenType::Unloop, "UNLOOP");
+    verify_token(lexer, TokenType::Exit, "EXIT");
+    verify_token(lexer, TokenType::Number, "+1");
+    verify_token(lexer, TokenType::EndOfFile, "");
+}
+
+TEST(LexerTest, TokensAreSlicesOfTheSource) {
+    std::string input = ": SQ DUP * ; .\" done\" 1234567890123";
+    Lexer lexer(input);
+    const char* begin = input.data();
+    const char* end = begin + input.size();
+    for (Token token = lexer.getNextToken(); token.type != TokenType::EndOfFile; token = lexer.getNextToken()) {
+        EXPECT_GE(token.text.data(), begin) << token.text;
+        EXPECT_LE(token.text.data() + token.text.size(), end) << token.text;
+    }
+}
+
+TEST(LexerTest, SourceFileHoldsTheWholeProgram) {
+    std::string path = std::string(PELI_PROGRAMS_DIR) + "/bubble_sort.peli";
+    std::ifstream file(path, std::ios::binary);
+    std::stringstream expected;
+    expected << file.rdbuf();
+
+    SourceFile source(path);
+    EXPECT_EQ(source.text(), expected.str());
+    EXPECT_THROW(SourceFile(std::string(PELI_PROGRAMS_DIR) + "/missing.peli"), std::runtime_error);
+}
+
+TEST(LexerTest, RecognizesEveryBuiltinAndNothingElse) {
+    std::string input = "+ - * / MOD /MOD DUP DROP SWAP OVER ROT >R R> R@ = < > AND OR NOT ! @ : ; "
+                        "IF ELSE THEN DO LOOP ?DO +LOOP LEAVE UNLOOP EXIT I J K . .S EMIT CR ACCEPT >NUMBER";
+    Lexer lexer(input);
+    size_t builtins = 0;
+    for (Token token = lexer.getNextToken(); token.type != TokenType::EndOfFile; token = lexer.getNextToken()) {
+        EXPECT_NE(token.type, TokenType::Word) << token.text;
+        ++builtins;
+    }
+    EXPECT_EQ(builtins, 43u);
+
+    for (const char* word : {"dup", "DUPE", "DU", "M", "MO", "/MO", "R", ">RR", "IFF", "II", "..", "LOO", ">NUMBERS"}) {
+        TokenType type;
+        EXPECT_FALSE(lookupKeyword(word, type)) << word;
+    }
+}
+
+TEST(LexerTest, NumbersCarryTheirParsedValue) {
+    Lexer lexer("42 +7 -0 9223372036854775807 -9223372036854775808 9223372036854775808 1.5 1e3 0x10 -inf 1- +-1 0x-1 1.5x");
+    auto next = [&lexer] { return lexer.getNextToken(); };
+
+    Token token = next();
+    ASSERT_EQ(token.type, TokenType::Number);
+    EXPECT_TRUE(token.integral);
+    EXPECT_EQ(token.integer, 42);
+    EXPECT_EQ(token.number, 42.0);
+
+    token = next();
+    EXPECT_TRUE(token.integral);
+    EXPECT_EQ(token.integer, 7);
+
+    token = next();
+    EXPECT_TRUE(token.integral);
+    EXPECT_EQ(token.integer, 0);
+    EXPECT_TRUE(std::signbit(token.number));
+
+    token = next();
+    EXPECT_TRUE(token.integral);
+    EXPECT_EQ(token.integer, INT64_MAX);
+
+    token = next();
+    EXPECT_TRUE(token.integral);
+    EXPECT_EQ(token.integer, INT64_MIN);
+
+    // Past int64, integers are still numbers but only as doubles.
+    token = next();
+    ASSERT_EQ(token.type, TokenType::Number);
+    EXPECT_FALSE(token.integral);
+    EXPECT_EQ(token.number, 9223372036854775808.0);
+
+    for (double expected : {1.5, 1000.0, 16.0, -HUGE_VAL}) {
+        token = next();
+        ASSERT_EQ(token.type, TokenType::Number) << token.text;
+        EXPECT_FALSE(token.integral) << token.text;
+        EXPECT_EQ(token.number, expected) << token.text;
+    }
+
+    for (const char* word : {"1-", "+-1", "0x-1", "1.5x"}) {
+        token = next();
+        EXPECT_EQ(token.type, TokenType::Word) << word;
+        EXPECT_EQ(token.text, word);
+    }
+}
+
+TEST(LexerTest, StreamedSourceLexesLikeAString) {
+    std::string input = ": SQ ( n -- n*n ( nested ) ) DUP * ;\n\n"
+                        "10 0 DO I SQ . LOOP .\" a string\n spanning lines\" CR\n"
+                        "  -1.5e3 0x10 UNLOOP.\" x\" .\"\n( unterminated";
+    std::vector<std::pair<TokenType, std::string>> expected;
+    Lexer whole(input);
+    for (Token token = whole.getNextToken(); token.type != TokenType::EndOfFile; token = whole.getNextToken()) {
+        expected.emplace_back(token.type, std::string(token.text));
+    }
+
+    // Buffers much smaller than a token make every token straddle a refill.
+    for (size_t chunk : {1, 2, 3, 7, 4096}) {
+        std::istringstream in(input);
+        Lexer lexer(in, chunk);
+        Token current = lexer.getNextToken();
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT_EQ(current.type, expected[i].first) << chunk << ": " << i;
+            EXPECT_EQ(current.text, expected[i].second) << chunk << ": " << i;
+            Token next = lexer.peekToken();
+            // The current token survives a peek past it.
+            EXPECT_EQ(current.text, expected[i].second) << chunk << ": " << i;
+            Token taken = lexer.getNextToken();
+            EXPECT_EQ(taken.type, next.type);
+            current = taken;
+        }
+        EXPECT_EQ(current.type, TokenType::EndOfFile) << chunk;
+    }
+}
+
+TEST(LexerTest, ScannersAgree) {
+    // Dense in the bytes the scanners look for, at every alignment and
+    // length, so both the vector loops and their scalar tails are covered.
+    const char alphabet[] = {' ', '\t', '\n', '\v', '\f', '\r', '(', ')', '"', 'a', '\x08', '\x0e', '\x80', '\xff'};
+    std::mt19937 random(12345);
+    std::string text(300, ' ');
+    for (char& c : text) {
+        c = alphabet[random() % sizeof(alphabet)];
+    }
+
+    const ByteScanner& scalar = *ByteScanner::available().front();
+    const char* data = text.data();
+    for (const ByteScanner* scanner : ByteScanner::available()) {
+        for (size_t begin = 0; begin < 80; ++begin) {
+            for (size_t end = begin; end <= text.size(); end += 7) {
+                EXPECT_EQ(scanner->skipSpace(data + begin, data + end), scalar.skipSpace(data + begin, data + end))
+                    << scanner->name << " " << begin << " " << end;
+                EXPECT_EQ(scanner->findSpace(data + begin, data + end), scalar.findSpace(data + begin, data + end))
+                    << scanner->name << " " << begin << " " << end;
+                EXPECT_EQ(scanner->findParen(data + begin, data + end), scalar.findParen(data + begin, data + end))
+                    << scanner->name << " " << begin << " " << end;
+            }
+        }
+    }
+}
+
+TEST(LexerTest, SkipsAnyNumberOfCommentsWithoutRecursing) {
+    std::string input;
+    for (int i = 0; i < 1000000; ++i) {
+        input += "( c ) ";
+    }
+    input += std::string(100, ' ') + "DUP";
+    for (const ByteScanner* scanner : ByteScanner::available()) {
+        Lexer lexer(input, *scanner);
+        Token token = lexer.getNextToken();
+        EXPECT_EQ(token.type, TokenType::Dup) << scanner->name;
+        EXPECT_EQ(lexer.getNextToken().type, TokenType::EndOfFile) << scanner->name;
+    }
+}
+
+TEST(SymbolTest, WordsAndBuiltinsCarryTheirInternedName) {
+    Lexer lexer("SQUARE-OF-LEXED DUP SQUARE-OF-LEXED .\" text\" 5");
+    Token first = lexer.getNextToken();
+    Token dup = lexer.getNextToken();
+    Token again = lexer.getNextToken();
+    EXPECT_EQ(first.symbol, again.symbol);
+    EXPECT_NE(first.symbol, dup.symbol);
+    EXPECT_EQ(symbolName(first.symbol), "SQUARE-OF-LEXED");
+    EXPECT_EQ(dup.symbol, internSymbol("DUP"));
+    EXPECT_EQ(lexer.getNextToken().symbol, kNoSymbol);
+    EXPECT_EQ(lexer.getNextToken().symbol, kNoSymbol);
+
+    EXPECT_EQ(findSymbol("NEVER-INTERNED-ANYWHERE"), kNoSymbol);
+    EXPECT_EQ(findSymbol("SQUARE-OF-LEXED"), first.symbol);
+    EXPECT_EQ(symbolName(internSymbol("")), "");
+}
+
+TEST(SymbolTest, ThreadsAgreeOnEverySymbol) {
+    std::vector<std::string> names;
+    for (int i = 0; i < 20000; ++i) {
+        names.push_back("THREADED-" + std::to_string(i));
+    }
+    std::vector<std::vector<Symbol>> seen(4, std::vector<Symbol>(names.size()));
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < seen.size(); ++t) {
+        threads.emplace_back([&, t]() {
+            // Each thread takes the names in its own order: the strides
+            // are prime to the count, so every name is taken.
+            static const size_t strides[] = {1, 3, 7, 9};
+            for (size_t i = 0; i < names.size(); ++i) {
+                size_t at = (i * strides[t] + t * 977) % names.size();
+                seen[t][at] = internSymbol(names[at]);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    for (size_t i = 0; i < names.size(); ++i) {
+        for (size_t t = 1; t < seen.size(); ++t) {
+            ASSERT_EQ(seen[t][i], seen[0][i]) << names[i];
+        }
+        ASSERT_EQ(symbolName(seen[0][i]), names[i]);
+    }
+}
@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+#include "ModeTest.hpp"
+#include "TempPath.hpp"
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace {
+
+// Code that stores `text` in the bytes from 0 and leaves `0 length` for
+// MAP-FILE to take as its name.
+std::string nameAtZero(const std::string& text) {
+    return bytesAt(0, text) + "0 " + std::to_string(text.size()) + " ";
+}
+
+// ( base len -- sum )
+const char* const kSum = ": SUM 0 ROT ROT OVER + SWAP DO I @ + LOOP ; ";
+
+} // namespace
+
+class MapFileTest : public ModeTest {
+protected:
+    void TearDown() override { std::filesystem::remove(path); }
+
+    template <typename Cell>
+    void writeCells(size_t count) const {
+        std::vector<Cell> cells(count);
+        for (size_t i = 0; i < count; ++i) {
+            cells[i] = static_cast<Cell>(i + 1);
+        }
+        std::ofstream(path, std::ios::binary | std::ios::trunc)
+            .write(reinterpret_cast<const char*>(cells.data()), static_cast<std::streamsize>(count * sizeof(Cell)));
+    }
+
+    const std::string path = tempPath(".bin");
+};
+
+TEST_P(MapFileTest, ReadsFilesInPlace) {
+    writeCells<double>(3000);
+    Interpreter interpreter(options());
+    evaluate(interpreter, std::string(kSum) + nameAtZero(path) + "0 MAP-FILE OVER ROT ROT SUM");
+    const auto& stack = interpreter.getStack();
+    ASSERT_EQ(stack.size(), 2);
+    EXPECT_EQ(stack[1], 3000.0 * 3001.0 / 2);
+    // Mapped at the top of memory, on a page boundary.
+    size_t base = static_cast<size_t>(stack[0]);
+    EXPECT_GE(base, kMemoryCells - 4096);
+    EXPECT_EQ(base * sizeof(double) % 4096, 0u);
+}
+
+TEST_P(MapFileTest, ReadOnlyFilesRejectStores) {
+    writeCells<int64_t>(100);
+    BasicInterpreter<int64_t> interpreter(options());
+    // The loops make the stores native under the JIT.
+    evaluate(interpreter, ": PUT 1 0 DO OVER OVER ! LOOP DROP DROP ; : PUTC 1 0 DO OVER OVER C! LOOP DROP DROP ; " +
+                              nameAtZero(path) + "0 MAP-FILE DROP");
+    std::string base = std::to_string(interpreter.getStack()[0]);
+    EXPECT_EQ(errorOf(interpreter, "5 " + base + " PUT"), "Store into read-only memory");
+    EXPECT_EQ(errorOf(interpreter, "5 " + base + " 8 * 803 + PUTC"), "Store into read-only memory");
+    EXPECT_EQ(errorOf(interpreter, base + " 8 * 4 ACCEPT"), "ACCEPT into read-only memory");
+
+    // Memory below the file is as writable as ever, and the file still reads.
+    evaluate(interpreter, "7 " + base + " 1 - PUT " + base + " 1 - @ " + base + " 99 + @");
+    std::vector<int64_t> stack = interpreter.getStack();
+    ASSERT_GE(stack.size(), 2u);
+    EXPECT_EQ(stack[stack.size() - 2], 7);
+    EXPECT_EQ(stack.back(), 100);
+}
+
+TEST_P(MapFileTest, CopyOnWriteFilesKeepTheirContents) {
+    writeCells<int64_t>(10);
+    {
+        BasicInterpreter<int64_t> interpreter(options());
+        // A read-only view of the file goes below the copy, so stores into
+        // the copy are above the store limit and take the slow path.
+        evaluate(interpreter, std::string(kSum) + ": BUMP OVER + SWAP DO I @ 10 * I ! LOOP ; " + nameAtZero(path) +
+                                  "1 MAP-FILE " + nameAtZero(path) + "0 MAP-FILE DROP DROP OVER OVER BUMP SUM");
+        EXPECT_EQ(interpreter.getStack(), std::vector<int64_t>{550});
+    }
+    BasicInterpreter<int64_t> interpreter(options());
+    evaluate(interpreter, std::string(kSum) + nameAtZero(path) + "0 MAP-FILE SUM");
+    EXPECT_EQ(interpreter.getStack(), std::vector<int64_t>{55});
+}
+
+TEST_P(MapFileTest, UnmapRestoresZeroedMemory) {
+    writeCells<double>(10);
+    Interpreter interpreter(options());
+    std::string map = nameAtZero(path) + "0 MAP-FILE DROP ";
+    evaluate(interpreter, map + map + "OVER UNMAP OVER @ OVER @ " + map);
+    // The second file went below the first and is still there; the third
+    // takes the range the first gave back.
+    std::vector<double> stack = interpreter.getStack();
+    ASSERT_EQ(stack.size(), 5);
+    EXPECT_LT(stack[1], stack[0]);
+    EXPECT_EQ(stack[2], 0.0);
+    EXPECT_EQ(stack[3], 1.0);
+    EXPECT_EQ(stack[4], stack[0]);
+
+    EXPECT_EQ(errorOf(interpreter, "12345 UNMAP"), "No file is mapped at 12345");
+    EXPECT_EQ(errorOf(interpreter, nameAtZero(path + ".missing") + "0 MAP-FILE"),
+              "Could not open file '" + path + ".missing'");
+    EXPECT_EQ(errorOf(interpreter, nameAtZero(path) + "2 MAP-FILE"),
+              "MAP-FILE mode must be 0 (read-only) or 1 (copy-on-write)");
+}
+
+TEST_P(MapFileTest, SmallMemoryCannotMapFiles) {
+    writeCells<double>(10);
+    InterpreterOptions small = options();
+    small.memory_cells = 1024;
+    Interpreter interpreter(small);
+    EXPECT_THROW(evaluate(interpreter, nameAtZero(path) + "0 MAP-FILE"), std::runtime_error);
+}
+
+INSTANTIATE_TEST_SUITE_P(Modes, MapFileTest, ::testing::ValuesIn(kModes), modeName);
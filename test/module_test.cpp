@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+#include "TempPath.hpp"
+#include "Interpreter.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include <filesystem>
+#include <fstream>
+
+namespace {
+
+class ModuleTest : public ::testing::TestWithParam<ExecutionMode> {
+protected:
+    void TearDown() override { std::filesystem::remove_all(dir); }
+
+    void write(const std::string& name, const std::string& text) {
+        std::filesystem::path path = std::filesystem::path(dir) / name;
+        std::filesystem::create_directories(path.parent_path());
+        std::ofstream(path) << text;
+    }
+
+    void run(Interpreter& interpreter, const std::string& code) {
+        Lexer lexer(code);
+        Parser parser(lexer);
+        interpreter.evaluate(parser.parse(), dir);
+    }
+
+    const std::string dir = tempPath();
+};
+
+} // namespace
+
+TEST_P(ModuleTest, IncludesRunInSourceOrder) {
+    // Each module sees the definitions made before its INCLUDE, and the
+    // program sees its own definitions replaced by later modules.
+    write("a.peli", ": TWICE BASE 2 * ; 1");
+    write("lib/b.peli", "TWICE : BASE 100 ;");
+    write("lib/c.peli", "TWICE");
+    Interpreter interpreter(GetParam());
+    run(interpreter, ": BASE 10 ; INCLUDE a.peli INCLUDE lib/b.peli INCLUDE lib/c.peli");
+    EXPECT_EQ(interpreter.getStack(), (std::vector<double>{1, 20, 200}));
+}
+
+TEST_P(ModuleTest, RequireLoadsOnce) {
+    write("lib/counter.peli", ": NEXT 0 ! ; 7");
+    write("lib/user.peli", "REQUIRE counter.peli REQUIRE ./counter.peli");
+    Interpreter interpreter(GetParam());
+    run(interpreter, "REQUIRE lib/counter.peli REQUIRE lib/user.peli INCLUDE lib/counter.peli");
+    EXPECT_EQ(interpreter.getStack(), (std::vector<double>{7, 7}));
+
+    // Later programs on the same interpreter share what has been loaded.
+    run(interpreter, "REQUIRE lib/user.peli");
+    EXPECT_EQ(interpreter.getStack().size(), 2u);
+}
+
+TEST_P(ModuleTest, ReportsMissingFilesAndCycles) {
+    write("bad.peli", "1 IF");
+    write("loop.peli", "INCLUDE again.peli");
+    write("again.peli", "INCLUDE loop.peli");
+    write("fine.peli", "REQUIRE fine.peli 5");
+    Interpreter interpreter(GetParam());
+    EXPECT_THROW(run(interpreter, "INCLUDE missing.peli"), std::runtime_error);
+    // Nothing runs when any module fails to parse.
+    EXPECT_THROW(run(interpreter, "1 INCLUDE bad.peli"), std::runtime_error);
+    EXPECT_TRUE(interpreter.getStack().empty());
+    EXPECT_THROW(run(interpreter, "INCLUDE loop.peli"), std::runtime_error);
+
+    run(interpreter, "INCLUDE fine.peli");
+    EXPECT_EQ(interpreter.getStack(), (std::vector<double>{5}));
+}
+
+TEST_P(ModuleTest, LoadsManyModules) {
+    std::string program;
+    for (int i = 0; i < 40; ++i) {
+        std::string name = "m" + std::to_string(i);
+        write(name + ".peli", ": W" + std::to_string(i) + " " + std::to_string(i) + " ; REQUIRE shared.peli");
+        program += "INCLUDE " + name + ".peli ";
+    }
+    write("shared.peli", ": SUM 39 0 DO + LOOP ;");
+    for (int i = 0; i < 40; ++i) {
+        program += "W" + std::to_string(i) + " ";
+    }
+    Interpreter interpreter(GetParam());
+    run(interpreter, program + "SUM");
+    EXPECT_EQ(interpreter.getStack(), (std::vector<double>{780}));
+}
+
+INSTANTIATE_TEST_SUITE_P(Modes, ModuleTest, ::testing::Values(ExecutionMode::Bytecode, ExecutionMode::TreeWalk));
@@ -2,30 +2,37 @@
 #include "lexer.hpp"
 #include "parser.hpp"
 #include "ast.hpp"
+#include <sstream>
+#include <vector>
+
+static std::vector<const AstNode*> children(const AstNode& node) {
+    std::vector<const AstNode*> nodes;
+    for (const AstNode& child : node.children()) {
+        nodes.push_back(&child);
+    }
+    return nodes;
+}
 
 TEST(ParserTest, ConstructsCorrectAstForForthSequence) {
     std::string input = "10 5 DUP";
     Lexer lexer(input);
     Parser parser(lexer);
 
-    std::unique_ptr<ProgramNode> ast = parser.parse();
-    ASSERT_NE(ast, nullptr);
+    Ast ast = parser.parse();
+    ASSERT_EQ(ast.root().kind(), AstKind::Block);
 
-    const auto& nodes = ast->getNodes();
+    auto nodes = children(ast.root());
     ASSERT_EQ(nodes.size(), 3);
 
-    auto* node1 = dynamic_cast<NumberNode*>(nodes[0].get());
-    ASSERT_NE(node1, nullptr);
-    EXPECT_EQ(node1->getValue(), 10.0);
+    ASSERT_EQ(nodes[0]->kind(), AstKind::Number);
+    EXPECT_EQ(nodes[0]->getValue(), 10.0);
 
-    auto* node2 = dynamic_cast<NumberNode*>(nodes[1].get());
-    ASSERT_NE(node2, nullptr);
-    EXPECT_EQ(node2->getValue(), 5.0);
+    ASSERT_EQ(nodes[1]->kind(), AstKind::Number);
+    EXPECT_EQ(nodes[1]->getValue(), 5.0);
 
-    auto* node3 = dynamic_cast<WordNode*>(nodes[2].get());
-    ASSERT_NE(node3, nullptr);
-    EXPECT_EQ(node3->getToken().text, "DUP");
-    EXPECT_EQ(node3->getToken().type, TokenType::Dup);
+    ASSERT_EQ(nodes[2]->kind(), AstKind::Word);
+    EXPECT_EQ(nodes[2]->getToken().text, "DUP");
+    EXPECT_EQ(nodes[2]->getToken().type, TokenType::Dup);
 }
 
 TEST(ParserTest, HandlesEmptyInput) {
@@ -33,10 +40,10 @@ TEST(ParserTest, HandlesEmptyInput) {
     Lexer lexer(input);
     Parser parser(lexer);
 
-    std::unique_ptr<ProgramNode> ast = parser.parse();
-    ASSERT_NE(ast, nullptr);
+    Ast ast = parser.parse();
+    ASSERT_EQ(ast.root().kind(), AstKind::Block);
 
-    const auto& nodes = ast->getNodes();
+    auto nodes = children(ast.root());
     ASSERT_EQ(nodes.size(), 0);
 }
 
@@ -45,9 +52,118 @@ TEST(ParserTest, HandlesOnlyWhitespace) {
     Lexer lexer(input);
     Parser parser(lexer);
 
-    std::unique_ptr<ProgramNode> ast = parser.parse();
-    ASSERT_NE(ast, nullptr);
+    Ast ast = parser.parse();
+    ASSERT_EQ(ast.root().kind(), AstKind::Block);
 
-    const auto& nodes = ast->getNodes();
+    auto nodes = children(ast.root());
     ASSERT_EQ(nodes.size(), 0);
 }
+
+TEST(ParserTest, RecordsLoopVariants) {
+    Lexer lexer("10 0 ?DO I 2 +LOOP");
+    Parser parser(lexer);
+    auto ast = parser.parse();
+
+    auto nodes = children(ast.root());
+    ASSERT_EQ(nodes.size(), 3);
+    const AstNode* loop = nodes[2];
+    ASSERT_EQ(loop->kind(), AstKind::DoLoop);
+    EXPECT_TRUE(loop->isConditional());
+    EXPECT_TRUE(loop->isPlusLoop());
+    EXPECT_EQ(children(loop->getBody()).size(), 2);
+}
+
+TEST(ParserTest, RejectsMisplacedLoopExits) {
+    for (const char* input : {
+             "LEAVE",
+             ": F LEAVE ;",
+             "10 0 DO : F LEAVE ; LOOP",
+             ": F 10 0 DO UNLOOP LOOP ;",
+             ": F 10 0 DO UNLOOP UNLOOP EXIT LOOP ;",
+             ": F 10 0 DO EXIT LOOP ;",
+             "EXIT",
+         }) {
+        Lexer lexer(input);
+        Parser parser(lexer);
+        EXPECT_THROW(parser.parse(), std::runtime_error) << input;
+    }
+
+    Lexer lexer(": F 10 0 DO 10 0 DO I 5 = IF LEAVE THEN J IF UNLOOP UNLOOP EXIT THEN LOOP LOOP ;");
+    Parser parser(lexer);
+    EXPECT_NO_THROW(parser.parse());
+}
+
+TEST(ParserTest, TakesIncludesOnlyAtTheTopLevel) {
+    Lexer lexer("INCLUDE lib/a.peli 1 REQUIRE b.peli");
+    Parser parser(lexer);
+    auto ast = parser.parse();
+
+    auto nodes = children(ast.root());
+    ASSERT_EQ(nodes.size(), 3);
+    ASSERT_EQ(nodes[0]->kind(), AstKind::Include);
+    EXPECT_EQ(nodes[0]->getPath(), "lib/a.peli");
+    EXPECT_FALSE(nodes[0]->isOnce());
+    EXPECT_EQ(nodes[2]->getPath(), "b.peli");
+    EXPECT_TRUE(nodes[2]->isOnce());
+
+    for (const char* input : {": F INCLUDE a.peli ;", "1 IF REQUIRE a.peli THEN", "INCLUDE"}) {
+        Lexer bad(input);
+        Parser badParser(bad);
+        EXPECT_THROW(badParser.parse(), std::runtime_error) << input;
+    }
+}
+
+TEST(ParserTest, LaysTheTreeOutFlatInPreOrder) {
+    std::string source = ": ABS DUP 0 < IF -1 * THEN ; 5 ABS";
+    Ast ast = [&source] {
+        Lexer lexer(source);
+        Parser parser(lexer);
+        return parser.parse();
+    }();
+    // Words keep their text after the source is gone.
+    source.assign(source.size(), '?');
+
+    // Program, Definition, Block, DUP, 0, <, If, Block, -1, *, Block, 5, ABS
+    EXPECT_EQ(ast.nodeCount(), 13u);
+    EXPECT_EQ(ast.root().subtreeSize(), 13u);
+
+    auto nodes = children(ast.root());
+    ASSERT_EQ(nodes.size(), 3);
+    const AstNode& def = *nodes[0];
+    ASSERT_EQ(def.kind(), AstKind::Definition);
+    EXPECT_EQ(def.getName(), "ABS");
+    EXPECT_EQ(def.subtreeSize(), 10u);
+    EXPECT_EQ(nodes[1], &def + 10);
+
+    auto body = children(def.getBody());
+    ASSERT_EQ(body.size(), 4);
+    const AstNode& ifThen = *body[3];
+    ASSERT_EQ(ifThen.kind(), AstKind::If);
+    EXPECT_EQ(children(ifThen.getTrueBranch()).size(), 2);
+    EXPECT_TRUE(ifThen.getFalseBranch().children().empty());
+    EXPECT_EQ(nodes[2]->getText(), "ABS");
+
+    // A copied subtree stands on its own.
+    Ast copy = Ast::copyOf(def);
+    ast = Ast();
+    EXPECT_EQ(copy.nodeCount(), 10u);
+    EXPECT_EQ(copy.root().getName(), "ABS");
+    auto copied = children(copy.root().getBody());
+    ASSERT_EQ(copied.size(), 4);
+    EXPECT_EQ(copied[0]->getText(), "DUP");
+    EXPECT_EQ(copied[3]->getTrueBranch().children().begin()->getInteger(), -1);
+}
+
+TEST(ParserTest, ParsesStreamedStatementsALineAtATime) {
+    std::istringstream in(": SQ\n  DUP * ;\n3 SQ . 4 SQ .\n\n5 6 7\n");
+    Lexer lexer(in);
+    Parser parser(lexer);
+    std::vector<size_t> batches;
+    Ast statements;
+    while (parser.parseNext(statements, 2)) {
+        batches.push_back(children(statements.root()).size());
+    }
+    // A definition spanning lines, then what is left of each line, in
+    // batches of at most two.
+    EXPECT_EQ(batches, (std::vector<size_t>{1, 2, 2, 2, 2, 1}));
+}
@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+#include "ModeTest.hpp"
+#include "Vector.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace {
+
+// Cells that overflow when added or multiplied, so the integer kernels
+// must wrap the way + and * do.
+template <typename Cell>
+std::vector<Cell> randomCells(std::mt19937_64& random, size_t count) {
+    std::vector<Cell> cells(count);
+    for (Cell& cell : cells) {
+        if constexpr (cellIsInteger<Cell>) {
+            cell = static_cast<Cell>(random());
+        } else {
+            cell = std::ldexp(static_cast<double>(random() % 2000001) - 1000000, static_cast<int>(random() % 40) - 20);
+        }
+    }
+    return cells;
+}
+
+template <typename Cell>
+bool sameBits(Cell a, Cell b) {
+    return std::memcmp(&a, &b, sizeof(Cell)) == 0;
+}
+
+// Every kernel set must agree bit for bit with the scalar one, for each
+// length up to a few blocks so that both the blocks and the tails run, and
+// in place.
+template <typename Cell>
+void expectKernelsAgree() {
+    std::mt19937_64 random(12345);
+    const VectorKernels<Cell>& scalar = *VectorKernels<Cell>::available().front();
+    for (const VectorKernels<Cell>* kernels : VectorKernels<Cell>::available()) {
+        for (size_t n = 1; n < 70; ++n) {
+            std::vector<Cell> a = randomCells<Cell>(random, n);
+            std::vector<Cell> b = randomCells<Cell>(random, n);
+            Cell k = randomCells<Cell>(random, 1)[0];
+            EXPECT_TRUE(sameBits(kernels->sum(a.data(), n), scalar.sum(a.data(), n))) << kernels->name << " " << n;
+            EXPECT_TRUE(sameBits(kernels->dot(a.data(), b.data(), n), scalar.dot(a.data(), b.data(), n)))
+                << kernels->name << " " << n;
+            EXPECT_EQ(kernels->min(a.data(), n), *std::min_element(a.begin(), a.end())) << kernels->name << " " << n;
+            EXPECT_EQ(kernels->max(a.data(), n), *std::max_element(a.begin(), a.end())) << kernels->name << " " << n;
+
+            using Zip = void (*)(const Cell*, const Cell*, Cell*, size_t);
+            for (auto [zip, reference] : {std::pair<Zip, Zip>{kernels->add, scalar.add},
+                                          std::pair<Zip, Zip>{kernels->sub, scalar.sub},
+                                          std::pair<Zip, Zip>{kernels->mul, scalar.mul}}) {
+                std::vector<Cell> expected(n), actual = a;
+                reference(a.data(), b.data(), expected.data(), n);
+                zip(actual.data(), b.data(), actual.data(), n);
+                EXPECT_EQ(actual, expected) << kernels->name << " " << n;
+            }
+            std::vector<Cell> expected(n), actual(n);
+            scalar.scale(a.data(), expected.data(), n, k);
+            kernels->scale(a.data(), actual.data(), n, k);
+            EXPECT_EQ(actual, expected) << kernels->name << " " << n;
+        }
+    }
+}
+
+// ( n addr -- ) stores 1, 2, ..., n from `addr`.
+const char* const kCount = ": COUNT-UP SWAP 0 DO I 1 + OVER I + ! LOOP DROP ; ";
+
+} // namespace
+
+class VectorTest : public ModeTest {};
+
+TEST(VectorKernelsTest, EveryKernelSetMatchesTheScalarOne) {
+    expectKernelsAgree<double>();
+    expectKernelsAgree<int64_t>();
+    expectKernelsAgree<int32_t>();
+}
+
+TEST(VectorKernelsTest, IntegerKernelsWrap) {
+    for (const VectorKernels<int64_t>* kernels : VectorKernels<int64_t>::available()) {
+        std::vector<int64_t> a(9, std::numeric_limits<int64_t>::max());
+        EXPECT_EQ(kernels->sum(a.data(), a.size()), std::numeric_limits<int64_t>::max() - 8) << kernels->name;
+        kernels->mul(a.data(), a.data(), a.data(), a.size());
+        EXPECT_EQ(a, std::vector<int64_t>(9, 1)) << kernels->name;
+    }
+}
+
+TEST_P(VectorTest, ElementwiseWordsStoreIntoTheTarget) {
+    BasicInterpreter<int64_t> interpreter(options());
+    evaluate(interpreter, std::string(kCount) + "10 100 COUNT-UP 10 200 COUNT-UP "
+                                                "100 200 300 10 V+ 300 @ 309 @ "
+                                                "300 100 300 10 V- 305 @ "
+                                                "100 200 100 10 V* 109 @ "
+                                                "200 400 10 -3 VSCALE 400 @ 409 @ 410 @");
+    EXPECT_EQ(interpreter.getStack(), (std::vector<int64_t>{2, 20, 6, 100, -3, -30, 0}));
+}
+
+TEST_P(VectorTest, ReductionsReturnOneCell) {
+    Interpreter interpreter(options());
+    evaluate(interpreter, std::string(kCount) + "100 1000 COUNT-UP 1000 100 VSUM 1000 1000 3 VDOT "
+                                                "-2.5 1050 ! 1000 100 VMIN 1000 100 VMAX 1000 0 VSUM");
+    EXPECT_EQ(interpreter.getStack(), (std::vector<double>{5050, 14, -2.5, 100, 0}));
+}
+
+TEST_P(VectorTest, RangesAreChecked) {
+    InterpreterOptions small = options();
+    small.memory_cells = 1024;
+    BasicInterpreter<int32_t> interpreter(small);
+    EXPECT_EQ(errorOf(interpreter, "0 1000 100 30 V+"), "V+ memory out of bounds");
+    EXPECT_EQ(errorOf(interpreter, "0 0 1000 30 V*"), "V* memory out of bounds");
+    EXPECT_EQ(errorOf(interpreter, "0 0 -1 1 V-"), "V- memory out of bounds");
+    EXPECT_EQ(errorOf(interpreter, "0 1020 5 2 VSCALE"), "VSCALE memory out of bounds");
+    EXPECT_EQ(errorOf(interpreter, "0 1025 VSUM"), "VSUM memory out of bounds");
+    EXPECT_EQ(errorOf(interpreter, "1000 0 30 VDOT"), "VDOT memory out of bounds");
+    EXPECT_EQ(errorOf(interpreter, "0 -1 VMAX"), "VMAX memory out of bounds");
+    EXPECT_EQ(errorOf(interpreter, "0 0 VMIN"), "VMIN of no cells");
+}
+
+INSTANTIATE_TEST_SUITE_P(Modes, VectorTest, ::testing::ValuesIn(kModes), modeName);